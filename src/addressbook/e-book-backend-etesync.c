@@ -7,19 +7,24 @@
 
 #include "evolution-etesync-config.h"
 
+#include <glib/gi18n-lib.h>
 #include <libedataserver/libedataserver.h>
 #include <etebase.h>
 
 #include "common/e-source-etesync.h"
+#include "common/e-etesync-cache.h"
 #include "common/e-etesync-connection.h"
 #include "common/e-etesync-utils.h"
 #include "common/e-etesync-defines.h"
+#include "common/e-etesync-outbox.h"
+#include "common/e-etesync-service.h"
 #include "e-book-backend-etesync.h"
 
 struct _EBookBackendEteSyncPrivate {
 	EEteSyncConnection *connection;
 	EtebaseCollection *col_obj;
 	GRecMutex etesync_lock;
+	EEteSyncOutbox *outbox;
 
 	gboolean fetch_from_server;
 
@@ -83,9 +88,9 @@ ebb_etesync_connect_sync (EBookMetaBackend *meta_backend,
 			ESourceEteSync *etesync_extension;
 
 			etesync_extension = e_source_get_extension (source, E_SOURCE_EXTENSION_ETESYNC);
-			bbetesync->priv->col_obj = e_etesync_utils_etebase_collection_from_base64 (
-								e_source_etesync_get_etebase_collection_b64 (etesync_extension),
-								e_etesync_connection_get_collection_manager (bbetesync->priv->connection));
+			bbetesync->priv->col_obj = e_etesync_connection_dup_collection (bbetesync->priv->connection,
+								e_source_etesync_get_collection_id (etesync_extension),
+								e_source_etesync_get_etebase_collection_b64 (etesync_extension));
 		}
 
 		success = bbetesync->priv->col_obj? TRUE : FALSE;
@@ -93,6 +98,9 @@ ebb_etesync_connect_sync (EBookMetaBackend *meta_backend,
 		if (success) {
 			is_read_only = etebase_collection_get_access_level (bbetesync->priv->col_obj) == ETEBASE_COLLECTION_ACCESS_LEVEL_READ_ONLY;
 			e_book_backend_set_writable (E_BOOK_BACKEND (bbetesync), !is_read_only);
+
+			/* Upload changes left from the previous run */
+			e_etesync_outbox_schedule (bbetesync->priv->outbox);
 		}
 	}
 
@@ -111,6 +119,132 @@ ebb_etesync_disconnect_sync (EBookMetaBackend *meta_backend,
 	return TRUE;
 }
 
+/* EEteSyncOutboxUploadFunc */
+static gboolean
+ebb_etesync_outbox_upload_cb (gpointer user_data,
+			      gboolean *out_done,
+			      GCancellable *cancellable,
+			      GError **error)
+{
+	EBookBackendEteSync *bbetesync = user_data;
+	GSList *modified_objects = NULL, *removed_objects = NULL;
+	gboolean success = TRUE;
+
+	g_rec_mutex_lock (&bbetesync->priv->etesync_lock);
+
+	if (bbetesync->priv->col_obj) {
+		success = e_etesync_connection_queued_items_upload_sync (bbetesync->priv->connection,
+									 E_BACKEND (bbetesync),
+									 E_ETESYNC_ADDRESSBOOK,
+									 bbetesync->priv->col_obj,
+									 out_done,
+									 &modified_objects,
+									 &removed_objects,
+									 cancellable,
+									 error);
+	} else {
+		*out_done = TRUE;
+	}
+
+	g_rec_mutex_unlock (&bbetesync->priv->etesync_lock);
+
+	/* The server won the conflicts, store its version */
+	if (success && (modified_objects || removed_objects)) {
+		success = e_book_meta_backend_process_changes_sync (E_BOOK_META_BACKEND (bbetesync), NULL,
+			modified_objects, removed_objects, cancellable, error);
+	}
+
+	g_slist_free_full (modified_objects, e_book_meta_backend_info_free);
+	g_slist_free_full (removed_objects, e_book_meta_backend_info_free);
+
+	return success;
+}
+
+/* EEteSyncOutboxErrorFunc */
+static void
+ebb_etesync_outbox_error_cb (gpointer user_data,
+			    const GError *error)
+{
+	EBookBackendEteSync *bbetesync = user_data;
+	gchar *message;
+
+	/* the changes are uploaded once it is online again */
+	if (!e_backend_get_online (E_BACKEND (bbetesync)) || g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+		return;
+
+	message = g_strdup_printf (_("Failed to upload changes, they will be tried again later: %s"),
+		error ? error->message : _("Unknown error"));
+	e_backend_notify_error (E_BACKEND (bbetesync), message);
+	g_free (message);
+}
+
+typedef struct _ListExistingData {
+	EBookMetaBackend *meta_backend;
+	EBookCache *book_cache;
+	GHashTable *listed_uids; /* gchar *uid ~> NULL */
+	GSList *existing_objects; /* EBookMetaBackendInfo *, without object and extra */
+} ListExistingData;
+
+/* Stores each listed page into the cache right away, together with the stoken
+   to resume the listing from, thus the whole collection is not held in memory */
+static gboolean
+ebb_etesync_list_existing_page_cb (GSList *page_objects, /* EBookMetaBackendInfo * */
+				   const gchar *stoken,
+				   gpointer user_data,
+				   GCancellable *cancellable,
+				   GError **error)
+{
+	ListExistingData *led = user_data;
+	GSList *link, *created_objects = NULL, *modified_objects = NULL;
+	GHashTable *contained = NULL;
+	const gchar **uids;
+	guint ii, n_uids;
+	gboolean success;
+
+	n_uids = g_slist_length (page_objects);
+	uids = g_new0 (const gchar *, n_uids);
+
+	for (link = page_objects, ii = 0; link; link = g_slist_next (link), ii++)
+		uids[ii] = ((EBookMetaBackendInfo *) link->data)->uid;
+
+	success = e_etesync_cache_get_contained_uids_sync (E_CACHE (led->book_cache), uids, n_uids, &contained, cancellable, error);
+
+	g_free (uids);
+
+	if (!success) {
+		g_hash_table_destroy (contained);
+		g_slist_free_full (page_objects, e_book_meta_backend_info_free);
+		return FALSE;
+	}
+
+	for (link = page_objects; link; link = g_slist_next (link)) {
+		EBookMetaBackendInfo *nfo = link->data;
+
+		if (g_hash_table_contains (contained, nfo->uid))
+			modified_objects = g_slist_prepend (modified_objects, nfo);
+		else
+			created_objects = g_slist_prepend (created_objects, nfo);
+
+		if (!g_hash_table_contains (led->listed_uids, nfo->uid)) {
+			g_hash_table_add (led->listed_uids, g_strdup (nfo->uid));
+			led->existing_objects = g_slist_prepend (led->existing_objects,
+				e_book_meta_backend_info_new (nfo->uid, nfo->revision, NULL, NULL));
+		}
+	}
+
+	success = e_book_meta_backend_process_changes_sync (led->meta_backend, created_objects, modified_objects, NULL, cancellable, error);
+
+	if (success)
+		e_cache_set_key (E_CACHE (led->book_cache), E_ETESYNC_CACHE_KEY_LIST_STOKEN, stoken, NULL);
+
+	g_hash_table_destroy (contained);
+	g_slist_free (created_objects);
+	g_slist_free (modified_objects);
+	g_slist_free_full (page_objects, e_book_meta_backend_info_free);
+
+	return success;
+}
+
 static gboolean
 ebb_etesync_list_existing_sync (EBookMetaBackend *meta_backend,
 				gchar **out_new_sync_tag,
@@ -120,6 +254,8 @@ ebb_etesync_list_existing_sync (EBookMetaBackend *meta_backend,
 {
 	EBookBackendEteSync *bbetesync;
 	EEteSyncConnection *connection;
+	ListExistingData led;
+	gchar *resume_stoken;
 	gboolean success;
 
 	g_return_val_if_fail (E_IS_BOOK_BACKEND_ETESYNC (meta_backend), FALSE);
@@ -128,12 +264,28 @@ ebb_etesync_list_existing_sync (EBookMetaBackend *meta_backend,
 	bbetesync = E_BOOK_BACKEND_ETESYNC (meta_backend);
 	connection = bbetesync->priv->connection;
 
+	led.meta_backend = meta_backend;
+	led.book_cache = e_book_meta_backend_ref_cache (meta_backend);
+
+	g_return_val_if_fail (led.book_cache != NULL, FALSE);
+
+	led.listed_uids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	led.existing_objects = NULL;
+
+	resume_stoken = e_cache_dup_key (E_CACHE (led.book_cache), E_ETESYNC_CACHE_KEY_LIST_STOKEN, NULL);
+
+	if (resume_stoken && !*resume_stoken)
+		g_clear_pointer (&resume_stoken, g_free);
+
 	g_rec_mutex_lock (&bbetesync->priv->etesync_lock);
 
 	success = e_etesync_connection_list_existing_sync (connection,
 							   E_BACKEND (meta_backend),
 							   E_ETESYNC_ADDRESSBOOK,
 							   bbetesync->priv->col_obj,
+							   resume_stoken,
+							   ebb_etesync_list_existing_page_cb,
+							   &led,
 							   out_new_sync_tag,
 							   out_existing_objects,
 							   cancellable,
@@ -141,6 +293,35 @@ ebb_etesync_list_existing_sync (EBookMetaBackend *meta_backend,
 
 	g_rec_mutex_unlock (&bbetesync->priv->etesync_lock);
 
+	if (success) {
+		/* The contacts stored before the interruption are not listed again */
+		if (resume_stoken) {
+			GSList *uids = NULL, *revisions = NULL, *ulink, *rlink;
+
+			if (e_cache_get_uids (E_CACHE (led.book_cache), E_CACHE_EXCLUDE_DELETED, &uids, &revisions, cancellable, NULL)) {
+				for (ulink = uids, rlink = revisions; ulink; ulink = g_slist_next (ulink), rlink = g_slist_next (rlink)) {
+					if (!g_hash_table_contains (led.listed_uids, ulink->data)) {
+						led.existing_objects = g_slist_prepend (led.existing_objects,
+							e_book_meta_backend_info_new (ulink->data, rlink ? rlink->data : NULL, NULL, NULL));
+					}
+				}
+			}
+
+			g_slist_free_full (uids, g_free);
+			g_slist_free_full (revisions, g_free);
+		}
+
+		e_cache_set_key (E_CACHE (led.book_cache), E_ETESYNC_CACHE_KEY_LIST_STOKEN, NULL, NULL);
+
+		*out_existing_objects = g_slist_reverse (led.existing_objects);
+	} else {
+		g_slist_free_full (led.existing_objects, e_book_meta_backend_info_free);
+	}
+
+	g_hash_table_destroy (led.listed_uids);
+	g_object_unref (led.book_cache);
+	g_free (resume_stoken);
+
 	return success;
 }
 
@@ -170,13 +351,20 @@ ebb_etesync_get_changes_sync (EBookMetaBackend *meta_backend,
 	*out_modified_objects = NULL;
 	*out_removed_objects = NULL;
 	*out_new_sync_tag = NULL;
+	*out_repeat = FALSE;
 
 	bbetesync = E_BOOK_BACKEND_ETESYNC (meta_backend);
 	connection = bbetesync->priv->connection;
 
+	/* Upload the local changes first, thus they are not overwritten by the server
+	   version; those not uploaded are tried again later by the outbox */
+	if (!is_repeat)
+		e_etesync_outbox_flush_sync (bbetesync->priv->outbox, cancellable, NULL);
+
 	g_rec_mutex_lock (&bbetesync->priv->etesync_lock);
 
-	/* Must add preloaded */
+	/* Must add preloaded; they are consumed by the first call, the repeated
+	   calls only add further pages of the changes from the server */
 	*out_created_objects = bbetesync->priv->preloaded_add;
 	*out_modified_objects = bbetesync->priv->preloaded_modify;
 	*out_removed_objects = bbetesync->priv->preloaded_delete;
@@ -185,6 +373,9 @@ ebb_etesync_get_changes_sync (EBookMetaBackend *meta_backend,
 	bbetesync->priv->preloaded_modify = NULL;
 	bbetesync->priv->preloaded_delete = NULL;
 
+	if (!is_repeat)
+		e_etesync_connection_update_collection_from_source (connection, e_backend_get_source (E_BACKEND (meta_backend)), &bbetesync->priv->col_obj);
+
 	if (bbetesync->priv->fetch_from_server) {
 		book_cache = e_book_meta_backend_ref_cache (meta_backend);
 
@@ -196,6 +387,7 @@ ebb_etesync_get_changes_sync (EBookMetaBackend *meta_backend,
 									 bbetesync->priv->col_obj,
 									 E_CACHE (book_cache),
 									 out_new_sync_tag,
+									 out_repeat,
 									 out_created_objects,
 									 out_modified_objects,
 									 out_removed_objects,
@@ -219,6 +411,9 @@ ebb_etesync_load_contact_sync (EBookMetaBackend *meta_backend,
 			       GCancellable *cancellable,
 			       GError **error)
 {
+	EBookBackendEteSync *bbetesync;
+	EBookMetaBackendInfo *nfo = NULL;
+	GError *local_error = NULL;
 	gboolean success = FALSE;
 
 	g_return_val_if_fail (E_IS_BOOK_BACKEND_ETESYNC (meta_backend), FALSE);
@@ -226,11 +421,40 @@ ebb_etesync_load_contact_sync (EBookMetaBackend *meta_backend,
 	g_return_val_if_fail (out_contact != NULL, FALSE);
 	g_return_val_if_fail (out_extra != NULL, FALSE);
 
-	/* 1) Call e_book_meta_backend_refresh_sync() to get contacts since last_tag */
+	bbetesync = E_BOOK_BACKEND_ETESYNC (meta_backend);
+
+	/* 1) Fetch only the required contact, when its item is known; the other
+	      changes are received with the refresh, which does not block the caller */
+	g_rec_mutex_lock (&bbetesync->priv->etesync_lock);
+
+	if (e_etesync_connection_item_fetch_sync (bbetesync->priv->connection, E_BACKEND (meta_backend), E_ETESYNC_ADDRESSBOOK,
+		bbetesync->priv->col_obj, uid, extra, (gpointer *) &nfo, cancellable, &local_error)) {
+		*out_contact = e_contact_new_from_vcard_with_uid (nfo->object, nfo->uid);
+		*out_extra = g_strdup (nfo->extra);
+		success = TRUE;
+
+		e_book_meta_backend_info_free (nfo);
+	}
+
+	g_rec_mutex_unlock (&bbetesync->priv->etesync_lock);
+
+	if (success) {
+		e_book_meta_backend_schedule_refresh (meta_backend);
+		return TRUE;
+	}
+
+	if (!g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND)) {
+		g_propagate_error (error, local_error);
+		return FALSE;
+	}
+
+	g_clear_error (&local_error);
+
+	/* 2) Call e_book_meta_backend_refresh_sync() to get contacts since last_tag */
 	if (e_book_meta_backend_refresh_sync (meta_backend, cancellable, error)) {
 		EBookCache *book_cache;
 
-		/* 2) Search cache data for the required contact */
+		/* 3) Search cache data for the required contact */
 		book_cache = e_book_meta_backend_ref_cache (meta_backend);
 
 		if (book_cache) {
@@ -282,17 +506,20 @@ ebb_etesync_save_contact_sync (EBookMetaBackend *meta_backend,
 	uid = e_contact_get_const (contact, E_CONTACT_UID);
 
 	if (overwrite_existing) {
-		success = e_etesync_connection_item_upload_sync (connection, E_BACKEND (meta_backend), bbetesync->priv->col_obj,
-				E_ETESYNC_ITEM_ACTION_MODIFY, content, uid, extra, NULL, out_new_extra, cancellable, error);
+		success = e_etesync_connection_item_queue_sync (connection, E_BACKEND (meta_backend), bbetesync->priv->col_obj,
+				E_ETESYNC_ITEM_ACTION_MODIFY, content, uid, extra, conflict_resolution, NULL, out_new_extra, cancellable, error);
 	} else {
-		success = e_etesync_connection_item_upload_sync (connection, E_BACKEND (meta_backend), bbetesync->priv->col_obj,
-				E_ETESYNC_ITEM_ACTION_CREATE, content, uid, NULL, NULL, out_new_extra, cancellable, error);
+		success = e_etesync_connection_item_queue_sync (connection, E_BACKEND (meta_backend), bbetesync->priv->col_obj,
+				E_ETESYNC_ITEM_ACTION_CREATE, content, uid, NULL, conflict_resolution, NULL, out_new_extra, cancellable, error);
 	}
 
 	g_free (content);
 
 	g_rec_mutex_unlock (&bbetesync->priv->etesync_lock);
 
+	if (success)
+		e_etesync_outbox_schedule (bbetesync->priv->outbox);
+
 	return success;
 }
 
@@ -317,11 +544,14 @@ ebb_etesync_remove_contact_sync (EBookMetaBackend *meta_backend,
 
 	g_rec_mutex_lock (&bbetesync->priv->etesync_lock);
 
-	success = e_etesync_connection_item_upload_sync (connection, E_BACKEND (meta_backend), bbetesync->priv->col_obj,
-				E_ETESYNC_ITEM_ACTION_DELETE, NULL, uid, extra, NULL, NULL, cancellable, error);
+	success = e_etesync_connection_item_queue_sync (connection, E_BACKEND (meta_backend), bbetesync->priv->col_obj,
+				E_ETESYNC_ITEM_ACTION_DELETE, NULL, uid, extra, conflict_resolution, NULL, NULL, cancellable, error);
 
 	g_rec_mutex_unlock (&bbetesync->priv->etesync_lock);
 
+	if (success)
+		e_etesync_outbox_schedule (bbetesync->priv->outbox);
+
 	return success;
 }
 
@@ -336,7 +566,10 @@ ebb_etesync_create_modify_contacts_sync (EBookBackendSync *backend,
 {
 	EBookBackendEteSync *bbetesync;
 	EEteSyncConnection *connection;
-	guint length, batch_length, batch_number = 0;
+	GSList *batch_contacts = NULL; /* EContact */
+	GSList *batch_info = NULL; /* EBookMetaBackendInfo */
+	gchar **content;
+	guint length, ii;
 	gboolean success = TRUE;
 
 	length = g_strv_length ((gchar **) vcards);
@@ -345,101 +578,101 @@ ebb_etesync_create_modify_contacts_sync (EBookBackendSync *backend,
 	connection = bbetesync->priv->connection;
 	*out_contacts = NULL;
 
+	/* The queued changes go first, to keep the order of the changes */
+	if (!e_etesync_outbox_flush_sync (bbetesync->priv->outbox, cancellable, error))
+		return FALSE;
+
 	g_rec_mutex_lock (&bbetesync->priv->etesync_lock);
 
-	/* extract the components and mass-add them to the server */
-	while (length > 0 && success) {
-		GSList *batch_contacts = NULL; /* EContact */
-		GSList *batch_info = NULL; /* EBookMetaBackendInfo */
-		gchar *content[E_ETESYNC_ITEM_PUSH_LIMIT];
-		guint ii;
+	content = g_new0 (gchar *, length);
 
-		batch_length = length > E_ETESYNC_ITEM_PUSH_LIMIT ? E_ETESYNC_ITEM_PUSH_LIMIT : length;
-		length -= batch_length;
+	/* extract the contacts and mass-add them to the server; the connection uploads
+	   them in batches, preparing the next batch while the previous one is uploaded */
+	for (ii = 0; ii < length; ii++) {
+		EContact *contact;
 
-		for (ii = 0; ii < batch_length; ii++) {
-			EContact *contact;
+		contact = e_contact_new_from_vcard (vcards[ii]);
 
-			contact = e_contact_new_from_vcard (vcards[ii + (batch_number * E_ETESYNC_ITEM_PUSH_LIMIT)]);
+		/* Preserve original UID, create a unique UID if needed */
+		if (e_contact_get_const (contact, E_CONTACT_UID) == NULL) {
+			gchar *uid = e_util_generate_uid ();
+			e_contact_set (contact, E_CONTACT_UID, uid);
+			g_free (uid);
+		}
 
-			/* Preserve original UID, create a unique UID if needed */
-			if (e_contact_get_const (contact, E_CONTACT_UID) == NULL) {
-				gchar *uid = e_util_generate_uid ();
-				e_contact_set (contact, E_CONTACT_UID, uid);
-				g_free (uid);
-			}
+		#if EDS_CHECK_VERSION(3, 59, 1)
+		content[ii] = e_vcard_to_string (E_VCARD (contact));
+		#else
+		content[ii] = e_vcard_to_string (E_VCARD (contact), EVC_FORMAT_VCARD_30);
+		#endif
+		batch_contacts = g_slist_prepend (batch_contacts, contact);
+	}
 
-			#if EDS_CHECK_VERSION(3, 59, 1)
-			content[ii] = e_vcard_to_string (E_VCARD (contact));
-			#else
-			content[ii] = e_vcard_to_string (E_VCARD (contact), EVC_FORMAT_VCARD_30);
-			#endif
-			batch_contacts = g_slist_prepend (batch_contacts, contact);
-		}
+	batch_contacts = g_slist_reverse (batch_contacts);
+
+	if (action == E_ETESYNC_ITEM_ACTION_CREATE) {
+		success = e_etesync_connection_batch_create_sync (connection,
+								  E_BACKEND (E_BOOK_META_BACKEND (bbetesync)),
+								  bbetesync->priv->col_obj,
+								  E_ETESYNC_ADDRESSBOOK,
+								  (const gchar *const*) content,
+								  length, /* length of content */
+								  &batch_info,
+								  cancellable,
+								  error);
+
+	} else if (action == E_ETESYNC_ITEM_ACTION_MODIFY) {
+		EBookCache *book_cache;
 
-		if (action == E_ETESYNC_ITEM_ACTION_CREATE) {
-			success = e_etesync_connection_batch_create_sync (connection,
+		EBookMetaBackend *meta_backend = E_BOOK_META_BACKEND (bbetesync);
+		book_cache = e_book_meta_backend_ref_cache (meta_backend);
+
+		if (book_cache) {
+			success = e_etesync_connection_batch_modify_sync (connection,
 									  E_BACKEND (E_BOOK_META_BACKEND (bbetesync)),
 									  bbetesync->priv->col_obj,
 									  E_ETESYNC_ADDRESSBOOK,
 									  (const gchar *const*) content,
-									  batch_length, /* length of content */
+									  NULL,
+									  length, /* length of content */
+									  E_CACHE (book_cache), /* uses book_cache if type is addressbook */
 									  &batch_info,
 									  cancellable,
 									  error);
-
-		} else if (action == E_ETESYNC_ITEM_ACTION_MODIFY) {
-			EBookCache *book_cache;
-
-			EBookMetaBackend *meta_backend = E_BOOK_META_BACKEND (bbetesync);
-			book_cache = e_book_meta_backend_ref_cache (meta_backend);
-
-			if (book_cache) {
-				success = e_etesync_connection_batch_modify_sync (connection,
-										  E_BACKEND (E_BOOK_META_BACKEND (bbetesync)),
-										  bbetesync->priv->col_obj,
-										  E_ETESYNC_ADDRESSBOOK,
-										  (const gchar *const*) content,
-										  NULL,
-										  batch_length, /* length of content */
-										  E_CACHE (book_cache), /* uses book_cache if type is addressbook */
-										  &batch_info,
-										  cancellable,
-										  error);
-				g_object_unref (book_cache);
-			} else
-				success = FALSE;
-		}
-
-		if (success) {
-			if (action == E_ETESYNC_ITEM_ACTION_CREATE)
-				bbetesync->priv->preloaded_add = g_slist_concat (batch_info, bbetesync->priv->preloaded_add);
-			else if (action == E_ETESYNC_ITEM_ACTION_MODIFY)
-				bbetesync->priv->preloaded_modify = g_slist_concat (batch_info, bbetesync->priv->preloaded_modify);
-			*out_contacts = g_slist_concat (batch_contacts, *out_contacts);
-		} else {
-			g_slist_free_full (batch_contacts, g_object_unref);
-			g_slist_free_full (batch_info, e_book_meta_backend_info_free);
-		}
-
-		for (ii = 0; ii < batch_length; ii++)
-			g_free (content[ii]);
-		batch_number++;
+			g_object_unref (book_cache);
+		} else
+			success = FALSE;
 	}
 
-	if (success) {
+	/* The 'batch_info' has only the contacts, which were stored on the server,
+	   thus store them in the local cache too, even when some others failed */
+	if (action == E_ETESYNC_ITEM_ACTION_CREATE)
+		bbetesync->priv->preloaded_add = batch_info;
+	else if (action == E_ETESYNC_ITEM_ACTION_MODIFY)
+		bbetesync->priv->preloaded_modify = batch_info;
+
+	if (batch_info) {
 		bbetesync->priv->fetch_from_server = FALSE;
 		e_book_meta_backend_refresh_sync (E_BOOK_META_BACKEND (bbetesync), NULL, NULL);
 		bbetesync->priv->fetch_from_server = TRUE;
+	}
+
+	if (success) {
+		*out_contacts = batch_contacts;
 	} else {
-		g_slist_free_full (*out_contacts, g_object_unref);
-		*out_contacts = NULL;
+		g_slist_free_full (batch_contacts, g_object_unref);
 	}
 
 	/* free any data related to this bulk operation */
+	g_slist_free_full (bbetesync->priv->preloaded_add, e_book_meta_backend_info_free);
+	g_slist_free_full (bbetesync->priv->preloaded_modify, e_book_meta_backend_info_free);
 	bbetesync->priv->preloaded_add = NULL;
 	bbetesync->priv->preloaded_modify = NULL;
 
+	for (ii = 0; ii < length; ii++)
+		g_free (content[ii]);
+	g_free (content);
+
 	g_rec_mutex_unlock (&bbetesync->priv->etesync_lock);
 
 	return success;
@@ -494,7 +727,9 @@ ebb_etesync_remove_contacts_sync (EBookBackendSync *backend,
 	EBookBackendEteSync *bbetesync;
 	EBookCache *book_cache;
 	EEteSyncConnection *connection;
-	guint length, batch_length, batch_number = 0;
+	GSList *batch_info = NULL; /* EBookMetaBackendInfo */
+	gchar **content;
+	guint length, ii, n_contents = 0;
 	gboolean success = TRUE;
 
 	g_return_val_if_fail (out_removed_uids != NULL, FALSE);
@@ -513,80 +748,79 @@ ebb_etesync_remove_contacts_sync (EBookBackendSync *backend,
 	}
 
 	bbetesync = E_BOOK_BACKEND_ETESYNC (backend);
+
+	/* The queued changes go first, to keep the order of the changes */
+	if (!e_etesync_outbox_flush_sync (bbetesync->priv->outbox, cancellable, error))
+		return FALSE;
+
 	book_cache = e_book_meta_backend_ref_cache (E_BOOK_META_BACKEND (bbetesync));
 	connection = bbetesync->priv->connection;
+	*out_removed_uids = NULL;
 
 	g_rec_mutex_lock (&bbetesync->priv->etesync_lock);
 
-	/* extract the components and mass-add them to the server;
-	   eventually remember them in the cbetesync->priv and use them
-	   in the refresh/get_changes_sync(), instead of re-download them */
-	while (length > 0 && success) {
-		GSList *batch_contacts_id = NULL; /* gchar */
-		GSList *batch_info = NULL; /* EBookMetaBackendInfo */
-		gchar *content[E_ETESYNC_ITEM_PUSH_LIMIT];
-		guint ii;
-
-		batch_length = length > E_ETESYNC_ITEM_PUSH_LIMIT ? E_ETESYNC_ITEM_PUSH_LIMIT : length;
-		length -= batch_length;
-		*out_removed_uids = NULL;
-
-		for (ii = 0; ii < batch_length; ii++) {
-			const gchar 		*id;
-			EContact		*contact;
+	content = g_new0 (gchar *, length);
 
-			id = uids [ii + (batch_number * E_ETESYNC_ITEM_PUSH_LIMIT)];
+	/* extract the contacts and mass-remove them from the server; the connection
+	   uploads them in batches, preparing the next batch while the previous one
+	   is uploaded, and the removed contacts are remembered in the priv and used
+	   in the refresh/get_changes_sync(), instead of re-download them */
+	for (ii = 0; ii < length; ii++) {
+		EContact *contact = NULL;
 
-			e_book_cache_get_contact (book_cache, id, FALSE, &contact, cancellable, NULL);
+		/* the contacts, which are not in the cache, are already gone, thus skipped */
+		if (!e_book_cache_get_contact (book_cache, uids[ii], FALSE, &contact, cancellable, NULL))
+			continue;
 
-			#if EDS_CHECK_VERSION(3, 59, 1)
-			content[ii] = e_vcard_to_string (E_VCARD (contact));
-			#else
-			content[ii] = e_vcard_to_string (E_VCARD (contact), EVC_FORMAT_VCARD_30);
-			#endif
-			batch_contacts_id = g_slist_prepend (batch_contacts_id, g_strdup (id));
+		#if EDS_CHECK_VERSION(3, 59, 1)
+		content[n_contents] = e_vcard_to_string (E_VCARD (contact));
+		#else
+		content[n_contents] = e_vcard_to_string (E_VCARD (contact), EVC_FORMAT_VCARD_30);
+		#endif
+		n_contents++;
 
-			g_object_unref (contact);
-		}
+		g_object_unref (contact);
+	}
 
+	if (n_contents) {
 		success = e_etesync_connection_batch_delete_sync (connection,
 								  E_BACKEND (E_BOOK_META_BACKEND (bbetesync)),
 								  bbetesync->priv->col_obj,
 								  E_ETESYNC_ADDRESSBOOK,
 								  (const gchar *const*) content,
 								  NULL,
-								  batch_length, /* length of content */
+								  n_contents, /* length of content */
 								  E_CACHE (book_cache), /* uses book_cache if type is addressbook */
 								  &batch_info,
 								  cancellable,
 								  error);
+	}
 
-		if (success) {
-			bbetesync->priv->preloaded_delete = g_slist_concat (batch_info, bbetesync->priv->preloaded_delete);
-			*out_removed_uids = g_slist_concat (batch_contacts_id, *out_removed_uids);
-		} else {
-			g_slist_free_full (batch_contacts_id, g_object_unref);
-			g_slist_free_full (batch_info, e_book_meta_backend_info_free);
-		}
+	/* The 'batch_info' has only the contacts, which were removed on the server,
+	   thus remove them from the local cache too, even when some others failed;
+	   the error is returned then, though the removed contacts are notified */
+	bbetesync->priv->preloaded_delete = batch_info;
 
-		for (ii = 0; ii < batch_length; ii++)
-			g_free (content[ii]);
-		batch_number++;
+	if (batch_info) {
+		bbetesync->priv->fetch_from_server = FALSE;
+		e_book_meta_backend_refresh_sync (E_BOOK_META_BACKEND (bbetesync), NULL, NULL);
+		bbetesync->priv->fetch_from_server = TRUE;
 	}
 
 	if (success) {
-		bbetesync->priv->fetch_from_server = FALSE;
-		e_book_meta_backend_refresh_sync (E_BOOK_META_BACKEND (bbetesync), cancellable, error);
-		bbetesync->priv->fetch_from_server = TRUE;
-	} else {
-		g_slist_free_full (*out_removed_uids, g_free);
-		*out_removed_uids = NULL;
+		for (ii = length; ii > 0; ii--)
+			*out_removed_uids = g_slist_prepend (*out_removed_uids, g_strdup (uids[ii - 1]));
 	}
 
 	/* free any data related to this bulk operation */
+	g_slist_free_full (bbetesync->priv->preloaded_delete, e_book_meta_backend_info_free);
 	bbetesync->priv->preloaded_delete = NULL;
 	g_object_unref (book_cache);
 
+	for (ii = 0; ii < length; ii++)
+		g_free (content[ii]);
+	g_free (content);
+
 	g_rec_mutex_unlock (&bbetesync->priv->etesync_lock);
 
 	return success;
@@ -612,6 +846,33 @@ ebb_etesync_get_backend_property (EBookBackend *book_backend,
 	return E_BOOK_BACKEND_CLASS (e_book_backend_etesync_parent_class)->impl_get_backend_property (book_backend, prop_name);
 }
 
+/* The registry stores the collection, as it has it from the server, when
+   it changed; the refresh picks it up, not to block the main thread here */
+static void
+ebb_etesync_etebase_collection_notify_cb (ESourceEteSync *etesync_extension,
+					 GParamSpec *param,
+					 gpointer user_data)
+{
+	EBookBackendEteSync *bbetesync = user_data;
+
+	e_book_meta_backend_schedule_refresh (E_BOOK_META_BACKEND (bbetesync));
+}
+
+static void
+e_book_backend_etesync_dispose (GObject *object)
+{
+	EBookBackendEteSync *bbetesync = E_BOOK_BACKEND_ETESYNC (object);
+
+	/* Not under the lock, the upload can be waiting for it */
+	g_clear_pointer (&bbetesync->priv->outbox, e_etesync_outbox_free);
+
+	/* The refreshed token can be still waiting to be stored */
+	e_etesync_service_wait_stores ();
+
+	/* Chain up to parent's method. */
+	G_OBJECT_CLASS (e_book_backend_etesync_parent_class)->dispose (object);
+}
+
 static void
 e_book_backend_etesync_finalize (GObject *object)
 {
@@ -631,7 +892,7 @@ e_book_backend_etesync_finalize (GObject *object)
 static void
 e_book_backend_etesync_constructed (GObject *object)
 {
-	ESource *collection;
+	ESource *collection, *source;
 	EBookBackendEteSync *bbetesync = E_BOOK_BACKEND_ETESYNC (object);
 
 	/* Chain up to parent's constructed() method. */
@@ -640,6 +901,13 @@ e_book_backend_etesync_constructed (GObject *object)
 	collection = ebb_etesync_ref_collection_source (bbetesync);
 	bbetesync->priv->connection = e_etesync_connection_new (collection);
 
+	source = e_backend_get_source (E_BACKEND (bbetesync));
+
+	if (e_source_has_extension (source, E_SOURCE_EXTENSION_ETESYNC)) {
+		g_signal_connect_object (e_source_get_extension (source, E_SOURCE_EXTENSION_ETESYNC), "notify::etebase-collection",
+			G_CALLBACK (ebb_etesync_etebase_collection_notify_cb), bbetesync, 0);
+	}
+
 	g_object_unref (collection);
 }
 
@@ -650,6 +918,7 @@ e_book_backend_etesync_init (EBookBackendEteSync *bbetesync)
 	g_rec_mutex_init (&bbetesync->priv->etesync_lock);
 	bbetesync->priv->connection = NULL;
 	bbetesync->priv->col_obj = NULL;
+	bbetesync->priv->outbox = e_etesync_outbox_new (ebb_etesync_outbox_upload_cb, ebb_etesync_outbox_error_cb, bbetesync);
 	/* coverity[missing_lock] */
 	bbetesync->priv->fetch_from_server = TRUE;
 	bbetesync->priv->preloaded_add = NULL;
@@ -690,5 +959,6 @@ e_book_backend_etesync_class_init (EBookBackendEteSyncClass *klass)
 
 	object_class = G_OBJECT_CLASS (klass);
 	object_class->constructed = e_book_backend_etesync_constructed;
+	object_class->dispose = e_book_backend_etesync_dispose;
 	object_class->finalize = e_book_backend_etesync_finalize;
 }
@@ -7,19 +7,26 @@
 
 #include "evolution-etesync-config.h"
 
+#include <string.h>
+#include <glib/gi18n-lib.h>
+
 #include <libedataserver/libedataserver.h>
 #include <etebase.h>
 
 #include "common/e-source-etesync.h"
+#include "common/e-etesync-cache.h"
 #include "common/e-etesync-connection.h"
 #include "common/e-etesync-utils.h"
 #include "common/e-etesync-defines.h"
+#include "common/e-etesync-outbox.h"
+#include "common/e-etesync-service.h"
 #include "e-cal-backend-etesync.h"
 
 struct _ECalBackendEteSyncPrivate {
 	EEteSyncConnection *connection;
 	EtebaseCollection *col_obj;
 	GRecMutex etesync_lock;
+	EEteSyncOutbox *outbox;
 
 	gboolean fetch_from_server;
 
@@ -84,9 +91,9 @@ ecb_etesync_connect_sync (ECalMetaBackend *meta_backend,
 			ESourceEteSync *etesync_extension;
 
 			etesync_extension = e_source_get_extension (source, E_SOURCE_EXTENSION_ETESYNC);
-			cbetesync->priv->col_obj = e_etesync_utils_etebase_collection_from_base64 (
-								e_source_etesync_get_etebase_collection_b64 (etesync_extension),
-								e_etesync_connection_get_collection_manager (cbetesync->priv->connection));
+			cbetesync->priv->col_obj = e_etesync_connection_dup_collection (cbetesync->priv->connection,
+								e_source_etesync_get_collection_id (etesync_extension),
+								e_source_etesync_get_etebase_collection_b64 (etesync_extension));
 		}
 
 		success = cbetesync->priv->col_obj? TRUE : FALSE;
@@ -94,6 +101,9 @@ ecb_etesync_connect_sync (ECalMetaBackend *meta_backend,
 		if (success) {
 			is_read_only = etebase_collection_get_access_level (cbetesync->priv->col_obj) == ETEBASE_COLLECTION_ACCESS_LEVEL_READ_ONLY;
 			e_cal_backend_set_writable (E_CAL_BACKEND (cbetesync), !is_read_only);
+
+			/* Upload changes left from the previous run */
+			e_etesync_outbox_schedule (cbetesync->priv->outbox);
 		}
 	}
 
@@ -112,6 +122,132 @@ ecb_etesync_disconnect_sync (ECalMetaBackend *meta_backend,
 	return TRUE;
 }
 
+/* EEteSyncOutboxUploadFunc */
+static gboolean
+ecb_etesync_outbox_upload_cb (gpointer user_data,
+			      gboolean *out_done,
+			      GCancellable *cancellable,
+			      GError **error)
+{
+	ECalBackendEteSync *cbetesync = user_data;
+	GSList *modified_objects = NULL, *removed_objects = NULL;
+	gboolean success = TRUE;
+
+	g_rec_mutex_lock (&cbetesync->priv->etesync_lock);
+
+	if (cbetesync->priv->col_obj) {
+		success = e_etesync_connection_queued_items_upload_sync (cbetesync->priv->connection,
+									 E_BACKEND (cbetesync),
+									 E_ETESYNC_CALENDAR,
+									 cbetesync->priv->col_obj,
+									 out_done,
+									 &modified_objects,
+									 &removed_objects,
+									 cancellable,
+									 error);
+	} else {
+		*out_done = TRUE;
+	}
+
+	g_rec_mutex_unlock (&cbetesync->priv->etesync_lock);
+
+	/* The server won the conflicts, store its version */
+	if (success && (modified_objects || removed_objects)) {
+		success = e_cal_meta_backend_process_changes_sync (E_CAL_META_BACKEND (cbetesync), NULL,
+			modified_objects, removed_objects, cancellable, error);
+	}
+
+	g_slist_free_full (modified_objects, e_cal_meta_backend_info_free);
+	g_slist_free_full (removed_objects, e_cal_meta_backend_info_free);
+
+	return success;
+}
+
+/* EEteSyncOutboxErrorFunc */
+static void
+ecb_etesync_outbox_error_cb (gpointer user_data,
+			    const GError *error)
+{
+	ECalBackendEteSync *cbetesync = user_data;
+	gchar *message;
+
+	/* the changes are uploaded once it is online again */
+	if (!e_backend_get_online (E_BACKEND (cbetesync)) || g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+		return;
+
+	message = g_strdup_printf (_("Failed to upload changes, they will be tried again later: %s"),
+		error ? error->message : _("Unknown error"));
+	e_backend_notify_error (E_BACKEND (cbetesync), message);
+	g_free (message);
+}
+
+typedef struct _ListExistingData {
+	ECalMetaBackend *meta_backend;
+	ECalCache *cal_cache;
+	GHashTable *listed_uids; /* gchar *uid ~> NULL */
+	GSList *existing_objects; /* ECalMetaBackendInfo *, without object and extra */
+} ListExistingData;
+
+/* Stores each listed page into the cache right away, together with the stoken
+   to resume the listing from, thus the whole collection is not held in memory */
+static gboolean
+ecb_etesync_list_existing_page_cb (GSList *page_objects, /* ECalMetaBackendInfo * */
+				   const gchar *stoken,
+				   gpointer user_data,
+				   GCancellable *cancellable,
+				   GError **error)
+{
+	ListExistingData *led = user_data;
+	GSList *link, *created_objects = NULL, *modified_objects = NULL;
+	GHashTable *contained = NULL;
+	const gchar **uids;
+	guint ii, n_uids;
+	gboolean success;
+
+	n_uids = g_slist_length (page_objects);
+	uids = g_new0 (const gchar *, n_uids);
+
+	for (link = page_objects, ii = 0; link; link = g_slist_next (link), ii++)
+		uids[ii] = ((ECalMetaBackendInfo *) link->data)->uid;
+
+	success = e_etesync_cache_get_contained_uids_sync (E_CACHE (led->cal_cache), uids, n_uids, &contained, cancellable, error);
+
+	g_free (uids);
+
+	if (!success) {
+		g_hash_table_destroy (contained);
+		g_slist_free_full (page_objects, e_cal_meta_backend_info_free);
+		return FALSE;
+	}
+
+	for (link = page_objects; link; link = g_slist_next (link)) {
+		ECalMetaBackendInfo *nfo = link->data;
+
+		if (g_hash_table_contains (contained, nfo->uid))
+			modified_objects = g_slist_prepend (modified_objects, nfo);
+		else
+			created_objects = g_slist_prepend (created_objects, nfo);
+
+		if (!g_hash_table_contains (led->listed_uids, nfo->uid)) {
+			g_hash_table_add (led->listed_uids, g_strdup (nfo->uid));
+			led->existing_objects = g_slist_prepend (led->existing_objects,
+				e_cal_meta_backend_info_new (nfo->uid, nfo->revision, NULL, NULL));
+		}
+	}
+
+	success = e_cal_meta_backend_process_changes_sync (led->meta_backend, created_objects, modified_objects, NULL, cancellable, error);
+
+	if (success)
+		e_cache_set_key (E_CACHE (led->cal_cache), E_ETESYNC_CACHE_KEY_LIST_STOKEN, stoken, NULL);
+
+	g_hash_table_destroy (contained);
+	g_slist_free (created_objects);
+	g_slist_free (modified_objects);
+	g_slist_free_full (page_objects, e_cal_meta_backend_info_free);
+
+	return success;
+}
+
 static gboolean
 ecb_etesync_list_existing_sync (ECalMetaBackend *meta_backend,
 				gchar **out_new_sync_tag,
@@ -121,6 +257,8 @@ ecb_etesync_list_existing_sync (ECalMetaBackend *meta_backend,
 {
 	ECalBackendEteSync *cbetesync;
 	EEteSyncConnection *connection;
+	ListExistingData led;
+	gchar *resume_stoken;
 	gboolean success;
 
 	g_return_val_if_fail (E_IS_CAL_BACKEND_ETESYNC (meta_backend), FALSE);
@@ -129,12 +267,28 @@ ecb_etesync_list_existing_sync (ECalMetaBackend *meta_backend,
 	cbetesync = E_CAL_BACKEND_ETESYNC (meta_backend);
 	connection = cbetesync->priv->connection;
 
+	led.meta_backend = meta_backend;
+	led.cal_cache = e_cal_meta_backend_ref_cache (meta_backend);
+
+	g_return_val_if_fail (led.cal_cache != NULL, FALSE);
+
+	led.listed_uids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	led.existing_objects = NULL;
+
+	resume_stoken = e_cache_dup_key (E_CACHE (led.cal_cache), E_ETESYNC_CACHE_KEY_LIST_STOKEN, NULL);
+
+	if (resume_stoken && !*resume_stoken)
+		g_clear_pointer (&resume_stoken, g_free);
+
 	g_rec_mutex_lock (&cbetesync->priv->etesync_lock);
 
 	success = e_etesync_connection_list_existing_sync (connection,
 							   E_BACKEND (meta_backend),
 							   E_ETESYNC_CALENDAR,
 							   cbetesync->priv->col_obj,
+							   resume_stoken,
+							   ecb_etesync_list_existing_page_cb,
+							   &led,
 							   out_new_sync_tag,
 							   out_existing_objects,
 							   cancellable,
@@ -142,6 +296,37 @@ ecb_etesync_list_existing_sync (ECalMetaBackend *meta_backend,
 
 	g_rec_mutex_unlock (&cbetesync->priv->etesync_lock);
 
+	if (success) {
+		/* The components stored before the interruption are not listed again */
+		if (resume_stoken) {
+			GSList *uids = NULL, *revisions = NULL, *ulink, *rlink;
+
+			if (e_cache_get_uids (E_CACHE (led.cal_cache), E_CACHE_EXCLUDE_DELETED, &uids, &revisions, cancellable, NULL)) {
+				for (ulink = uids, rlink = revisions; ulink; ulink = g_slist_next (ulink), rlink = g_slist_next (rlink)) {
+					/* the detached instances are part of the master component */
+					if (!strchr (ulink->data, '\n') &&
+					    !g_hash_table_contains (led.listed_uids, ulink->data)) {
+						led.existing_objects = g_slist_prepend (led.existing_objects,
+							e_cal_meta_backend_info_new (ulink->data, rlink ? rlink->data : NULL, NULL, NULL));
+					}
+				}
+			}
+
+			g_slist_free_full (uids, g_free);
+			g_slist_free_full (revisions, g_free);
+		}
+
+		e_cache_set_key (E_CACHE (led.cal_cache), E_ETESYNC_CACHE_KEY_LIST_STOKEN, NULL, NULL);
+
+		*out_existing_objects = g_slist_reverse (led.existing_objects);
+	} else {
+		g_slist_free_full (led.existing_objects, e_cal_meta_backend_info_free);
+	}
+
+	g_hash_table_destroy (led.listed_uids);
+	g_object_unref (led.cal_cache);
+	g_free (resume_stoken);
+
 	return success;
 }
 
@@ -171,13 +356,20 @@ ecb_etesync_get_changes_sync (ECalMetaBackend *meta_backend,
 	*out_modified_objects = NULL;
 	*out_removed_objects = NULL;
 	*out_new_sync_tag = NULL;
+	*out_repeat = FALSE;
 
 	cbetesync = E_CAL_BACKEND_ETESYNC (meta_backend);
 	connection = cbetesync->priv->connection;
 
+	/* Upload the local changes first, thus they are not overwritten by the server
+	   version; those not uploaded are tried again later by the outbox */
+	if (!is_repeat)
+		e_etesync_outbox_flush_sync (cbetesync->priv->outbox, cancellable, NULL);
+
 	g_rec_mutex_lock (&cbetesync->priv->etesync_lock);
 
-	/* Must add preloaded */
+	/* Must add preloaded; they are consumed by the first call, the repeated
+	   calls only add further pages of the changes from the server */
 	*out_created_objects = cbetesync->priv->preloaded_add;
 	*out_modified_objects = cbetesync->priv->preloaded_modify;
 	*out_removed_objects = cbetesync->priv->preloaded_delete;
@@ -186,6 +378,9 @@ ecb_etesync_get_changes_sync (ECalMetaBackend *meta_backend,
 	cbetesync->priv->preloaded_modify = NULL;
 	cbetesync->priv->preloaded_delete = NULL;
 
+	if (!is_repeat)
+		e_etesync_connection_update_collection_from_source (connection, e_backend_get_source (E_BACKEND (meta_backend)), &cbetesync->priv->col_obj);
+
 	if (cbetesync->priv->fetch_from_server) {
 		cal_cache = e_cal_meta_backend_ref_cache (meta_backend);
 
@@ -197,6 +392,7 @@ ecb_etesync_get_changes_sync (ECalMetaBackend *meta_backend,
 									 cbetesync->priv->col_obj,
 									 E_CACHE (cal_cache),
 									 out_new_sync_tag,
+									 out_repeat,
 									 out_created_objects,
 									 out_modified_objects,
 									 out_removed_objects,
@@ -220,6 +416,9 @@ ecb_etesync_load_component_sync (ECalMetaBackend *meta_backend,
 				 GCancellable *cancellable,
 				 GError **error)
 {
+	ECalBackendEteSync *cbetesync;
+	ECalMetaBackendInfo *nfo = NULL;
+	GError *local_error = NULL;
 	gboolean success = FALSE;
 
 	g_return_val_if_fail (E_IS_CAL_BACKEND_ETESYNC (meta_backend), FALSE);
@@ -227,12 +426,46 @@ ecb_etesync_load_component_sync (ECalMetaBackend *meta_backend,
 	g_return_val_if_fail (out_component != NULL, FALSE);
 	g_return_val_if_fail (out_extra != NULL, FALSE);
 
-	/* 1) Call e_cal_meta_backend_refresh_sync() to get components since last_tag */
+	cbetesync = E_CAL_BACKEND_ETESYNC (meta_backend);
+
+	/* 1) Fetch only the required component, when its item is known; the other
+	      changes are received with the refresh, which does not block the caller */
+	g_rec_mutex_lock (&cbetesync->priv->etesync_lock);
+
+	if (e_etesync_connection_item_fetch_sync (cbetesync->priv->connection, E_BACKEND (meta_backend), E_ETESYNC_CALENDAR,
+		cbetesync->priv->col_obj, uid, extra, (gpointer *) &nfo, cancellable, &local_error)) {
+		*out_component = i_cal_component_new_from_string (nfo->object);
+
+		if (*out_component) {
+			*out_extra = g_strdup (nfo->extra);
+			success = TRUE;
+		} else {
+			g_set_error_literal (&local_error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, _("Failed to read item"));
+		}
+
+		e_cal_meta_backend_info_free (nfo);
+	}
+
+	g_rec_mutex_unlock (&cbetesync->priv->etesync_lock);
+
+	if (success) {
+		e_cal_meta_backend_schedule_refresh (meta_backend);
+		return TRUE;
+	}
+
+	if (!g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND)) {
+		g_propagate_error (error, local_error);
+		return FALSE;
+	}
+
+	g_clear_error (&local_error);
+
+	/* 2) Call e_cal_meta_backend_refresh_sync() to get components since last_tag */
 	if (e_cal_meta_backend_refresh_sync (meta_backend, cancellable, error)) {
 		ECalCache *cal_cache;
 		GSList *components = NULL;
 
-		/* 2) Search cache data for the required component */
+		/* 3) Search cache data for the required component */
 		cal_cache = e_cal_meta_backend_ref_cache (meta_backend);
 
 		if (cal_cache) {
@@ -290,11 +523,11 @@ ecb_etesync_save_component_sync (ECalMetaBackend *meta_backend,
 	uid = i_cal_component_get_uid (vcalendar);
 
 	if (overwrite_existing) {
-		success = e_etesync_connection_item_upload_sync (connection, E_BACKEND (meta_backend), cbetesync->priv->col_obj,
-			E_ETESYNC_ITEM_ACTION_MODIFY, content, uid, extra, NULL, out_new_extra, cancellable, error);
+		success = e_etesync_connection_item_queue_sync (connection, E_BACKEND (meta_backend), cbetesync->priv->col_obj,
+			E_ETESYNC_ITEM_ACTION_MODIFY, content, uid, extra, conflict_resolution, NULL, out_new_extra, cancellable, error);
 	} else {
-		success = e_etesync_connection_item_upload_sync (connection, E_BACKEND (meta_backend), cbetesync->priv->col_obj,
-			E_ETESYNC_ITEM_ACTION_CREATE, content, uid, NULL, out_new_uid, out_new_extra, cancellable, error);
+		success = e_etesync_connection_item_queue_sync (connection, E_BACKEND (meta_backend), cbetesync->priv->col_obj,
+			E_ETESYNC_ITEM_ACTION_CREATE, content, uid, NULL, conflict_resolution, out_new_uid, out_new_extra, cancellable, error);
 	}
 
 	g_free (content);
@@ -302,6 +535,9 @@ ecb_etesync_save_component_sync (ECalMetaBackend *meta_backend,
 
 	g_rec_mutex_unlock (&cbetesync->priv->etesync_lock);
 
+	if (success)
+		e_etesync_outbox_schedule (cbetesync->priv->outbox);
+
 	return success;
 }
 
@@ -326,11 +562,14 @@ ecb_etesync_remove_component_sync (ECalMetaBackend *meta_backend,
 
 	g_rec_mutex_lock (&cbetesync->priv->etesync_lock);
 
-	success = e_etesync_connection_item_upload_sync (connection, E_BACKEND (meta_backend), cbetesync->priv->col_obj,
-				E_ETESYNC_ITEM_ACTION_DELETE, NULL, uid, extra, NULL, NULL, cancellable, error);
+	success = e_etesync_connection_item_queue_sync (connection, E_BACKEND (meta_backend), cbetesync->priv->col_obj,
+				E_ETESYNC_ITEM_ACTION_DELETE, NULL, uid, extra, conflict_resolution, NULL, NULL, cancellable, error);
 
 	g_rec_mutex_unlock (&cbetesync->priv->etesync_lock);
 
+	if (success)
+		e_etesync_outbox_schedule (cbetesync->priv->outbox);
+
 	return success;
 }
 
@@ -347,8 +586,13 @@ ecb_etesync_create_objects_sync (ECalBackendSync *backend,
 {
 	ECalBackendEteSync *cbetesync;
 	EEteSyncConnection *connection;
+	GSList *batch_uids = NULL; /* gchar* */
+	GSList *batch_components = NULL; /* ECalComponent* */
+	GSList *batch_info = NULL; /* ECalMetaBackendInfo* */
+	gchar **content;
 	gboolean success = TRUE;
 	const GSList *l;
+	guint length, ii;
 
 	g_return_if_fail (E_IS_CAL_BACKEND_ETESYNC (backend));
 
@@ -359,117 +603,110 @@ ecb_etesync_create_objects_sync (ECalBackendSync *backend,
 	}
 
 	cbetesync = E_CAL_BACKEND_ETESYNC (backend);
+
+	/* The queued changes go first, to keep the order of the changes */
+	if (!e_etesync_outbox_flush_sync (cbetesync->priv->outbox, cancellable, error))
+		return;
+
 	connection = cbetesync->priv->connection;
 	*out_uids = NULL;
 	*out_new_components = NULL;
-	l = calobjs;
+	length = g_slist_length ((GSList *) calobjs);
+	content = g_new0 (gchar *, length);
 
 	g_rec_mutex_lock (&cbetesync->priv->etesync_lock);
 
-	/* extract the components and mass-add them to the server "batch by batch" */
-	while (l && success) {
-		gchar *content[E_ETESYNC_ITEM_PUSH_LIMIT];
-		GSList *batch_uids = NULL; /* gchar* */
-		GSList *batch_components= NULL; /* ECalComponent* */
-		GSList *batch_info = NULL; /* ECalMetaBackendInfo* */
-		guint ii,  batch_length = 0;
-
-		/* Data Preproccessing */
-		for (ii = 0 ; ii < E_ETESYNC_ITEM_PUSH_LIMIT && l; l = l->next, ii++) {
-			ICalComponent *icomp, *vcal;
-			ECalComponent *comp;
-			ICalTime *current;
-			gchar *comp_uid;
-
-			/* Parse the icalendar text */
-			icomp = i_cal_parser_parse_string ((gchar *) l->data);
-			if (!icomp) {
-				success = FALSE;
-				break;
-			}
-			comp = e_cal_component_new_from_icalcomponent (icomp);
-
-			/* Preserve original UID, create a unique UID if needed */
-			if (!i_cal_component_get_uid (icomp)) {
-				gchar *new_uid = e_util_generate_uid ();
-				i_cal_component_set_uid (icomp, new_uid);
-				g_free (new_uid);
-			}
-
-			/* Set the created and last modified times on the component, if not there already */
-			current = i_cal_time_new_current_with_zone (i_cal_timezone_get_utc_timezone ());
-			if (!e_cal_util_component_has_property (icomp, I_CAL_CREATED_PROPERTY)) {
-				/* Update both when CREATED is missing, to make sure the LAST-MODIFIED
-				is not before CREATED */
-				e_cal_component_set_created (comp, current);
-				e_cal_component_set_last_modified (comp, current);
-			} else if (!e_cal_util_component_has_property (icomp, I_CAL_LASTMODIFIED_PROPERTY)) {
-				e_cal_component_set_last_modified (comp, current);
-			}
-			g_object_unref (current);
-
-			/* If no vcaledar exist, create a new one */
-			if (i_cal_component_isa (icomp) != I_CAL_VCALENDAR_COMPONENT) {
-				vcal = e_cal_util_new_top_level ();
-				i_cal_component_take_component (vcal, i_cal_component_clone (icomp));
-				content[ii] = i_cal_component_as_ical_string (vcal);
-				g_object_unref (vcal);
-			} else
-				content[ii] = i_cal_component_as_ical_string (icomp);
-
-			comp_uid = g_strdup (i_cal_component_get_uid (icomp));
-			batch_components = g_slist_prepend (batch_components, e_cal_component_clone (comp));
-			batch_uids = g_slist_prepend (batch_uids, comp_uid);
-
-			g_object_unref (comp);
+	/* extract the components and mass-add them to the server; the connection uploads
+	   them in batches, preparing the next batch while the previous one is uploaded */
+	for (l = calobjs, ii = 0; l && success; l = l->next, ii++) {
+		ICalComponent *icomp, *vcal;
+		ECalComponent *comp;
+		ICalTime *current;
+		gchar *comp_uid;
+
+		/* Parse the icalendar text */
+		icomp = i_cal_parser_parse_string ((gchar *) l->data);
+		if (!icomp) {
+			success = FALSE;
+			break;
 		}
+		comp = e_cal_component_new_from_icalcomponent (icomp);
 
-		batch_length = ii;
-
-		if (success) {
-			success = e_etesync_connection_batch_create_sync (connection,
-									  E_BACKEND (cbetesync),
-									  cbetesync->priv->col_obj,
-									  E_ETESYNC_CALENDAR,
-									  (const gchar *const*) content,
-									  batch_length, /* length of content */
-									  &batch_info,
-									  cancellable,
-									  error);
-
-			if (success) {
-				cbetesync->priv->preloaded_add = g_slist_concat (batch_info, cbetesync->priv->preloaded_add);
-				*out_new_components = g_slist_concat (*out_new_components, batch_components);
-				*out_uids = g_slist_concat (*out_uids, batch_uids);
-			} else {
-				g_slist_free_full (batch_components, g_object_unref);
-				g_slist_free_full (batch_uids, g_free);
-				g_slist_free_full (batch_info, e_cal_meta_backend_info_free);
-			}
-
+		/* Preserve original UID, create a unique UID if needed */
+		if (!i_cal_component_get_uid (icomp)) {
+			gchar *new_uid = e_util_generate_uid ();
+			i_cal_component_set_uid (icomp, new_uid);
+			g_free (new_uid);
 		}
 
-		for (ii = 0; ii < batch_length; ii++)
-			g_free (content[ii]);
+		/* Set the created and last modified times on the component, if not there already */
+		current = i_cal_time_new_current_with_zone (i_cal_timezone_get_utc_timezone ());
+		if (!e_cal_util_component_has_property (icomp, I_CAL_CREATED_PROPERTY)) {
+			/* Update both when CREATED is missing, to make sure the LAST-MODIFIED
+			is not before CREATED */
+			e_cal_component_set_created (comp, current);
+			e_cal_component_set_last_modified (comp, current);
+		} else if (!e_cal_util_component_has_property (icomp, I_CAL_LASTMODIFIED_PROPERTY)) {
+			e_cal_component_set_last_modified (comp, current);
+		}
+		g_object_unref (current);
+
+		/* If no vcaledar exist, create a new one */
+		if (i_cal_component_isa (icomp) != I_CAL_VCALENDAR_COMPONENT) {
+			vcal = e_cal_util_new_top_level ();
+			i_cal_component_take_component (vcal, i_cal_component_clone (icomp));
+			content[ii] = i_cal_component_as_ical_string (vcal);
+			g_object_unref (vcal);
+		} else
+			content[ii] = i_cal_component_as_ical_string (icomp);
+
+		comp_uid = g_strdup (i_cal_component_get_uid (icomp));
+		batch_components = g_slist_prepend (batch_components, e_cal_component_clone (comp));
+		batch_uids = g_slist_prepend (batch_uids, comp_uid);
+
+		g_object_unref (comp);
 	}
 
 	if (success) {
+		success = e_etesync_connection_batch_create_sync (connection,
+								  E_BACKEND (cbetesync),
+								  cbetesync->priv->col_obj,
+								  E_ETESYNC_CALENDAR,
+								  (const gchar *const*) content,
+								  length, /* length of content */
+								  &batch_info,
+								  cancellable,
+								  error);
+	}
+
+	/* The 'batch_info' has only the components, which were stored on the server,
+	   thus store them in the local cache too, even when some others failed */
+	cbetesync->priv->preloaded_add = batch_info;
+
+	if (batch_info) {
 		cbetesync->priv->fetch_from_server = FALSE;
-		e_cal_meta_backend_refresh_sync (E_CAL_META_BACKEND (cbetesync), cancellable, error);
+		e_cal_meta_backend_refresh_sync (E_CAL_META_BACKEND (cbetesync), NULL, NULL);
 		cbetesync->priv->fetch_from_server = TRUE;
+	}
+
+	if (success) {
+		*out_new_components = g_slist_reverse (batch_components);
+		*out_uids = g_slist_reverse (batch_uids);
 	} else {
-		g_slist_free_full (*out_new_components, g_object_unref);
-		g_slist_free_full (*out_uids, g_free);
-		*out_new_components = NULL;
-		*out_uids = NULL;
+		g_slist_free_full (batch_components, g_object_unref);
+		g_slist_free_full (batch_uids, g_free);
 	}
 
 	/* free any data related to this bulk operation */
+	g_slist_free_full (cbetesync->priv->preloaded_add, e_cal_meta_backend_info_free);
 	cbetesync->priv->preloaded_add = NULL;
 
+	for (ii = 0; ii < length; ii++)
+		g_free (content[ii]);
+	g_free (content);
+
 	g_rec_mutex_unlock (&cbetesync->priv->etesync_lock);
 
-	return;
 }
 
 static void
@@ -486,8 +723,13 @@ ecb_etesync_modify_objects_sync (ECalBackendSync *backend,
 	ECalBackendEteSync *cbetesync;
 	ECalCache *cal_cache;
 	EEteSyncConnection *connection;
+	GSList *batch_out_old_components = NULL; /* ECalComponent* */
+	GSList *batch_out_new_components = NULL; /* ECalComponent* */
+	GSList *batch_info = NULL; /* ECalMetaBackendInfo* */
+	gchar **data_uids, **content;
 	gboolean success = TRUE;
 	const GSList *l;
+	guint length, ii, n_contents = 0;
 
 	g_return_if_fail (E_IS_CAL_BACKEND_ETESYNC (backend));
 
@@ -498,111 +740,106 @@ ecb_etesync_modify_objects_sync (ECalBackendSync *backend,
 	}
 
 	cbetesync = E_CAL_BACKEND_ETESYNC (backend);
+
+	/* The queued changes go first, to keep the order of the changes */
+	if (!e_etesync_outbox_flush_sync (cbetesync->priv->outbox, cancellable, error))
+		return;
+
 	cal_cache = e_cal_meta_backend_ref_cache (E_CAL_META_BACKEND (cbetesync));
 	connection = cbetesync->priv->connection;
 	*out_old_components = NULL;
 	*out_new_components = NULL;
-	l = calobjs;
+	length = g_slist_length ((GSList *) calobjs);
+	data_uids = g_new0 (gchar *, length);
+	content = g_new0 (gchar *, length);
 
 	g_rec_mutex_lock (&cbetesync->priv->etesync_lock);
 
-	/* extract the components and mass-add them to the server "batch by batch" */
-	while (l && success) {
-		gchar *data_uids[E_ETESYNC_ITEM_PUSH_LIMIT];
-		gchar *content[E_ETESYNC_ITEM_PUSH_LIMIT];
-		GSList *batch_out_old_components = NULL; /* ECalComponent* */
-		GSList *batch_out_new_components= NULL; /* ECalComponent* */
-		GSList *batch_info = NULL; /* ECalMetaBackendInfo* */
-		guint ii,  batch_length = 0;
-
-		/* Data Preproccessing */
-		for (ii = 0 ; ii < E_ETESYNC_ITEM_PUSH_LIMIT && l; l = l->next, ii++) {
-			ICalComponent *icomp, *vcal;
-			ECalComponent *comp;
-			ICalTime *current;
-			GSList *instances;
-
-			/* Parse the icalendar text */
-			icomp = i_cal_parser_parse_string ((gchar *) l->data);
-			if (!icomp) {
-				success = FALSE;
-				break;
-			}
-			comp = e_cal_component_new_from_icalcomponent (icomp);
-
-			/* Set the created and last modified times on the component, if not there already */
-			current = i_cal_time_new_current_with_zone (i_cal_timezone_get_utc_timezone ());
-			e_cal_component_set_last_modified (comp, current);
-			g_object_unref (current);
-
-			/* If no vcaledar exist, create a new one */
-			if (i_cal_component_isa (icomp) != I_CAL_VCALENDAR_COMPONENT) {
-				vcal = e_cal_util_new_top_level ();
-				i_cal_component_take_component (vcal, i_cal_component_clone (icomp));
-				content[ii] = i_cal_component_as_ical_string (vcal);
-				g_object_unref (vcal);
-			} else
-				content[ii] = i_cal_component_as_ical_string (icomp);
-
-			data_uids[ii] = g_strdup (i_cal_component_get_uid (icomp));
-			batch_out_new_components = g_slist_prepend (batch_out_new_components, e_cal_component_clone (comp));
-
-			if (e_cal_cache_get_components_by_uid (cal_cache, data_uids[ii], &instances, NULL, NULL))
-				batch_out_old_components = g_slist_concat (batch_out_old_components, instances);
-
-			g_object_unref (comp);
-		}
-
-		batch_length = ii;
-
-		if (success) {
-			success = e_etesync_connection_batch_modify_sync (connection,
-									  E_BACKEND (cbetesync),
-									  cbetesync->priv->col_obj,
-									  E_ETESYNC_CALENDAR,
-									  (const gchar *const*) content,
-									  (const gchar *const*) data_uids,
-									  batch_length, /* length of batch */
-									  E_CACHE (cal_cache), /* uses cal_cache if type is calendar */
-									  &batch_info,
-									  cancellable,
-									  error);
-
-			if (success) {
-				cbetesync->priv->preloaded_modify = g_slist_concat (batch_info, cbetesync->priv->preloaded_modify);
-				*out_new_components = g_slist_concat (*out_new_components, batch_out_new_components);
-				*out_old_components = g_slist_concat (*out_old_components, batch_out_old_components);
-			} else {
-				g_slist_free_full (batch_out_new_components, g_object_unref);
-				g_slist_free_full (batch_out_old_components, g_object_unref);
-				g_slist_free_full (batch_info, e_cal_meta_backend_info_free);
-			}
+	/* extract the components and mass-modify them on the server; the connection uploads
+	   them in batches, preparing the next batch while the previous one is uploaded */
+	for (l = calobjs, ii = 0; l && success; l = l->next, ii++) {
+		ICalComponent *icomp, *vcal;
+		ECalComponent *comp;
+		ICalTime *current;
+		GSList *instances;
+
+		/* Parse the icalendar text */
+		icomp = i_cal_parser_parse_string ((gchar *) l->data);
+		if (!icomp) {
+			success = FALSE;
+			break;
 		}
+		comp = e_cal_component_new_from_icalcomponent (icomp);
+
+		/* Set the created and last modified times on the component, if not there already */
+		current = i_cal_time_new_current_with_zone (i_cal_timezone_get_utc_timezone ());
+		e_cal_component_set_last_modified (comp, current);
+		g_object_unref (current);
+
+		/* If no vcaledar exist, create a new one */
+		if (i_cal_component_isa (icomp) != I_CAL_VCALENDAR_COMPONENT) {
+			vcal = e_cal_util_new_top_level ();
+			i_cal_component_take_component (vcal, i_cal_component_clone (icomp));
+			content[ii] = i_cal_component_as_ical_string (vcal);
+			g_object_unref (vcal);
+		} else
+			content[ii] = i_cal_component_as_ical_string (icomp);
+
+		data_uids[ii] = g_strdup (i_cal_component_get_uid (icomp));
+		batch_out_new_components = g_slist_prepend (batch_out_new_components, e_cal_component_clone (comp));
+
+		if (e_cal_cache_get_components_by_uid (cal_cache, data_uids[ii], &instances, NULL, NULL))
+			batch_out_old_components = g_slist_concat (batch_out_old_components, instances);
 
-		for (ii = 0; ii < batch_length; ii++) {
-			g_free (content[ii]);
-			g_free (data_uids[ii]);
-		}
+		g_object_unref (comp);
 	}
 
 	if (success) {
+		success = e_etesync_connection_batch_modify_sync (connection,
+								  E_BACKEND (cbetesync),
+								  cbetesync->priv->col_obj,
+								  E_ETESYNC_CALENDAR,
+								  (const gchar *const*) content,
+								  (const gchar *const*) data_uids,
+								  n_contents, /* length of batch */
+								  E_CACHE (cal_cache), /* uses cal_cache if type is calendar */
+								  &batch_info,
+								  cancellable,
+								  error);
+	}
+
+	/* The 'batch_info' has only the components, which were stored on the server,
+	   thus store them in the local cache too, even when some others failed */
+	cbetesync->priv->preloaded_modify = batch_info;
+
+	if (batch_info) {
 		cbetesync->priv->fetch_from_server = FALSE;
-		e_cal_meta_backend_refresh_sync (E_CAL_META_BACKEND (cbetesync), cancellable, error);
+		e_cal_meta_backend_refresh_sync (E_CAL_META_BACKEND (cbetesync), NULL, NULL);
 		cbetesync->priv->fetch_from_server = TRUE;
+	}
+
+	if (success) {
+		*out_new_components = g_slist_reverse (batch_out_new_components);
+		*out_old_components = batch_out_old_components;
 	} else {
-		g_slist_free_full (*out_new_components, g_object_unref);
-		g_slist_free_full (*out_old_components, g_object_unref);
-		*out_new_components = NULL;
-		*out_old_components = NULL;
+		g_slist_free_full (batch_out_new_components, g_object_unref);
+		g_slist_free_full (batch_out_old_components, g_object_unref);
 	}
 
 	/* free any data related to this bulk operation */
+	g_slist_free_full (cbetesync->priv->preloaded_modify, e_cal_meta_backend_info_free);
 	cbetesync->priv->preloaded_modify = NULL;
 	g_object_unref (cal_cache);
 
+	for (ii = 0; ii < length; ii++) {
+		g_free (content[ii]);
+		g_free (data_uids[ii]);
+	}
+	g_free (content);
+	g_free (data_uids);
+
 	g_rec_mutex_unlock (&cbetesync->priv->etesync_lock);
 
-	return;
 }
 
 static void
@@ -619,8 +856,12 @@ ecb_etesync_remove_objects_sync (ECalBackendSync *backend,
 	ECalBackendEteSync *cbetesync;
 	ECalCache *cal_cache;
 	EEteSyncConnection *connection;
+	GSList *batch_out_old_components = NULL; /* ECalComponent* */
+	GSList *batch_info = NULL; /* ECalMetaBackendInfo* */
+	gchar **data_uids, **content;
 	gboolean success = TRUE;
 	const GSList *l;
+	guint length, ii, n_contents = 0;
 
 	g_return_if_fail (E_IS_CAL_BACKEND_ETESYNC (backend));
 
@@ -631,87 +872,88 @@ ecb_etesync_remove_objects_sync (ECalBackendSync *backend,
 	}
 
 	cbetesync = E_CAL_BACKEND_ETESYNC (backend);
+
+	/* The queued changes go first, to keep the order of the changes */
+	if (!e_etesync_outbox_flush_sync (cbetesync->priv->outbox, cancellable, error))
+		return;
+
 	cal_cache = e_cal_meta_backend_ref_cache (E_CAL_META_BACKEND (cbetesync));
 	connection = cbetesync->priv->connection;
 	*out_old_components = NULL;
 	*out_new_components = NULL;
-	l = ids;
+	length = g_slist_length ((GSList *) ids);
+	data_uids = g_new0 (gchar *, length);
+	content = g_new0 (gchar *, length);
 
 	g_rec_mutex_lock (&cbetesync->priv->etesync_lock);
 
-	/* extract the components and mass-add them to the server "batch by batch" */
-	while (l && success) {
-		gchar *data_uids[E_ETESYNC_ITEM_PUSH_LIMIT];
-		gchar *content[E_ETESYNC_ITEM_PUSH_LIMIT];
-		GSList *batch_out_old_components = NULL; /* ECalComponent* */
-		GSList *batch_info = NULL; /* ECalMetaBackendInfo* */
-		guint ii,  batch_length = 0;
-
-		/* Data Preproccessing */
-		for (ii = 0; ii < E_ETESYNC_ITEM_PUSH_LIMIT && l; l = l->next, ii++) {
-			ICalComponent *vcal;
-			GSList *instances;
-
-			if (e_cal_cache_get_components_by_uid (cal_cache, e_cal_component_id_get_uid (l->data), &instances, cancellable, NULL)) {
-				vcal = e_cal_meta_backend_merge_instances (E_CAL_META_BACKEND (cbetesync), instances, TRUE);
-				content[ii] = i_cal_component_as_ical_string (vcal);
-				data_uids[ii] = g_strdup (e_cal_component_id_get_uid (l->data));
-				g_object_unref (vcal);
-			} else {
-				success = FALSE;
-				break;
-			}
+	/* extract the components and mass-remove them from the server; the connection uploads
+	   them in batches, preparing the next batch while the previous one is uploaded */
+	for (l = ids; l; l = l->next) {
+		ICalComponent *vcal;
+		GSList *instances = NULL;
 
-			batch_out_old_components = g_slist_concat (batch_out_old_components, instances);
-			*out_new_components = g_slist_prepend (*out_new_components, NULL);
-		}
+		/* the components, which are not in the cache, are already gone, thus skipped */
+		if (!e_cal_cache_get_components_by_uid (cal_cache, e_cal_component_id_get_uid (l->data), &instances, cancellable, NULL))
+			continue;
 
-		batch_length = ii;
+		vcal = e_cal_meta_backend_merge_instances (E_CAL_META_BACKEND (cbetesync), instances, TRUE);
+		content[n_contents] = i_cal_component_as_ical_string (vcal);
+		data_uids[n_contents] = g_strdup (e_cal_component_id_get_uid (l->data));
+		n_contents++;
+		g_object_unref (vcal);
 
-		if (success) {
-			success = e_etesync_connection_batch_delete_sync (connection,
-									  E_BACKEND (cbetesync),
-									  cbetesync->priv->col_obj,
-									  E_ETESYNC_CALENDAR,
-									  (const gchar *const*) content,
-									  (const gchar *const*) data_uids,
-									  batch_length, /* length of batch */
-									  E_CACHE (cal_cache), /* uses cal_cache if type is calendar */
-									  &batch_info,
-									  cancellable,
-									  error);
-
-			if (success) {
-				cbetesync->priv->preloaded_delete = g_slist_concat (batch_info, cbetesync->priv->preloaded_delete);
-				*out_old_components = g_slist_concat (*out_old_components, batch_out_old_components);
-			} else {
-				g_slist_free_full (batch_out_old_components, g_object_unref);
-				g_slist_free_full (batch_info, e_cal_meta_backend_info_free);
-			}
-		}
+		batch_out_old_components = g_slist_concat (batch_out_old_components, instances);
+	}
 
-		for (ii = 0; ii < batch_length; ii++) {
-			g_free (content[ii]);
-			g_free (data_uids[ii]);
-		}
+	if (n_contents) {
+		success = e_etesync_connection_batch_delete_sync (connection,
+								  E_BACKEND (cbetesync),
+								  cbetesync->priv->col_obj,
+								  E_ETESYNC_CALENDAR,
+								  (const gchar *const*) content,
+								  (const gchar *const*) data_uids,
+								  n_contents, /* length of batch */
+								  E_CACHE (cal_cache), /* uses cal_cache if type is calendar */
+								  &batch_info,
+								  cancellable,
+								  error);
 	}
 
-	if (success) {
+	/* The 'batch_info' has only the components, which were removed on the server,
+	   thus remove them from the local cache too, even when some others failed;
+	   the error is returned then, though the removed components are notified */
+	cbetesync->priv->preloaded_delete = batch_info;
+
+	if (batch_info) {
 		cbetesync->priv->fetch_from_server = FALSE;
-		e_cal_meta_backend_refresh_sync (E_CAL_META_BACKEND (cbetesync), cancellable, error);
+		e_cal_meta_backend_refresh_sync (E_CAL_META_BACKEND (cbetesync), NULL, NULL);
 		cbetesync->priv->fetch_from_server = TRUE;
+	}
+
+	if (success) {
+		*out_old_components = batch_out_old_components;
+
+		for (ii = 0; ii < n_contents; ii++)
+			*out_new_components = g_slist_prepend (*out_new_components, NULL);
 	} else {
-		g_slist_free_full (*out_old_components, g_object_unref);
-		*out_old_components = NULL;
+		g_slist_free_full (batch_out_old_components, g_object_unref);
 	}
 
 	/* free any data related to this bulk operation */
+	g_slist_free_full (cbetesync->priv->preloaded_delete, e_cal_meta_backend_info_free);
 	cbetesync->priv->preloaded_delete = NULL;
 	g_object_unref (cal_cache);
 
+	for (ii = 0; ii < length; ii++) {
+		g_free (content[ii]);
+		g_free (data_uids[ii]);
+	}
+	g_free (content);
+	g_free (data_uids);
+
 	g_rec_mutex_unlock (&cbetesync->priv->etesync_lock);
 
-	return;
 }
 
 static gchar *
@@ -747,6 +989,33 @@ ecb_etesync_get_backend_property (ECalBackend *cal_backend,
 	return E_CAL_BACKEND_CLASS (e_cal_backend_etesync_parent_class)->impl_get_backend_property (cal_backend, prop_name);
 }
 
+/* The registry stores the collection, as it has it from the server, when
+   it changed; the refresh picks it up, not to block the main thread here */
+static void
+ecb_etesync_etebase_collection_notify_cb (ESourceEteSync *etesync_extension,
+					 GParamSpec *param,
+					 gpointer user_data)
+{
+	ECalBackendEteSync *cbetesync = user_data;
+
+	e_cal_meta_backend_schedule_refresh (E_CAL_META_BACKEND (cbetesync));
+}
+
+static void
+e_cal_backend_etesync_dispose (GObject *object)
+{
+	ECalBackendEteSync *cbetesync = E_CAL_BACKEND_ETESYNC (object);
+
+	/* Not under the lock, the upload can be waiting for it */
+	g_clear_pointer (&cbetesync->priv->outbox, e_etesync_outbox_free);
+
+	/* The refreshed token can be still waiting to be stored */
+	e_etesync_service_wait_stores ();
+
+	/* Chain up to parent's method. */
+	G_OBJECT_CLASS (e_cal_backend_etesync_parent_class)->dispose (object);
+}
+
 static void
 e_cal_backend_etesync_finalize (GObject *object)
 {
@@ -766,7 +1035,7 @@ e_cal_backend_etesync_finalize (GObject *object)
 static void
 e_cal_backend_etesync_constructed (GObject *object)
 {
-	ESource *collection;
+	ESource *collection, *source;
 	ECalBackendEteSync *cbetesync = E_CAL_BACKEND_ETESYNC (object);
 
 	/* Chain up to parent's constructed() method. */
@@ -775,6 +1044,13 @@ e_cal_backend_etesync_constructed (GObject *object)
 	collection = ecb_etesync_ref_collection_source (cbetesync);
 	cbetesync->priv->connection = e_etesync_connection_new (collection);
 
+	source = e_backend_get_source (E_BACKEND (cbetesync));
+
+	if (e_source_has_extension (source, E_SOURCE_EXTENSION_ETESYNC)) {
+		g_signal_connect_object (e_source_get_extension (source, E_SOURCE_EXTENSION_ETESYNC), "notify::etebase-collection",
+			G_CALLBACK (ecb_etesync_etebase_collection_notify_cb), cbetesync, 0);
+	}
+
 	g_object_unref (collection);
 }
 
@@ -785,6 +1061,7 @@ e_cal_backend_etesync_init (ECalBackendEteSync *cbetesync)
 	g_rec_mutex_init (&cbetesync->priv->etesync_lock);
 	cbetesync->priv->connection = NULL;
 	cbetesync->priv->col_obj = NULL;
+	cbetesync->priv->outbox = e_etesync_outbox_new (ecb_etesync_outbox_upload_cb, ecb_etesync_outbox_error_cb, cbetesync);
 	/* coverity[missing_lock] */
 	cbetesync->priv->fetch_from_server = TRUE;
 	cbetesync->priv->preloaded_add = NULL;
@@ -819,5 +1096,6 @@ e_cal_backend_etesync_class_init (ECalBackendEteSyncClass *klass)
 
 	object_class = G_OBJECT_CLASS (klass);
 	object_class->constructed = e_cal_backend_etesync_constructed;
+	object_class->dispose = e_cal_backend_etesync_dispose;
 	object_class->finalize = e_cal_backend_etesync_finalize;
 }
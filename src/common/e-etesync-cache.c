@@ -0,0 +1,812 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/* e-etesync-cache.c - EteSync specific data stored in the ECache database.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "evolution-etesync-config.h"
+
+#include <string.h>
+#include <sqlite3.h>
+
+#include "e-etesync-defines.h"
+#include "e-etesync-cache.h"
+
+#define ITEMS_TABLE "etesync_items"
+#define ITEMS_DATA_TABLE "etesync_items_data"
+#define OUTBOX_TABLE "etesync_outbox"
+
+EEteSyncCacheItem *
+e_etesync_cache_item_new (const gchar *item_uid,
+			  const gchar *uid,
+			  const gchar *etag)
+{
+	EEteSyncCacheItem *item;
+
+	item = g_slice_new0 (EEteSyncCacheItem);
+	item->item_uid = g_strdup (item_uid);
+	item->uid = g_strdup (uid);
+	item->etag = g_strdup (etag);
+
+	return item;
+}
+
+void
+e_etesync_cache_item_free (gpointer ptr)
+{
+	EEteSyncCacheItem *item = ptr;
+
+	if (item) {
+		g_free (item->item_uid);
+		g_free (item->uid);
+		g_free (item->etag);
+		g_slice_free (EEteSyncCacheItem, item);
+	}
+}
+
+static gboolean
+e_etesync_cache_ensure_tables_sync (ECache *cache,
+				    GCancellable *cancellable,
+				    GError **error)
+{
+	if (g_object_get_data (G_OBJECT (cache), ITEMS_TABLE))
+		return TRUE;
+
+	if (!e_cache_sqlite_exec (cache,
+		"CREATE TABLE IF NOT EXISTS " ITEMS_TABLE " ("
+		"item_uid TEXT PRIMARY KEY, "
+		"uid TEXT, "
+		"etag TEXT)",
+		cancellable, error))
+		return FALSE;
+
+	if (!e_cache_sqlite_exec (cache,
+		"CREATE INDEX IF NOT EXISTS " ITEMS_TABLE "_uid ON " ITEMS_TABLE " (uid)",
+		cancellable, error))
+		return FALSE;
+
+	/* The cached EtebaseItem-s, as saved by the item manager; they are stored
+	   as blobs, which the ECache API cannot do, thus it uses sqlite directly */
+	if (!e_cache_sqlite_exec (cache,
+		"CREATE TABLE IF NOT EXISTS " ITEMS_DATA_TABLE " ("
+		"item_uid TEXT PRIMARY KEY, "
+		"data BLOB)",
+		cancellable, error))
+		return FALSE;
+
+	/* The items changed locally, which wait to be uploaded; their data is
+	   in the ITEMS_DATA_TABLE, in the order of the rowid. The 'error' is set
+	   for those, which failed to be uploaded, until they are changed again. */
+	if (!e_cache_sqlite_exec (cache,
+		"CREATE TABLE IF NOT EXISTS " OUTBOX_TABLE " ("
+		"item_uid TEXT PRIMARY KEY, "
+		"uid TEXT, "
+		"conflict_resolution INTEGER, "
+		"error TEXT)",
+		cancellable, error))
+		return FALSE;
+
+	g_object_set_data (G_OBJECT (cache), ITEMS_TABLE, GINT_TO_POINTER (1));
+
+	return TRUE;
+}
+
+static gboolean
+e_etesync_cache_get_item_etags_cb (ECache *cache,
+				   gint ncols,
+				   const gchar *column_names[],
+				   const gchar *column_values[],
+				   gpointer user_data)
+{
+	GHashTable *etags = user_data;
+
+	g_return_val_if_fail (ncols == 2, FALSE);
+
+	if (column_values[0] && column_values[1])
+		g_hash_table_insert (etags, g_strdup (column_values[0]), g_strdup (column_values[1]));
+
+	return TRUE;
+}
+
+/* Sets 'out_etags' to a new GHashTable of item_uid ~> etag for those of the 'item_uids',
+   which are stored in the 'cache'. Free it with g_hash_table_destroy(). */
+gboolean
+e_etesync_cache_get_item_etags_sync (ECache *cache,
+				     const gchar *const *item_uids,
+				     guint n_item_uids,
+				     GHashTable **out_etags,
+				     GCancellable *cancellable,
+				     GError **error)
+{
+	GString *stmt;
+	guint ii;
+	gboolean success;
+
+	g_return_val_if_fail (E_IS_CACHE (cache), FALSE);
+	g_return_val_if_fail (out_etags != NULL, FALSE);
+
+	*out_etags = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+	if (!n_item_uids)
+		return TRUE;
+
+	if (!e_etesync_cache_ensure_tables_sync (cache, cancellable, error))
+		return FALSE;
+
+	stmt = g_string_new ("SELECT item_uid, etag FROM " ITEMS_TABLE " WHERE item_uid IN (");
+
+	for (ii = 0; ii < n_item_uids; ii++) {
+		if (ii)
+			g_string_append_c (stmt, ',');
+		e_cache_sqlite_stmt_append_printf (stmt, "%Q", item_uids[ii]);
+	}
+
+	g_string_append_c (stmt, ')');
+
+	success = e_cache_sqlite_select (cache, stmt->str, e_etesync_cache_get_item_etags_cb, *out_etags, cancellable, error);
+
+	g_string_free (stmt, TRUE);
+
+	return success;
+}
+
+static gboolean
+e_etesync_cache_dup_item_uid_cb (ECache *cache,
+				 gint ncols,
+				 const gchar *column_names[],
+				 const gchar *column_values[],
+				 gpointer user_data)
+{
+	gchar **out_item_uid = user_data;
+
+	g_return_val_if_fail (ncols == 1, FALSE);
+
+	if (!*out_item_uid)
+		*out_item_uid = g_strdup (column_values[0]);
+
+	return TRUE;
+}
+
+/* Sets 'out_item_uid' to the UID of the EteSync item holding the contact
+   or the component 'uid', or to NULL, when it's not known. Free it with g_free(). */
+gboolean
+e_etesync_cache_dup_item_uid_sync (ECache *cache,
+				   const gchar *uid,
+				   gchar **out_item_uid,
+				   GCancellable *cancellable,
+				   GError **error)
+{
+	gchar *stmt;
+	gboolean success;
+
+	g_return_val_if_fail (E_IS_CACHE (cache), FALSE);
+	g_return_val_if_fail (uid != NULL, FALSE);
+	g_return_val_if_fail (out_item_uid != NULL, FALSE);
+
+	*out_item_uid = NULL;
+
+	if (!e_etesync_cache_ensure_tables_sync (cache, cancellable, error))
+		return FALSE;
+
+	stmt = e_cache_sqlite_stmt_printf ("SELECT item_uid FROM " ITEMS_TABLE " WHERE uid=%Q LIMIT 1", uid);
+
+	success = e_cache_sqlite_select (cache, stmt, e_etesync_cache_dup_item_uid_cb, out_item_uid, cancellable, error);
+
+	e_cache_sqlite_stmt_free (stmt);
+
+	return success;
+}
+
+static gboolean
+e_etesync_cache_get_contained_uids_cb (ECache *cache,
+				       gint ncols,
+				       const gchar *column_names[],
+				       const gchar *column_values[],
+				       gpointer user_data)
+{
+	GHashTable *contained = user_data;
+
+	g_return_val_if_fail (ncols == 1, FALSE);
+
+	if (column_values[0])
+		g_hash_table_add (contained, g_strdup (column_values[0]));
+
+	return TRUE;
+}
+
+/* Sets 'out_contained' to a new set of those 'uids', which the 'cache' contains,
+   not counting the locally deleted objects, the same as e_cache_contains() with
+   E_CACHE_EXCLUDE_DELETED, only with one query. Free it with g_hash_table_destroy(). */
+gboolean
+e_etesync_cache_get_contained_uids_sync (ECache *cache,
+					 const gchar *const *uids,
+					 guint n_uids,
+					 GHashTable **out_contained,
+					 GCancellable *cancellable,
+					 GError **error)
+{
+	GString *stmt;
+	guint ii;
+	gboolean success;
+
+	g_return_val_if_fail (E_IS_CACHE (cache), FALSE);
+	g_return_val_if_fail (out_contained != NULL, FALSE);
+
+	*out_contained = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	if (!n_uids)
+		return TRUE;
+
+	stmt = g_string_new ("");
+
+	e_cache_sqlite_stmt_append_printf (stmt, "SELECT " E_CACHE_COLUMN_UID " FROM " E_CACHE_TABLE_OBJECTS
+		" WHERE " E_CACHE_COLUMN_STATE "!=%d AND " E_CACHE_COLUMN_UID " IN (", E_OFFLINE_STATE_LOCALLY_DELETED);
+
+	for (ii = 0; ii < n_uids; ii++) {
+		if (ii)
+			g_string_append_c (stmt, ',');
+		e_cache_sqlite_stmt_append_printf (stmt, "%Q", uids[ii]);
+	}
+
+	g_string_append_c (stmt, ')');
+
+	success = e_cache_sqlite_select (cache, stmt->str, e_etesync_cache_get_contained_uids_cb, *out_contained, cancellable, error);
+
+	g_string_free (stmt, TRUE);
+
+	return success;
+}
+
+/* Stores the 'items' into the 'cache', in one transaction; the items without
+   an etag are removed from it, together with their data */
+gboolean
+e_etesync_cache_store_items_sync (ECache *cache,
+				  const GSList *items, /* EEteSyncCacheItem * */
+				  GCancellable *cancellable,
+				  GError **error)
+{
+	const GSList *link;
+	gboolean success;
+
+	g_return_val_if_fail (E_IS_CACHE (cache), FALSE);
+
+	if (!items)
+		return TRUE;
+
+	if (!e_etesync_cache_ensure_tables_sync (cache, cancellable, error))
+		return FALSE;
+
+	e_cache_lock (cache, E_CACHE_LOCK_WRITE);
+
+	for (link = items, success = TRUE; link && success; link = g_slist_next (link)) {
+		EEteSyncCacheItem *item = link->data;
+		gchar *stmt;
+
+		if (item->etag) {
+			stmt = e_cache_sqlite_stmt_printf ("INSERT OR REPLACE INTO " ITEMS_TABLE " (item_uid, uid, etag) VALUES (%Q, %Q, %Q)",
+				item->item_uid, item->uid, item->etag);
+		} else {
+			stmt = e_cache_sqlite_stmt_printf ("DELETE FROM " ITEMS_TABLE " WHERE item_uid=%Q", item->item_uid);
+		}
+
+		success = e_cache_sqlite_exec (cache, stmt, cancellable, error);
+
+		e_cache_sqlite_stmt_free (stmt);
+
+		if (success && !item->etag) {
+			stmt = e_cache_sqlite_stmt_printf ("DELETE FROM " ITEMS_DATA_TABLE " WHERE item_uid=%Q", item->item_uid);
+			success = e_cache_sqlite_exec (cache, stmt, cancellable, error);
+			e_cache_sqlite_stmt_free (stmt);
+		}
+	}
+
+	e_cache_unlock (cache, success ? E_CACHE_UNLOCK_COMMIT : E_CACHE_UNLOCK_ROLLBACK);
+
+	return success;
+}
+
+static gboolean
+e_etesync_cache_get_unqueued_data_uids_cb (ECache *cache,
+					   gint ncols,
+					   const gchar *column_names[],
+					   const gchar *column_values[],
+					   gpointer user_data)
+{
+	GSList **pitem_uids = user_data;
+
+	g_return_val_if_fail (ncols == 1, FALSE);
+
+	if (column_values[0])
+		*pitem_uids = g_slist_prepend (*pitem_uids, g_strdup (column_values[0]));
+
+	return TRUE;
+}
+
+/* Removes the item data, which neither a stored object refers to by its extra,
+   nor a queued change waits for; like of the objects removed by a resync */
+static gboolean
+e_etesync_cache_remove_orphan_item_data_sync (ECache *cache,
+					      GCancellable *cancellable,
+					      GError **error)
+{
+	GHashTable *referenced;
+	GSList *extras = NULL, *item_uids = NULL, *link;
+	GString *stmt = NULL;
+	gboolean success;
+
+	if (!e_cache_get_uids_with_extras (cache, E_CACHE_INCLUDE_DELETED, NULL, &extras, cancellable, error))
+		return FALSE;
+
+	referenced = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	/* the extra is the prefix, the item UID, a colon and the etag */
+	for (link = extras; link; link = g_slist_next (link)) {
+		const gchar *extra = link->data, *sep;
+
+		if (!extra || !g_str_has_prefix (extra, E_ETESYNC_ITEM_EXTRA_PREFIX))
+			continue;
+
+		extra += strlen (E_ETESYNC_ITEM_EXTRA_PREFIX);
+		sep = strchr (extra, ':');
+
+		if (sep)
+			g_hash_table_add (referenced, g_strndup (extra, sep - extra));
+	}
+
+	g_slist_free_full (extras, g_free);
+
+	success = e_cache_sqlite_select (cache, "SELECT item_uid FROM " ITEMS_DATA_TABLE " WHERE "
+		"item_uid NOT IN (SELECT item_uid FROM " OUTBOX_TABLE ")",
+		e_etesync_cache_get_unqueued_data_uids_cb, &item_uids, cancellable, error);
+
+	for (link = item_uids; link && success; link = g_slist_next (link)) {
+		const gchar *item_uid = link->data;
+
+		if (g_hash_table_contains (referenced, item_uid))
+			continue;
+
+		if (stmt) {
+			g_string_append_c (stmt, ',');
+		} else {
+			stmt = g_string_new ("DELETE FROM " ITEMS_DATA_TABLE " WHERE item_uid IN (");
+		}
+
+		e_cache_sqlite_stmt_append_printf (stmt, "%Q", item_uid);
+	}
+
+	if (stmt) {
+		g_string_append_c (stmt, ')');
+
+		if (success)
+			success = e_cache_sqlite_exec (cache, stmt->str, cancellable, error);
+
+		g_string_free (stmt, TRUE);
+	}
+
+	g_slist_free_full (item_uids, g_free);
+	g_hash_table_destroy (referenced);
+
+	return success;
+}
+
+/* Removes all the item states, when the items are listed from the start again; the item
+   data is kept, because the cached objects still refer to it, only the data of the objects,
+   which are gone, is removed */
+gboolean
+e_etesync_cache_remove_all_items_sync (ECache *cache,
+				       GCancellable *cancellable,
+				       GError **error)
+{
+	gboolean success;
+
+	g_return_val_if_fail (E_IS_CACHE (cache), FALSE);
+
+	if (!e_etesync_cache_ensure_tables_sync (cache, cancellable, error))
+		return FALSE;
+
+	e_cache_lock (cache, E_CACHE_LOCK_WRITE);
+
+	success = e_cache_sqlite_exec (cache, "DELETE FROM " ITEMS_TABLE, cancellable, error) &&
+		e_etesync_cache_remove_orphan_item_data_sync (cache, cancellable, error);
+
+	e_cache_unlock (cache, success ? E_CACHE_UNLOCK_COMMIT : E_CACHE_UNLOCK_ROLLBACK);
+
+	return success;
+}
+
+static void
+e_etesync_cache_set_sqlite_error (sqlite3 *db,
+				  GError **error)
+{
+	g_set_error (error, E_CACHE_ERROR, E_CACHE_ERROR_ENGINE, "%s", sqlite3_errmsg (db));
+}
+
+/* Stores the cached EtebaseItem-s into the 'cache', in one transaction. The 'data'
+   is an array of 'n_items' blobs for the 'item_uids'; NULL items are skipped, as well
+   as the queued items, which hold local changes, not uploaded yet. */
+gboolean
+e_etesync_cache_store_item_data_sync (ECache *cache,
+				      const gchar *const *item_uids,
+				      GBytes *const *data,
+				      guint n_items,
+				      GCancellable *cancellable,
+				      GError **error)
+{
+	sqlite3 *db;
+	sqlite3_stmt *stmt = NULL;
+	guint ii;
+	gboolean success = TRUE;
+
+	g_return_val_if_fail (E_IS_CACHE (cache), FALSE);
+
+	if (!n_items)
+		return TRUE;
+
+	if (!e_etesync_cache_ensure_tables_sync (cache, cancellable, error))
+		return FALSE;
+
+	db = e_cache_get_sqlitedb (cache);
+
+	e_cache_lock (cache, E_CACHE_LOCK_WRITE);
+
+	if (sqlite3_prepare_v2 (db, "INSERT OR REPLACE INTO " ITEMS_DATA_TABLE " (item_uid, data) SELECT ?1, ?2 "
+		"WHERE NOT EXISTS (SELECT 1 FROM " OUTBOX_TABLE " WHERE item_uid=?1)", -1, &stmt, NULL) != SQLITE_OK) {
+		e_etesync_cache_set_sqlite_error (db, error);
+		success = FALSE;
+	}
+
+	for (ii = 0; ii < n_items && success; ii++) {
+		gconstpointer blob;
+		gsize blob_len;
+
+		if (!item_uids[ii] || !data[ii])
+			continue;
+
+		if (g_cancellable_set_error_if_cancelled (cancellable, error)) {
+			success = FALSE;
+			break;
+		}
+
+		blob = g_bytes_get_data (data[ii], &blob_len);
+
+		sqlite3_bind_text (stmt, 1, item_uids[ii], -1, SQLITE_STATIC);
+		sqlite3_bind_blob (stmt, 2, blob, blob_len, SQLITE_STATIC);
+
+		if (sqlite3_step (stmt) != SQLITE_DONE) {
+			e_etesync_cache_set_sqlite_error (db, error);
+			success = FALSE;
+		}
+
+		sqlite3_reset (stmt);
+		sqlite3_clear_bindings (stmt);
+	}
+
+	sqlite3_finalize (stmt);
+
+	e_cache_unlock (cache, success ? E_CACHE_UNLOCK_COMMIT : E_CACHE_UNLOCK_ROLLBACK);
+
+	return success;
+}
+
+/* Sets the 'out_data' to the cached EtebaseItem for the 'item_uid', or to NULL,
+   when it's not stored. Free it with g_bytes_unref(). */
+gboolean
+e_etesync_cache_dup_item_data_sync (ECache *cache,
+				    const gchar *item_uid,
+				    GBytes **out_data,
+				    GCancellable *cancellable,
+				    GError **error)
+{
+	sqlite3 *db;
+	sqlite3_stmt *stmt = NULL;
+	gboolean success = TRUE;
+	gint rc;
+
+	g_return_val_if_fail (E_IS_CACHE (cache), FALSE);
+	g_return_val_if_fail (item_uid != NULL, FALSE);
+	g_return_val_if_fail (out_data != NULL, FALSE);
+
+	*out_data = NULL;
+
+	if (!e_etesync_cache_ensure_tables_sync (cache, cancellable, error))
+		return FALSE;
+
+	db = e_cache_get_sqlitedb (cache);
+
+	e_cache_lock (cache, E_CACHE_LOCK_READ);
+
+	if (sqlite3_prepare_v2 (db, "SELECT data FROM " ITEMS_DATA_TABLE " WHERE item_uid=?", -1, &stmt, NULL) != SQLITE_OK) {
+		e_etesync_cache_set_sqlite_error (db, error);
+		success = FALSE;
+	} else {
+		sqlite3_bind_text (stmt, 1, item_uid, -1, SQLITE_STATIC);
+
+		rc = sqlite3_step (stmt);
+
+		if (rc == SQLITE_ROW) {
+			*out_data = g_bytes_new (sqlite3_column_blob (stmt, 0), sqlite3_column_bytes (stmt, 0));
+		} else if (rc != SQLITE_DONE) {
+			e_etesync_cache_set_sqlite_error (db, error);
+			success = FALSE;
+		}
+	}
+
+	sqlite3_finalize (stmt);
+
+	e_cache_unlock (cache, E_CACHE_UNLOCK_NONE);
+
+	return success;
+}
+
+/* Stores the locally changed item, to be uploaded later, into the 'cache'. The 'uid' is
+   of the contact or the component the item holds, the 'conflict_resolution' says what to do,
+   when the item had been changed on the server meanwhile. Changing the same item again only
+   replaces the stored data, thus the changes are merged into one upload; it also clears
+   the error of its previous upload. */
+gboolean
+e_etesync_cache_queue_item_sync (ECache *cache,
+				 const gchar *item_uid,
+				 const gchar *uid,
+				 GBytes *data,
+				 EConflictResolution conflict_resolution,
+				 GCancellable *cancellable,
+				 GError **error)
+{
+	sqlite3 *db;
+	sqlite3_stmt *stmt = NULL;
+	gconstpointer blob;
+	gsize blob_len;
+	gchar *sql;
+	gboolean success = TRUE;
+
+	g_return_val_if_fail (E_IS_CACHE (cache), FALSE);
+	g_return_val_if_fail (item_uid != NULL, FALSE);
+	g_return_val_if_fail (data != NULL, FALSE);
+
+	if (!e_etesync_cache_ensure_tables_sync (cache, cancellable, error))
+		return FALSE;
+
+	db = e_cache_get_sqlitedb (cache);
+	blob = g_bytes_get_data (data, &blob_len);
+
+	e_cache_lock (cache, E_CACHE_LOCK_WRITE);
+
+	if (sqlite3_prepare_v2 (db, "INSERT OR REPLACE INTO " ITEMS_DATA_TABLE " (item_uid, data) VALUES (?, ?)", -1, &stmt, NULL) != SQLITE_OK) {
+		e_etesync_cache_set_sqlite_error (db, error);
+		success = FALSE;
+	} else {
+		sqlite3_bind_text (stmt, 1, item_uid, -1, SQLITE_STATIC);
+		sqlite3_bind_blob (stmt, 2, blob, blob_len, SQLITE_STATIC);
+
+		if (sqlite3_step (stmt) != SQLITE_DONE) {
+			e_etesync_cache_set_sqlite_error (db, error);
+			success = FALSE;
+		}
+	}
+
+	sqlite3_finalize (stmt);
+
+	if (success) {
+		sql = e_cache_sqlite_stmt_printf ("INSERT OR REPLACE INTO " OUTBOX_TABLE " (item_uid, uid, conflict_resolution, error) "
+			"VALUES (%Q, %Q, %d, NULL)", item_uid, uid, (gint) conflict_resolution);
+		success = e_cache_sqlite_exec (cache, sql, cancellable, error);
+		e_cache_sqlite_stmt_free (sql);
+	}
+
+	e_cache_unlock (cache, success ? E_CACHE_UNLOCK_COMMIT : E_CACHE_UNLOCK_ROLLBACK);
+
+	return success;
+}
+
+static gboolean
+e_etesync_cache_dup_queued_items_cb (ECache *cache,
+				     gint ncols,
+				     const gchar *column_names[],
+				     const gchar *column_values[],
+				     gpointer user_data)
+{
+	GSList **out_items = user_data;
+	EEteSyncCacheItem *item;
+
+	g_return_val_if_fail (ncols == 3, FALSE);
+
+	if (column_values[0]) {
+		item = e_etesync_cache_item_new (column_values[0], column_values[1], NULL);
+		item->conflict_resolution = column_values[2] ? g_ascii_strtoll (column_values[2], NULL, 10) : E_CONFLICT_RESOLUTION_KEEP_LOCAL;
+
+		*out_items = g_slist_prepend (*out_items, item);
+	}
+
+	return TRUE;
+}
+
+/* Sets 'out_items' to up to 'limit' of the queued items (EEteSyncCacheItem *, without etag),
+   the oldest first; those, which failed to be uploaded, are skipped.
+   Free it with g_slist_free_full (items, e_etesync_cache_item_free). */
+gboolean
+e_etesync_cache_dup_queued_items_sync (ECache *cache,
+				       guint limit,
+				       GSList **out_items,
+				       GCancellable *cancellable,
+				       GError **error)
+{
+	gchar *stmt;
+	gboolean success;
+
+	g_return_val_if_fail (E_IS_CACHE (cache), FALSE);
+	g_return_val_if_fail (out_items != NULL, FALSE);
+
+	*out_items = NULL;
+
+	if (!e_etesync_cache_ensure_tables_sync (cache, cancellable, error))
+		return FALSE;
+
+	stmt = e_cache_sqlite_stmt_printf ("SELECT item_uid, uid, conflict_resolution FROM " OUTBOX_TABLE " "
+		"WHERE error IS NULL ORDER BY rowid LIMIT %u", limit);
+
+	success = e_cache_sqlite_select (cache, stmt, e_etesync_cache_dup_queued_items_cb, out_items, cancellable, error);
+
+	e_cache_sqlite_stmt_free (stmt);
+
+	*out_items = g_slist_reverse (*out_items);
+
+	return success;
+}
+
+/* Removes the 'items' (EEteSyncCacheItem *) from the queue, in one transaction */
+gboolean
+e_etesync_cache_unqueue_items_sync (ECache *cache,
+				    const GSList *items, /* EEteSyncCacheItem * */
+				    GCancellable *cancellable,
+				    GError **error)
+{
+	const GSList *link;
+	gboolean success = TRUE;
+
+	g_return_val_if_fail (E_IS_CACHE (cache), FALSE);
+
+	if (!items)
+		return TRUE;
+
+	if (!e_etesync_cache_ensure_tables_sync (cache, cancellable, error))
+		return FALSE;
+
+	e_cache_lock (cache, E_CACHE_LOCK_WRITE);
+
+	for (link = items; link && success; link = g_slist_next (link)) {
+		EEteSyncCacheItem *item = link->data;
+		gchar *stmt;
+
+		stmt = e_cache_sqlite_stmt_printf ("DELETE FROM " OUTBOX_TABLE " WHERE item_uid=%Q", item->item_uid);
+		success = e_cache_sqlite_exec (cache, stmt, cancellable, error);
+		e_cache_sqlite_stmt_free (stmt);
+	}
+
+	e_cache_unlock (cache, success ? E_CACHE_UNLOCK_COMMIT : E_CACHE_UNLOCK_ROLLBACK);
+
+	return success;
+}
+
+/* Marks the queued 'item_uid' as failed to be uploaded with the 'error_message'; it stays
+   in the queue, but it is not uploaded again, until it is changed again */
+gboolean
+e_etesync_cache_set_queued_item_error_sync (ECache *cache,
+					    const gchar *item_uid,
+					    const gchar *error_message,
+					    GCancellable *cancellable,
+					    GError **error)
+{
+	gchar *stmt;
+	gboolean success;
+
+	g_return_val_if_fail (E_IS_CACHE (cache), FALSE);
+	g_return_val_if_fail (item_uid != NULL, FALSE);
+
+	if (!e_etesync_cache_ensure_tables_sync (cache, cancellable, error))
+		return FALSE;
+
+	stmt = e_cache_sqlite_stmt_printf ("UPDATE " OUTBOX_TABLE " SET error=%Q WHERE item_uid=%Q",
+		error_message ? error_message : "", item_uid);
+	success = e_cache_sqlite_exec (cache, stmt, cancellable, error);
+	e_cache_sqlite_stmt_free (stmt);
+
+	return success;
+}
+
+static gboolean
+e_etesync_cache_get_queued_item_uids_cb (ECache *cache,
+					 gint ncols,
+					 const gchar *column_names[],
+					 const gchar *column_values[],
+					 gpointer user_data)
+{
+	GHashTable *queued = user_data;
+
+	g_return_val_if_fail (ncols == 1, FALSE);
+
+	if (column_values[0])
+		g_hash_table_add (queued, g_strdup (column_values[0]));
+
+	return TRUE;
+}
+
+/* Sets 'out_queued' to a new GHashTable set of those of the 'item_uids', which have
+   a local change in the queue, to be uploaded yet; the failed changes are not included.
+   Free it with g_hash_table_destroy(). */
+gboolean
+e_etesync_cache_get_queued_item_uids_sync (ECache *cache,
+					   const gchar *const *item_uids,
+					   guint n_item_uids,
+					   GHashTable **out_queued,
+					   GCancellable *cancellable,
+					   GError **error)
+{
+	GString *stmt;
+	guint ii;
+	gboolean success;
+
+	g_return_val_if_fail (E_IS_CACHE (cache), FALSE);
+	g_return_val_if_fail (out_queued != NULL, FALSE);
+
+	*out_queued = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	if (!n_item_uids)
+		return TRUE;
+
+	if (!e_etesync_cache_ensure_tables_sync (cache, cancellable, error))
+		return FALSE;
+
+	stmt = g_string_new ("SELECT item_uid FROM " OUTBOX_TABLE " WHERE error IS NULL AND item_uid IN (");
+
+	for (ii = 0; ii < n_item_uids; ii++) {
+		if (ii)
+			g_string_append_c (stmt, ',');
+		e_cache_sqlite_stmt_append_printf (stmt, "%Q", item_uids[ii]);
+	}
+
+	g_string_append_c (stmt, ')');
+
+	success = e_cache_sqlite_select (cache, stmt->str, e_etesync_cache_get_queued_item_uids_cb, *out_queued, cancellable, error);
+
+	g_string_free (stmt, TRUE);
+
+	return success;
+}
+
+/* Removes the failed local changes of the 'item_uids' from the queue; it's called
+   when their server version is received, which replaces the local change */
+gboolean
+e_etesync_cache_unqueue_failed_items_sync (ECache *cache,
+					   const gchar *const *item_uids,
+					   guint n_item_uids,
+					   GCancellable *cancellable,
+					   GError **error)
+{
+	GString *stmt;
+	guint ii;
+	gboolean success;
+
+	g_return_val_if_fail (E_IS_CACHE (cache), FALSE);
+
+	if (!n_item_uids)
+		return TRUE;
+
+	if (!e_etesync_cache_ensure_tables_sync (cache, cancellable, error))
+		return FALSE;
+
+	stmt = g_string_new ("DELETE FROM " OUTBOX_TABLE " WHERE error IS NOT NULL AND item_uid IN (");
+
+	for (ii = 0; ii < n_item_uids; ii++) {
+		if (ii)
+			g_string_append_c (stmt, ',');
+		e_cache_sqlite_stmt_append_printf (stmt, "%Q", item_uids[ii]);
+	}
+
+	g_string_append_c (stmt, ')');
+
+	success = e_cache_sqlite_exec (cache, stmt->str, cancellable, error);
+
+	g_string_free (stmt, TRUE);
+
+	return success;
+}
@@ -0,0 +1,109 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/* e-etesync-cache.h
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#ifndef E_ETESYNC_CACHE_H
+#define E_ETESYNC_CACHE_H
+
+#include <libebackend/libebackend.h>
+
+G_BEGIN_DECLS
+
+/* State of an EteSync item, stored in the cache next to the contact/component it holds */
+typedef struct _EEteSyncCacheItem {
+	gchar *item_uid; /* UID of the EteSync item */
+	gchar *uid; /* UID of the contact or the component */
+	gchar *etag; /* NULL, when the item had been deleted */
+	EConflictResolution conflict_resolution; /* of a queued item */
+} EEteSyncCacheItem;
+
+EEteSyncCacheItem *
+		e_etesync_cache_item_new	(const gchar *item_uid,
+						 const gchar *uid,
+						 const gchar *etag);
+void		e_etesync_cache_item_free	(gpointer ptr); /* EEteSyncCacheItem * */
+gboolean	e_etesync_cache_get_item_etags_sync
+						(ECache *cache,
+						 const gchar *const *item_uids,
+						 guint n_item_uids,
+						 GHashTable **out_etags,
+						 GCancellable *cancellable,
+						 GError **error);
+gboolean	e_etesync_cache_dup_item_uid_sync
+						(ECache *cache,
+						 const gchar *uid,
+						 gchar **out_item_uid,
+						 GCancellable *cancellable,
+						 GError **error);
+gboolean	e_etesync_cache_get_contained_uids_sync
+						(ECache *cache,
+						 const gchar *const *uids,
+						 guint n_uids,
+						 GHashTable **out_contained,
+						 GCancellable *cancellable,
+						 GError **error);
+gboolean	e_etesync_cache_store_items_sync
+						(ECache *cache,
+						 const GSList *items, /* EEteSyncCacheItem * */
+						 GCancellable *cancellable,
+						 GError **error);
+gboolean	e_etesync_cache_store_item_data_sync
+						(ECache *cache,
+						 const gchar *const *item_uids,
+						 GBytes *const *data,
+						 guint n_items,
+						 GCancellable *cancellable,
+						 GError **error);
+gboolean	e_etesync_cache_dup_item_data_sync
+						(ECache *cache,
+						 const gchar *item_uid,
+						 GBytes **out_data,
+						 GCancellable *cancellable,
+						 GError **error);
+gboolean	e_etesync_cache_queue_item_sync	(ECache *cache,
+						 const gchar *item_uid,
+						 const gchar *uid,
+						 GBytes *data,
+						 EConflictResolution conflict_resolution,
+						 GCancellable *cancellable,
+						 GError **error);
+gboolean	e_etesync_cache_dup_queued_items_sync
+						(ECache *cache,
+						 guint limit,
+						 GSList **out_items, /* EEteSyncCacheItem * */
+						 GCancellable *cancellable,
+						 GError **error);
+gboolean	e_etesync_cache_unqueue_items_sync
+						(ECache *cache,
+						 const GSList *items, /* EEteSyncCacheItem * */
+						 GCancellable *cancellable,
+						 GError **error);
+gboolean	e_etesync_cache_set_queued_item_error_sync
+						(ECache *cache,
+						 const gchar *item_uid,
+						 const gchar *error_message,
+						 GCancellable *cancellable,
+						 GError **error);
+gboolean	e_etesync_cache_get_queued_item_uids_sync
+						(ECache *cache,
+						 const gchar *const *item_uids,
+						 guint n_item_uids,
+						 GHashTable **out_queued,
+						 GCancellable *cancellable,
+						 GError **error);
+gboolean	e_etesync_cache_unqueue_failed_items_sync
+						(ECache *cache,
+						 const gchar *const *item_uids,
+						 guint n_item_uids,
+						 GCancellable *cancellable,
+						 GError **error);
+gboolean	e_etesync_cache_remove_all_items_sync
+						(ECache *cache,
+						 GCancellable *cancellable,
+						 GError **error);
+
+G_END_DECLS
+
+#endif /* E_ETESYNC_CACHE_H */
@@ -10,7 +10,11 @@
 #include <glib/gi18n-lib.h>
 #include "e-etesync-connection.h"
 #include "e-etesync-utils.h"
+#include "e-etesync-cache.h"
+#include "e-etesync-workers.h"
+#include "e-etesync-executor.h"
 #include "common/e-source-etesync.h"
+#include "common/e-source-etesync-account.h"
 #include "common/e-etesync-service.h"
 
 /* Stack-allocated buffer size for items read, to avoid often allocations */
@@ -28,12 +32,42 @@ struct _EEteSyncConnectionPrivate {
 
 	/* Hash key for the loaded_connections_permissions table. */
 	gchar *hash_key;
-	GRecMutex connection_lock;
+	GRecMutex connection_lock; /* guards the members above, not held over the requests */
+	GRecMutex reconnect_lock; /* only one thread reconnects or refreshes the token at a time */
 	gboolean requested_credentials;
+
+	/* gchar *collection uid ~> GRecMutex *, serializes the uploads to one collection */
+	GHashTable *collection_locks;
+
+	EEteSyncExecutor *executor; /* limits the concurrent requests of the account */
+
+	/* gchar *collection uid ~> KnownCollection *, the decoded collections of the account */
+	GHashTable *known_collections;
+
+	/* gchar *collection uid ~> CollectionData *, with the item manager of the 'col_mgr' */
+	GHashTable *collections;
+	/* gchar *collection uid ~> FetchPipeline *, started by get_changes to be continued in the next call */
+	GHashTable *pending_fetches;
+	/* gchar *collection uid ~> PendingItems *, etags of the last returned changes */
+	GHashTable *pending_items;
+
+	/* gchar *collection uid ~> gchar *stoken, as known from the last check of the collections */
+	GHashTable *collection_stokens;
+	/* gchar *collection uid ~> gchar *stoken, of the collection objects the backends use */
+	GHashTable *col_obj_stokens;
+	gchar *collections_stoken; /* to check only the collections changed since the last check */
+	gint64 collections_checked; /* g_get_monotonic_time() of the last check */
+	GMutex collections_check_lock; /* only one thread checks the collections at a time */
+
+	guint token_refresh_id; /* the timeout source refreshing the token */
+	volatile gint session_generation; /* increased with each new session */
 };
 
 G_DEFINE_TYPE_WITH_PRIVATE (EEteSyncConnection, e_etesync_connection, G_TYPE_OBJECT)
 
+/* Drops the session only; the collection data, the fetch pipelines and the pending
+   items are kept, the item managers of the collection data are replaced on their
+   next use, see e_etesync_connection_ref_collection_data() */
 static void
 e_etesync_connection_clear (EEteSyncConnection *connection)
 {
@@ -50,7 +84,181 @@ e_etesync_connection_clear (EEteSyncConnection *connection)
 
 	g_clear_pointer (&connection->priv->session_key, g_free);
 
+	if (connection->priv->token_refresh_id) {
+		g_source_remove (connection->priv->token_refresh_id);
+		connection->priv->token_refresh_id = 0;
+	}
+
+	g_rec_mutex_unlock (&connection->priv->connection_lock);
+}
+
+static void e_etesync_connection_schedule_token_refresh (EEteSyncConnection *connection);
+
+/* Makes the 'etebase_account', saved as the 'session_key', the current session;
+   assumes ownership of both. The client is kept. Call with the connection_lock held. */
+static void
+e_etesync_connection_take_session_locked (EEteSyncConnection *connection,
+					  EtebaseAccount *etebase_account,
+					  gchar *session_key)
+{
+	if (connection->priv->col_mgr)
+		etebase_collection_manager_destroy (connection->priv->col_mgr);
+
+	if (connection->priv->etebase_account)
+		etebase_account_destroy (connection->priv->etebase_account);
+
+	g_free (connection->priv->session_key);
+
+	connection->priv->etebase_account = etebase_account;
+	connection->priv->col_mgr = etebase_account_get_collection_manager (etebase_account);
+	connection->priv->session_key = session_key;
+	g_atomic_int_inc (&connection->priv->session_generation);
+
+	e_etesync_connection_schedule_token_refresh (connection);
+}
+
+static void
+collection_lock_free (gpointer ptr)
+{
+	GRecMutex *lock = ptr;
+
+	if (lock) {
+		g_rec_mutex_clear (lock);
+		g_free (lock);
+	}
+}
+
+/* Serializes the uploads to the collection 'col_obj', while the other collections
+   can be changed at the same time; the connection_lock is held only to find the lock */
+static void
+e_etesync_connection_lock_collection (EEteSyncConnection *connection,
+				      const EtebaseCollection *col_obj)
+{
+	GRecMutex *lock;
+	const gchar *col_uid;
+
+	col_uid = etebase_collection_get_uid (col_obj);
+
+	g_rec_mutex_lock (&connection->priv->connection_lock);
+
+	lock = g_hash_table_lookup (connection->priv->collection_locks, col_uid);
+
+	if (!lock) {
+		lock = g_new0 (GRecMutex, 1);
+		g_rec_mutex_init (lock);
+
+		g_hash_table_insert (connection->priv->collection_locks, g_strdup (col_uid), lock);
+	}
+
+	g_rec_mutex_unlock (&connection->priv->connection_lock);
+
+	g_rec_mutex_lock (lock);
+}
+
+static void
+e_etesync_connection_unlock_collection (EEteSyncConnection *connection,
+					const EtebaseCollection *col_obj)
+{
+	GRecMutex *lock;
+
+	g_rec_mutex_lock (&connection->priv->connection_lock);
+	lock = g_hash_table_lookup (connection->priv->collection_locks, etebase_collection_get_uid (col_obj));
+	g_rec_mutex_unlock (&connection->priv->connection_lock);
+
+	g_return_if_fail (lock != NULL);
+
+	g_rec_mutex_unlock (lock);
+}
+
+/* Returns a new collection manager of the current session, which can be used without
+   holding the connection_lock, like the item managers in the CollectionData; free it
+   with etebase_collection_manager_destroy(). Returns NULL, when not connected.
+   The 'out_session_generation' is set to the generation of the session, to be passed
+   to e_etesync_connection_maybe_reconnect_sync() when a request with it fails. */
+EtebaseCollectionManager *
+e_etesync_connection_dup_collection_manager (EEteSyncConnection *connection,
+					     gint *out_session_generation)
+{
+	EtebaseCollectionManager *col_mgr = NULL;
+
+	g_return_val_if_fail (E_IS_ETESYNC_CONNECTION (connection), NULL);
+
+	g_rec_mutex_lock (&connection->priv->connection_lock);
+
+	if (connection->priv->etebase_account)
+		col_mgr = etebase_account_get_collection_manager (connection->priv->etebase_account);
+
+	if (out_session_generation)
+		*out_session_generation = connection->priv->session_generation;
+
 	g_rec_mutex_unlock (&connection->priv->connection_lock);
+
+	return col_mgr;
+}
+
+/* Lists the collections of the supported types with the 'col_mgr', as one of the request
+   slots of the account; free the result with etebase_collection_list_response_destroy().
+   Returns NULL on failure, with the etebase error set. */
+EtebaseCollectionListResponse *
+e_etesync_connection_collection_list_sync (EEteSyncConnection *connection,
+					   const EtebaseCollectionManager *col_mgr,
+					   EtebaseFetchOptions *fetch_options)
+{
+	EtebaseCollectionListResponse *col_list;
+
+	g_return_val_if_fail (E_IS_ETESYNC_CONNECTION (connection), NULL);
+	g_return_val_if_fail (col_mgr != NULL, NULL);
+
+	e_etesync_executor_begin_request (connection->priv->executor, E_ETESYNC_REQUEST_COLLECTION_LIST);
+	col_list = etebase_collection_manager_list_multi (col_mgr,
+							  e_etesync_util_get_collection_supported_types (),
+							  EETESYNC_UTILS_SUPPORTED_TYPES_SIZE,
+							  fetch_options);
+	e_etesync_executor_end_request (connection->priv->executor, E_ETESYNC_REQUEST_COLLECTION_LIST);
+
+	return col_list;
+}
+
+/* Replaces the 'inout_col_mgr' with one of the new session, after a reconnect */
+static void
+e_etesync_connection_renew_collection_manager (EEteSyncConnection *connection,
+					       EtebaseCollectionManager **inout_col_mgr)
+{
+	if (*inout_col_mgr)
+		etebase_collection_manager_destroy (*inout_col_mgr);
+
+	*inout_col_mgr = e_etesync_connection_dup_collection_manager (connection, NULL);
+}
+
+/* Uploads the 'col_obj', as one of the request slots of the account */
+static gboolean
+e_etesync_connection_collection_upload_sync (EEteSyncConnection *connection,
+					     const EtebaseCollectionManager *col_mgr,
+					     const EtebaseCollection *col_obj)
+{
+	gboolean success;
+
+	e_etesync_executor_begin_request (connection->priv->executor, E_ETESYNC_REQUEST_BATCH);
+	success = !etebase_collection_manager_upload (col_mgr, col_obj, NULL);
+	e_etesync_executor_end_request (connection->priv->executor, E_ETESYNC_REQUEST_BATCH);
+
+	return success;
+}
+
+static void
+e_etesync_connection_max_requests_notify_cb (ESourceEteSyncAccount *account_extension,
+					     GParamSpec *param,
+					     EEteSyncConnection *connection)
+{
+	e_etesync_executor_set_max_requests (connection->priv->executor, e_source_etesync_account_get_max_requests (account_extension));
+}
+
+static void
+e_etesync_connection_worker_threads_notify_cb (ESourceEteSyncAccount *account_extension,
+					       GParamSpec *param,
+					       EEteSyncConnection *connection)
+{
+	e_etesync_workers_set_max_threads (e_source_etesync_account_get_worker_threads (account_extension));
 }
 
 /* Returns either a new connection object or an already existing one with the same hash_key */
@@ -107,6 +315,23 @@ e_etesync_connection_new (ESource *collection_source)
 	connection->priv->hash_key = hash_key;  /* takes ownership */
 	connection->priv->collection_source = g_object_ref (collection_source);
 
+	if (e_source_has_extension (collection_source, E_SOURCE_EXTENSION_ETESYNC_ACCOUNT)) {
+		ESourceEteSyncAccount *account_extension;
+
+		account_extension = e_source_get_extension (collection_source, E_SOURCE_EXTENSION_ETESYNC_ACCOUNT);
+		e_etesync_executor_set_max_requests (connection->priv->executor, e_source_etesync_account_get_max_requests (account_extension));
+
+		g_signal_connect_object (account_extension, "notify::max-requests",
+			G_CALLBACK (e_etesync_connection_max_requests_notify_cb), connection, 0);
+
+		/* the worker threads are shared by all the accounts, thus only a set value applies */
+		if (e_source_etesync_account_get_worker_threads (account_extension))
+			e_etesync_workers_set_max_threads (e_source_etesync_account_get_worker_threads (account_extension));
+
+		g_signal_connect_object (account_extension, "notify::worker-threads",
+			G_CALLBACK (e_etesync_connection_worker_threads_notify_cb), connection, 0);
+	}
+
 	/* add the connection to the loaded_connections_permissions hash table */
 	if (!loaded_connections_permissions)
 		loaded_connections_permissions = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
@@ -128,21 +353,23 @@ e_etesync_connection_check_session_key_validation_sync (EEteSyncConnection *conn
 							EtebaseErrorCode *out_etebase_error,
 							GError **error)
 {
+	EtebaseCollectionManager *col_mgr;
 	EtebaseFetchOptions *fetch_options;
 	EtebaseCollectionListResponse *col_list;
 	ESourceAuthenticationResult result = E_SOURCE_AUTHENTICATION_ACCEPTED;
 	GError *local_error = NULL;
 
 	g_return_val_if_fail (connection != NULL ,E_SOURCE_AUTHENTICATION_ERROR);
-	g_return_val_if_fail (connection->priv->etebase_account != NULL ,E_SOURCE_AUTHENTICATION_ERROR);
 
-	g_rec_mutex_lock (&connection->priv->connection_lock);
+	col_mgr = e_etesync_connection_dup_collection_manager (connection, NULL);
+
+	g_return_val_if_fail (col_mgr != NULL ,E_SOURCE_AUTHENTICATION_ERROR);
 
 	fetch_options = etebase_fetch_options_new ();
 	etebase_fetch_options_set_prefetch(fetch_options, ETEBASE_PREFETCH_OPTION_MEDIUM);
 	etebase_fetch_options_set_limit (fetch_options, 1);
 
-	col_list = etebase_collection_manager_list_multi (connection->priv->col_mgr, e_etesync_util_get_collection_supported_types (), EETESYNC_UTILS_SUPPORTED_TYPES_SIZE, fetch_options);
+	col_list = e_etesync_connection_collection_list_sync (connection, col_mgr, fetch_options);
 
 	if (!col_list) {
 		EtebaseErrorCode etebase_error = etebase_error_get_code ();
@@ -165,11 +392,79 @@ e_etesync_connection_check_session_key_validation_sync (EEteSyncConnection *conn
 			*out_etebase_error = etebase_error_get_code ();
 	}
 
-	g_rec_mutex_unlock (&connection->priv->connection_lock);
+	etebase_collection_manager_destroy (col_mgr);
 
 	return result;
 }
 
+static gboolean e_etesync_connection_refresh_token_sync (EEteSyncConnection *connection,
+							 ESource *collection,
+							 ENamedParameters *credentials,
+							 EtebaseErrorCode *etebase_error,
+							 GError **error);
+
+static gpointer
+e_etesync_connection_token_refresh_thread (gpointer user_data)
+{
+	EEteSyncConnection *connection = user_data;
+
+	g_rec_mutex_lock (&connection->priv->reconnect_lock);
+
+	if (e_etesync_connection_is_connected (connection)) {
+		ENamedParameters *credentials;
+		GError *local_error = NULL;
+
+		credentials = e_named_parameters_new ();
+
+		/* when it fails, the token is refreshed by the first request, which needs it */
+		if (!e_etesync_connection_refresh_token_sync (connection, connection->priv->collection_source, credentials, NULL, &local_error)) {
+			g_debug ("%s: Failed to refresh token: %s", G_STRFUNC, local_error ? local_error->message : "Unknown error");
+			g_clear_error (&local_error);
+		}
+
+		e_named_parameters_free (credentials);
+	}
+
+	g_rec_mutex_unlock (&connection->priv->reconnect_lock);
+
+	g_object_unref (connection);
+
+	return NULL;
+}
+
+static gboolean
+e_etesync_connection_token_refresh_cb (gpointer user_data)
+{
+	GWeakRef *weak_ref = user_data;
+	EEteSyncConnection *connection;
+
+	connection = g_weak_ref_get (weak_ref);
+
+	if (!connection)
+		return G_SOURCE_REMOVE;
+
+	/* the request blocks, thus not in the main thread */
+	g_thread_unref (g_thread_new ("etesync-token-refresh", e_etesync_connection_token_refresh_thread, connection));
+
+	return G_SOURCE_CONTINUE;
+}
+
+/* Refreshes the token periodically, before it expires, thus the requests
+   of all the users of the connection do not fail on the expired token */
+static void
+e_etesync_connection_schedule_token_refresh (EEteSyncConnection *connection)
+{
+	g_rec_mutex_lock (&connection->priv->connection_lock);
+
+	if (connection->priv->token_refresh_id)
+		g_source_remove (connection->priv->token_refresh_id);
+
+	connection->priv->token_refresh_id = g_timeout_add_seconds_full (G_PRIORITY_DEFAULT, E_ETESYNC_TOKEN_REFRESH_INTERVAL,
+		e_etesync_connection_token_refresh_cb, e_weak_ref_new (connection), (GDestroyNotify) e_weak_ref_free);
+
+	g_rec_mutex_unlock (&connection->priv->connection_lock);
+}
+
 gboolean
 e_etesync_connection_set_connection_from_sources (EEteSyncConnection *connection,
 						  const ENamedParameters *credentials)
@@ -177,9 +472,11 @@ e_etesync_connection_set_connection_from_sources (EEteSyncConnection *connection
 	const gchar *server_url , *session_key;
 	gboolean success = TRUE;
 	ESourceCollection *collection_extension;
+	EtebaseAccount *etebase_account;
 
 	g_return_val_if_fail (connection != NULL ,FALSE);
 
+	g_rec_mutex_lock (&connection->priv->reconnect_lock);
 	g_rec_mutex_lock (&connection->priv->connection_lock);
 
 	collection_extension = e_source_get_extension (connection->priv->collection_source, E_SOURCE_EXTENSION_COLLECTION);
@@ -193,6 +490,7 @@ e_etesync_connection_set_connection_from_sources (EEteSyncConnection *connection
 	/* problem with the server_url */
 	if (!connection->priv->etebase_client) {
 		g_rec_mutex_unlock (&connection->priv->connection_lock);
+		g_rec_mutex_unlock (&connection->priv->reconnect_lock);
 		return FALSE;
 	}
 
@@ -203,14 +501,19 @@ e_etesync_connection_set_connection_from_sources (EEteSyncConnection *connection
 	      or changed, or simply the session key is not stored. */
 	if (!session_key) {
 		g_rec_mutex_unlock (&connection->priv->connection_lock);
+		g_rec_mutex_unlock (&connection->priv->reconnect_lock);
 		return FALSE;
 	}
 
-	connection->priv->session_key = g_strdup (session_key);
-	connection->priv->etebase_account = etebase_account_restore (connection->priv->etebase_client, session_key, NULL, 0);
-	connection->priv->col_mgr = etebase_account_get_collection_manager (connection->priv->etebase_account);
+	etebase_account = etebase_account_restore (connection->priv->etebase_client, session_key, NULL, 0);
+
+	if (etebase_account)
+		e_etesync_connection_take_session_locked (connection, etebase_account, g_strdup (session_key));
+	else
+		success = FALSE;
 
 	g_rec_mutex_unlock (&connection->priv->connection_lock);
+	g_rec_mutex_unlock (&connection->priv->reconnect_lock);
 
 	return success;
 }
@@ -224,6 +527,7 @@ e_etesync_connection_login_connection_sync (EEteSyncConnection *connection,
 {
 	EtebaseErrorCode local_etebase_error = ETEBASE_ERROR_CODE_NO_ERROR;
 	EtebaseClient *etebase_client;
+	EtebaseAccount *etebase_account = NULL;
 	gboolean success = TRUE;
 
 	g_return_val_if_fail (connection != NULL, FALSE);
@@ -231,20 +535,15 @@ e_etesync_connection_login_connection_sync (EEteSyncConnection *connection,
 	g_return_val_if_fail (password, FALSE);
 	g_return_val_if_fail (server_url && *server_url, FALSE);
 
-	g_rec_mutex_lock (&connection->priv->connection_lock);
-
-	e_etesync_connection_clear (connection);
+	g_rec_mutex_lock (&connection->priv->reconnect_lock);
 
 	etebase_client = etebase_client_new (PACKAGE "/" VERSION, server_url);
 
+	/* the login is a request to the server, thus done without the connection_lock */
 	if (etebase_client) {
-		connection->priv->etebase_client = etebase_client;
-		connection->priv->etebase_account = etebase_account_login (etebase_client, username, password);
+		etebase_account = etebase_account_login (etebase_client, username, password);
 
-		if (connection->priv->etebase_account) {
-			connection->priv->col_mgr = etebase_account_get_collection_manager (connection->priv->etebase_account);
-			connection->priv->session_key = etebase_account_save (connection->priv->etebase_account, NULL, 0);
-		} else {
+		if (!etebase_account) {
 			local_etebase_error = etebase_error_get_code ();
 			success = FALSE;
 		}
@@ -254,10 +553,20 @@ e_etesync_connection_login_connection_sync (EEteSyncConnection *connection,
 		success = FALSE;
 	}
 
-	if (out_etebase_error)
-		*out_etebase_error = local_etebase_error;
+	g_rec_mutex_lock (&connection->priv->connection_lock);
+
+	e_etesync_connection_clear (connection);
+
+	connection->priv->etebase_client = etebase_client;
+
+	if (etebase_account)
+		e_etesync_connection_take_session_locked (connection, etebase_account, etebase_account_save (etebase_account, NULL, 0));
 
 	g_rec_mutex_unlock (&connection->priv->connection_lock);
+	g_rec_mutex_unlock (&connection->priv->reconnect_lock);
+
+	if (out_etebase_error)
+		*out_etebase_error = local_etebase_error;
 
 	return success;
 }
@@ -282,69 +591,141 @@ e_etesync_connection_is_connected (EEteSyncConnection *connection)
 }
 
 
-/* Fetches a new token and stores it in the keyring,
-   returns a new ENamedParameters with the new session key */
+/* Fetches a new token for a copy of the current session, which replaces the current
+   one only then, thus the requests in progress are not affected. The new session key
+   is not stored anywhere, see e_etesync_connection_dup_session_key(). */
+gboolean
+e_etesync_connection_fetch_token_sync (EEteSyncConnection *connection,
+				       EtebaseErrorCode *out_etebase_error,
+				       GError **error)
+{
+	EtebaseAccount *etebase_account = NULL;
+	gboolean success;
+
+	g_return_val_if_fail (E_IS_ETESYNC_CONNECTION (connection), FALSE);
+
+	if (out_etebase_error)
+		*out_etebase_error = ETEBASE_ERROR_CODE_NO_ERROR;
+
+	g_rec_mutex_lock (&connection->priv->reconnect_lock);
+	g_rec_mutex_lock (&connection->priv->connection_lock);
+
+	if (connection->priv->etebase_client && connection->priv->session_key)
+		etebase_account = etebase_account_restore (connection->priv->etebase_client, connection->priv->session_key, NULL, 0);
+
+	g_rec_mutex_unlock (&connection->priv->connection_lock);
+
+	if (!etebase_account) {
+		g_rec_mutex_unlock (&connection->priv->reconnect_lock);
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_CONNECTED, _("Not connected"));
+		return FALSE;
+	}
+
+	success = !etebase_account_fetch_token (etebase_account);
+
+	if (success) {
+		/* the managers are created with the token of the account at that time */
+		g_rec_mutex_lock (&connection->priv->connection_lock);
+		e_etesync_connection_take_session_locked (connection, etebase_account, etebase_account_save (etebase_account, NULL, 0));
+		g_rec_mutex_unlock (&connection->priv->connection_lock);
+	} else {
+		EtebaseErrorCode local_etebase_error = etebase_error_get_code ();
+
+		e_etesync_utils_set_io_gerror (local_etebase_error, etebase_error_get_message (), error);
+
+		if (out_etebase_error)
+			*out_etebase_error = local_etebase_error;
+
+		etebase_account_destroy (etebase_account);
+	}
+
+	g_rec_mutex_unlock (&connection->priv->reconnect_lock);
+
+	return success;
+}
+
+/* Fetches a new token and stores it in the keyring, sets the 'credentials'
+   to the new session key, which is used by all the users of the connection */
 static gboolean
 e_etesync_connection_refresh_token_sync (EEteSyncConnection *connection,
 					 ESource *collection,
 					 ENamedParameters *credentials,
 					 EtebaseErrorCode *etebase_error,
 					 GError **error)
+{
+	gchar *new_session_key, *label;
+	const gchar *collection_uid;
+	ESourceAuthentication *auth_extension;
+	gboolean permanently;
+
+	/* called with the reconnect_lock held, thus the session cannot change in the meantime */
+	if (!e_etesync_connection_fetch_token_sync (connection, etebase_error, error))
+		return FALSE;
+
+	new_session_key = e_etesync_connection_dup_session_key (connection);
+	label = e_source_dup_secret_label (collection);
+	auth_extension = e_source_get_extension (collection, E_SOURCE_EXTENSION_AUTHENTICATION);
+	permanently = e_source_authentication_get_remember_password (auth_extension);
+	collection_uid = e_source_get_uid (collection);
+
+	e_named_parameters_clear (credentials);
+	e_named_parameters_set (credentials,
+		E_ETESYNC_CREDENTIAL_SESSION_KEY, new_session_key);
+
+	/* written in the background, not to hold the lock for it */
+	e_etesync_service_store_credentials (collection_uid,
+					     label,
+					     credentials,
+					     permanently);
+
+	g_free (new_session_key);
+	g_free (label);
+
+	return TRUE;
+}
+
+/* Invalidates the current session on the server and disconnects */
+void
+e_etesync_connection_logout_sync (EEteSyncConnection *connection)
 {
 	EtebaseAccount *etebase_account;
-	gboolean success;
 
-	etebase_account = e_etesync_connection_get_etebase_account (connection);
-	success = !etebase_account_fetch_token (etebase_account);
+	g_return_if_fail (E_IS_ETESYNC_CONNECTION (connection));
 
-	if (success) {
-		gchar *new_session_key, *label;
-		const gchar *collection_uid;
-		ESourceAuthentication *auth_extension;
-		gboolean permanently;
-
-		new_session_key = etebase_account_save (etebase_account, NULL, 0);
-		label = e_source_dup_secret_label (collection);
-		auth_extension = e_source_get_extension (collection, E_SOURCE_EXTENSION_AUTHENTICATION);
-		permanently = e_source_authentication_get_remember_password (auth_extension);
-		collection_uid = e_source_get_uid (collection);
-
-		e_named_parameters_clear (credentials);
-		e_named_parameters_set (credentials,
-			E_ETESYNC_CREDENTIAL_SESSION_KEY, new_session_key);
-
-		e_etesync_service_store_credentials_sync (collection_uid,
-							  label,
-							  credentials,
-							  permanently,
-							  NULL, NULL);
-
-		g_free (new_session_key);
-		g_free (label);
-	} else {
-		EtebaseErrorCode local_etebase_error = etebase_error_get_code ();
+	g_rec_mutex_lock (&connection->priv->reconnect_lock);
+	g_rec_mutex_lock (&connection->priv->connection_lock);
 
-		if (error)
-			e_etesync_utils_set_io_gerror (local_etebase_error, etebase_error_get_message (), error);
-		if (etebase_error)
-			*etebase_error = local_etebase_error;
+	/* the logout is a request to the server, thus done without the connection_lock */
+	etebase_account = connection->priv->etebase_account;
+	connection->priv->etebase_account = NULL;
+
+	e_etesync_connection_clear (connection);
+
+	g_rec_mutex_unlock (&connection->priv->connection_lock);
+
+	if (etebase_account) {
+		etebase_account_logout (etebase_account);
+		etebase_account_destroy (etebase_account);
 	}
 
-	return success;
+	g_rec_mutex_unlock (&connection->priv->reconnect_lock);
 }
 
-/* Checks if token is valid if not it refreshes the token,
-   and it sets the connection object with the latest stored-session key */
-gboolean
-e_etesync_connection_reconnect_sync (EEteSyncConnection *connection,
-				     ESourceAuthenticationResult *out_result,
-				     GCancellable *cancellable,
-				     GError **error)
+/* Sets the connection object with the latest stored session key, refreshing the token
+   when it is not valid. The 'rejected_generation' is the session generation, which had
+   been rejected by the server, or -1, when it's not known whether the token is valid. */
+static gboolean
+e_etesync_connection_reconnect_internal_sync (EEteSyncConnection *connection,
+					      gint rejected_generation,
+					      ESourceAuthenticationResult *out_result,
+					      GCancellable *cancellable,
+					      GError **error)
 {
 	ENamedParameters *credentials = NULL;
 	const gchar *collection_uid;
 	ESourceAuthenticationResult local_result = E_SOURCE_AUTHENTICATION_ACCEPTED;
 	ESource *collection;
+	gboolean refreshed = FALSE;
 	gboolean success = FALSE;
 
 	g_return_val_if_fail (connection != NULL, FALSE);
@@ -352,24 +733,48 @@ e_etesync_connection_reconnect_sync (EEteSyncConnection *connection,
 	if (g_cancellable_set_error_if_cancelled (cancellable, error))
 		return FALSE;
 
-	g_rec_mutex_lock (&connection->priv->connection_lock);
+	/* the requests do not wait for the reconnect, only those, which need the new session */
+	g_rec_mutex_lock (&connection->priv->reconnect_lock);
+
+	/* Another thread reconnected while this one was waiting for the lock */
+	if (rejected_generation != -1 && rejected_generation != g_atomic_int_get (&connection->priv->session_generation) &&
+	    e_etesync_connection_is_connected (connection)) {
+		if (out_result)
+			*out_result = E_SOURCE_AUTHENTICATION_ACCEPTED;
+
+		g_rec_mutex_unlock (&connection->priv->reconnect_lock);
 
+		return TRUE;
+	}
+
+	/* The stored session key can be newer than the one in use, when another
+	   process refreshed the token, then it's used without asking the server */
 	collection = connection->priv->collection_source;
 	collection_uid = e_source_get_uid (collection);
+
+	if (rejected_generation != -1)
+		e_etesync_service_forget_cached_credentials (collection_uid);
+
 	e_etesync_service_lookup_credentials_sync (collection_uid, &credentials, NULL, NULL);
 
 	if (e_etesync_connection_is_connected (connection)) {
 		const gchar *session_key = e_named_parameters_get (credentials, E_ETESYNC_CREDENTIAL_SESSION_KEY);
+		gchar *current_session_key;
+
+		g_rec_mutex_lock (&connection->priv->connection_lock);
+		current_session_key = g_strdup (connection->priv->session_key);
+		g_rec_mutex_unlock (&connection->priv->connection_lock);
 
 		if (session_key) {
-			if (g_strcmp0 (session_key, connection->priv->session_key) == 0) {
-				if (e_etesync_connection_check_session_key_validation_sync (connection, NULL, error) == E_SOURCE_AUTHENTICATION_REJECTED) {
+			if (g_strcmp0 (session_key, current_session_key) == 0) {
+				/* the token is not validated here, the first request, which is rejected,
+				   gets here with the 'rejected_generation' to have it refreshed */
+				if (rejected_generation != -1) {
 					EtebaseErrorCode etebase_error;
 
-					g_clear_error (error);
-
 					if (e_etesync_connection_refresh_token_sync (connection, collection, credentials, &etebase_error, error)) {
 						local_result = E_SOURCE_AUTHENTICATION_ACCEPTED;
+						refreshed = TRUE;
 					} else {
 						if (etebase_error == ETEBASE_ERROR_CODE_UNAUTHORIZED)
 							local_result = E_SOURCE_AUTHENTICATION_REJECTED;
@@ -381,36 +786,57 @@ e_etesync_connection_reconnect_sync (EEteSyncConnection *connection,
 		} else {
 			local_result = E_SOURCE_AUTHENTICATION_ERROR;
 		}
+
+		g_free (current_session_key);
 	} else {
 		if (!credentials || !e_named_parameters_exists (credentials, E_ETESYNC_CREDENTIAL_SESSION_KEY))
 			local_result = E_SOURCE_AUTHENTICATION_REJECTED;
 	}
 
-	/* Set connection from collection source */
+	/* Set connection from collection source, unless the refresh already set the new session */
 	if (local_result == E_SOURCE_AUTHENTICATION_ACCEPTED)
-		success = e_etesync_connection_set_connection_from_sources (connection, credentials);
+		success = refreshed || e_etesync_connection_set_connection_from_sources (connection, credentials);
+	else if (local_result == E_SOURCE_AUTHENTICATION_REJECTED)
+		e_etesync_service_forget_cached_credentials (collection_uid); /* new ones will be stored by the credentials prompt */
 
 	if (out_result)
 		*out_result = local_result;
 
 	e_named_parameters_free (credentials);
 
-	g_rec_mutex_unlock (&connection->priv->connection_lock);
+	g_rec_mutex_unlock (&connection->priv->reconnect_lock);
 
 	return success;
 }
 
-/* Calls connection,reconnect, and requests the credentials dialog if needed */
+/* Sets the connection object with the latest stored session key, without asking
+   the server, thus it can be used offline; an expired token is refreshed by
+   e_etesync_connection_maybe_reconnect_sync(), once a request is rejected */
+gboolean
+e_etesync_connection_reconnect_sync (EEteSyncConnection *connection,
+				     ESourceAuthenticationResult *out_result,
+				     GCancellable *cancellable,
+				     GError **error)
+{
+	return e_etesync_connection_reconnect_internal_sync (connection, -1, out_result, cancellable, error);
+}
+
+/* Calls connection,reconnect, and requests the credentials dialog if needed; it's
+   called after a request failed with the expired token, thus the token is refreshed
+   only once, when more threads get here at the same time. The 'rejected_generation'
+   is the session generation the failed request had been made with, as captured
+   before the request; the session is not replaced, when it's a newer one already. */
 gboolean
 e_etesync_connection_maybe_reconnect_sync (EEteSyncConnection *connection,
 					   EBackend *backend,
+					   gint rejected_generation,
 					   GCancellable *cancellable,
 					   GError **error)
 {
 	ESourceAuthenticationResult result = E_SOURCE_AUTHENTICATION_ACCEPTED;
 	gboolean success = FALSE;
 
-	success = e_etesync_connection_reconnect_sync (connection, &result, cancellable, error);
+	success = e_etesync_connection_reconnect_internal_sync (connection, rejected_generation, &result, cancellable, error);
 
 	if (result == E_SOURCE_AUTHENTICATION_REJECTED) {
 		e_backend_schedule_credentials_required (backend,
@@ -433,9 +859,11 @@ e_etesync_connection_collection_create_upload_sync (EEteSyncConnection *connecti
 						    GCancellable *cancellable,
 						    GError **error)
 {
+	EtebaseCollectionManager *col_mgr;
 	EtebaseCollection *col_obj;
 	EtebaseItemMetadata *item_metadata;
 	gboolean success = TRUE;
+	gint session_generation = -1;
 	time_t now;
 
 	g_return_val_if_fail (connection != NULL, FALSE);
@@ -445,7 +873,12 @@ e_etesync_connection_collection_create_upload_sync (EEteSyncConnection *connecti
 	if (g_cancellable_set_error_if_cancelled (cancellable, error))
 		return FALSE;
 
-	g_rec_mutex_lock (&connection->priv->connection_lock);
+	col_mgr = e_etesync_connection_dup_collection_manager (connection, &session_generation);
+
+	if (!col_mgr) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_CONNECTED, _("Not connected"));
+		return FALSE;
+	}
 
 	item_metadata = etebase_item_metadata_new ();
 	etebase_item_metadata_set_name (item_metadata, display_name);
@@ -454,14 +887,15 @@ e_etesync_connection_collection_create_upload_sync (EEteSyncConnection *connecti
 	e_etesync_utils_get_time_now (&now);
 	etebase_item_metadata_set_mtime (item_metadata, &now);
 
-	col_obj = etebase_collection_manager_create (connection->priv->col_mgr, col_type, item_metadata, "", 0);
-	success = !etebase_collection_manager_upload (connection->priv->col_mgr, col_obj, NULL);
+	col_obj = etebase_collection_manager_create (col_mgr, col_type, item_metadata, "", 0);
+	success = e_etesync_connection_collection_upload_sync (connection, col_mgr, col_obj);
 
 	if (!success &&
 	    etebase_error_get_code () == ETEBASE_ERROR_CODE_UNAUTHORIZED &&
-	    e_etesync_connection_maybe_reconnect_sync (connection, backend, cancellable, error)) {
+	    e_etesync_connection_maybe_reconnect_sync (connection, backend, session_generation, cancellable, error)) {
 
-		success = !etebase_collection_manager_upload (connection->priv->col_mgr, col_obj, NULL);
+		e_etesync_connection_renew_collection_manager (connection, &col_mgr);
+		success = col_mgr && e_etesync_connection_collection_upload_sync (connection, col_mgr, col_obj);
 	}
 
 	if (!success)
@@ -474,7 +908,8 @@ e_etesync_connection_collection_create_upload_sync (EEteSyncConnection *connecti
 	else
 		etebase_collection_destroy (col_obj);
 
-	g_rec_mutex_unlock (&connection->priv->connection_lock);
+	if (col_mgr)
+		etebase_collection_manager_destroy (col_mgr);
 
 	return success;
 }
@@ -487,8 +922,10 @@ e_etesync_connection_collection_modify_upload_sync (EEteSyncConnection *connecti
 						    const gchar *color,
 						    GError **error)
 {
+	EtebaseCollectionManager *col_mgr;
 	EtebaseItemMetadata *item_metadata;
 	gboolean success = TRUE;
+	gint session_generation = -1;
 	time_t now;
 	GError *local_error = NULL;
 
@@ -496,7 +933,14 @@ e_etesync_connection_collection_modify_upload_sync (EEteSyncConnection *connecti
 	g_return_val_if_fail (col_obj != NULL, FALSE);
 	g_return_val_if_fail (display_name && *display_name, FALSE);
 
-	g_rec_mutex_lock (&connection->priv->connection_lock);
+	col_mgr = e_etesync_connection_dup_collection_manager (connection, &session_generation);
+
+	if (!col_mgr) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_CONNECTED, _("Not connected"));
+		return FALSE;
+	}
+
+	e_etesync_connection_lock_collection (connection, col_obj);
 
 	item_metadata = etebase_collection_get_meta (col_obj);
 	etebase_item_metadata_set_name (item_metadata, display_name);
@@ -506,13 +950,14 @@ e_etesync_connection_collection_modify_upload_sync (EEteSyncConnection *connecti
 	etebase_item_metadata_set_mtime (item_metadata, &now);
 
 	etebase_collection_set_meta (col_obj, item_metadata);
-	success = !etebase_collection_manager_upload (connection->priv->col_mgr, col_obj, NULL);
+	success = e_etesync_connection_collection_upload_sync (connection, col_mgr, col_obj);
 
 	if (!success &&
 	    etebase_error_get_code () == ETEBASE_ERROR_CODE_UNAUTHORIZED &&
-	    e_etesync_connection_reconnect_sync (connection, NULL, NULL, &local_error)) {
+	    e_etesync_connection_reconnect_internal_sync (connection, session_generation, NULL, NULL, &local_error)) {
 
-		success = !etebase_collection_manager_upload (connection->priv->col_mgr, col_obj, NULL);
+		e_etesync_connection_renew_collection_manager (connection, &col_mgr);
+		success = col_mgr && e_etesync_connection_collection_upload_sync (connection, col_mgr, col_obj);
 	}
 
 	if (!success)
@@ -523,7 +968,10 @@ e_etesync_connection_collection_modify_upload_sync (EEteSyncConnection *connecti
 
 	etebase_item_metadata_destroy (item_metadata);
 
-	g_rec_mutex_unlock (&connection->priv->connection_lock);
+	e_etesync_connection_unlock_collection (connection, col_obj);
+
+	if (col_mgr)
+		etebase_collection_manager_destroy (col_mgr);
 
 	return success;
 }
@@ -535,8 +983,10 @@ e_etesync_connection_collection_delete_upload_sync (EEteSyncConnection *connecti
 						    GCancellable *cancellable,
 						    GError **error)
 {
+	EtebaseCollectionManager *col_mgr;
 	EtebaseItemMetadata *item_metadata;
 	gboolean success = TRUE;
+	gint session_generation = -1;
 	time_t now;
 
 	g_return_val_if_fail (connection != NULL, FALSE);
@@ -545,7 +995,14 @@ e_etesync_connection_collection_delete_upload_sync (EEteSyncConnection *connecti
 	if (g_cancellable_set_error_if_cancelled (cancellable, error))
 		return FALSE;
 
-	g_rec_mutex_lock (&connection->priv->connection_lock);
+	col_mgr = e_etesync_connection_dup_collection_manager (connection, &session_generation);
+
+	if (!col_mgr) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_CONNECTED, _("Not connected"));
+		return FALSE;
+	}
+
+	e_etesync_connection_lock_collection (connection, col_obj);
 
 	item_metadata = etebase_collection_get_meta (col_obj);
 	e_etesync_utils_get_time_now (&now);
@@ -553,13 +1010,14 @@ e_etesync_connection_collection_delete_upload_sync (EEteSyncConnection *connecti
 
 	etebase_collection_set_meta (col_obj, item_metadata);
 	etebase_collection_delete (col_obj);
-	success = !etebase_collection_manager_upload (connection->priv->col_mgr, col_obj, NULL);
+	success = e_etesync_connection_collection_upload_sync (connection, col_mgr, col_obj);
 
 	if (!success &&
 	    etebase_error_get_code () == ETEBASE_ERROR_CODE_UNAUTHORIZED &&
-	    e_etesync_connection_maybe_reconnect_sync (connection, backend, cancellable, error)) {
+	    e_etesync_connection_maybe_reconnect_sync (connection, backend, session_generation, cancellable, error)) {
 
-		success = !etebase_collection_manager_upload (connection->priv->col_mgr, col_obj, NULL);
+		e_etesync_connection_renew_collection_manager (connection, &col_mgr);
+		success = col_mgr && e_etesync_connection_collection_upload_sync (connection, col_mgr, col_obj);
 	}
 
 	if (!success)
@@ -567,11 +1025,168 @@ e_etesync_connection_collection_delete_upload_sync (EEteSyncConnection *connecti
 
 	etebase_item_metadata_destroy (item_metadata);
 
-	g_rec_mutex_unlock (&connection->priv->connection_lock);
+	e_etesync_connection_unlock_collection (connection, col_obj);
+
+	if (col_mgr)
+		etebase_collection_manager_destroy (col_mgr);
 
 	return success;
 }
 
+/* A decoded collection, as stored in the ESourceEteSync::etebase-collection */
+typedef struct _KnownCollection {
+	gchar *col_obj_b64;
+	EtebaseCollection *col_obj;
+} KnownCollection;
+
+static void
+known_collection_free (gpointer ptr)
+{
+	KnownCollection *known = ptr;
+
+	if (known) {
+		g_free (known->col_obj_b64);
+		if (known->col_obj)
+			etebase_collection_destroy (known->col_obj);
+		g_slice_free (KnownCollection, known);
+	}
+}
+
+/* Returns a copy of the collection 'col_uid', which is stored as 'col_obj_b64', decoding
+   it only when it's not known yet or it changed, thus the users of one collection share
+   the decoded object; free it with etebase_collection_destroy(). The 'col_obj_b64' can be
+   NULL, to get the last known collection. Returns NULL, when it cannot be decoded. */
+EtebaseCollection *
+e_etesync_connection_dup_collection (EEteSyncConnection *connection,
+				     const gchar *col_uid,
+				     const gchar *col_obj_b64)
+{
+	KnownCollection *known;
+	EtebaseCollection *col_obj = NULL;
+
+	g_return_val_if_fail (E_IS_ETESYNC_CONNECTION (connection), NULL);
+
+	g_rec_mutex_lock (&connection->priv->connection_lock);
+
+	known = col_uid ? g_hash_table_lookup (connection->priv->known_collections, col_uid) : NULL;
+
+	if (known && (!col_obj_b64 || g_strcmp0 (known->col_obj_b64, col_obj_b64) == 0)) {
+		col_obj = etebase_collection_clone (known->col_obj);
+	} else if (col_obj_b64 && *col_obj_b64 && connection->priv->col_mgr) {
+		EtebaseCollection *decoded;
+
+		decoded = e_etesync_utils_etebase_collection_from_base64 (col_obj_b64, connection->priv->col_mgr);
+
+		if (decoded) {
+			col_obj = etebase_collection_clone (decoded);
+
+			known = g_slice_new0 (KnownCollection);
+			known->col_obj_b64 = g_strdup (col_obj_b64);
+			known->col_obj = decoded;
+
+			g_hash_table_insert (connection->priv->known_collections, g_strdup (etebase_collection_get_uid (decoded)), known);
+		}
+	}
+
+	g_rec_mutex_unlock (&connection->priv->connection_lock);
+
+	return col_obj;
+}
+
+/* The registry stores the collection in the 'source', as it has it from the server,
+   thus a changed stoken means a change in the collection. Replaces the '*inout_col_obj'
+   with the stored collection and returns whether its stoken changed. */
+gboolean
+e_etesync_connection_update_collection_from_source (EEteSyncConnection *connection,
+						    ESource *source,
+						    EtebaseCollection **inout_col_obj)
+{
+	EtebaseCollection *col_obj = NULL;
+	gboolean changed = FALSE;
+
+	g_return_val_if_fail (E_IS_ETESYNC_CONNECTION (connection), FALSE);
+	g_return_val_if_fail (E_IS_SOURCE (source), FALSE);
+	g_return_val_if_fail (inout_col_obj != NULL, FALSE);
+
+	if (*inout_col_obj && e_etesync_connection_is_connected (connection) &&
+	    e_source_has_extension (source, E_SOURCE_EXTENSION_ETESYNC)) {
+		gchar *col_obj_b64;
+
+		col_obj_b64 = e_source_etesync_dup_etebase_collection_b64 (e_source_get_extension (source, E_SOURCE_EXTENSION_ETESYNC));
+		col_obj = col_obj_b64 ? e_etesync_connection_dup_collection (connection,
+			etebase_collection_get_uid (*inout_col_obj), col_obj_b64) : NULL;
+
+		g_free (col_obj_b64);
+	}
+
+	if (col_obj) {
+		changed = g_strcmp0 (etebase_collection_get_stoken (col_obj),
+				     etebase_collection_get_stoken (*inout_col_obj)) != 0;
+
+		etebase_collection_destroy (*inout_col_obj);
+		*inout_col_obj = col_obj;
+	}
+
+	return changed;
+}
+
+/* Remembers the 'col_obj' as received from the server, with its 'col_obj_b64',
+   thus the next e_etesync_connection_dup_collection() does not decode it */
+void
+e_etesync_connection_set_collection (EEteSyncConnection *connection,
+				     const EtebaseCollection *col_obj,
+				     const gchar *col_obj_b64)
+{
+	KnownCollection *known;
+
+	g_return_if_fail (E_IS_ETESYNC_CONNECTION (connection));
+	g_return_if_fail (col_obj != NULL);
+	g_return_if_fail (col_obj_b64 != NULL);
+
+	known = g_slice_new0 (KnownCollection);
+	known->col_obj_b64 = g_strdup (col_obj_b64);
+	known->col_obj = etebase_collection_clone (col_obj);
+
+	g_rec_mutex_lock (&connection->priv->connection_lock);
+	g_hash_table_insert (connection->priv->known_collections, g_strdup (etebase_collection_get_uid (col_obj)), known);
+	g_rec_mutex_unlock (&connection->priv->connection_lock);
+}
+
+/* Returns the 'col_obj' serialized with the collection manager of the current
+   session, free it with g_free(); or NULL, when not connected */
+gchar *
+e_etesync_connection_collection_to_base64 (EEteSyncConnection *connection,
+					   const EtebaseCollection *col_obj)
+{
+	gchar *col_obj_b64 = NULL;
+
+	g_return_val_if_fail (E_IS_ETESYNC_CONNECTION (connection), NULL);
+	g_return_val_if_fail (col_obj != NULL, NULL);
+
+	g_rec_mutex_lock (&connection->priv->connection_lock);
+
+	if (connection->priv->col_mgr)
+		col_obj_b64 = e_etesync_utils_etebase_collection_to_base64 (col_obj, connection->priv->col_mgr);
+
+	g_rec_mutex_unlock (&connection->priv->connection_lock);
+
+	return col_obj_b64;
+}
+
+void
+e_etesync_connection_forget_collection (EEteSyncConnection *connection,
+					const gchar *col_uid)
+{
+	g_return_if_fail (E_IS_ETESYNC_CONNECTION (connection));
+
+	if (!col_uid)
+		return;
+
+	g_rec_mutex_lock (&connection->priv->connection_lock);
+	g_hash_table_remove (connection->priv->known_collections, col_uid);
+	g_rec_mutex_unlock (&connection->priv->connection_lock);
+}
+
 /* ------------------- Book and calendar common function ------------------- */
 static gboolean
 e_etesync_connection_backend_is_for_memos (EBackend *backend)
@@ -579,6 +1194,458 @@ e_etesync_connection_backend_is_for_memos (EBackend *backend)
 	return E_IS_CAL_BACKEND (backend) && e_cal_backend_get_kind (E_CAL_BACKEND (backend)) == I_CAL_VJOURNAL_COMPONENT;
 }
 
+/* The 'extra' of the stored objects is either the base64 of the cached item, as used
+   to be stored before, or the E_ETESYNC_ITEM_EXTRA_PREFIX followed by the item UID and
+   its etag, with the cached item itself stored in the ECache by e_etesync_cache_store_item_data_sync() */
+
+static gchar *
+e_etesync_connection_item_extra_new (const EtebaseItem *item)
+{
+	gchar *etag, *extra;
+
+	etag = etebase_item_get_etag (item);
+	extra = g_strconcat (E_ETESYNC_ITEM_EXTRA_PREFIX, etebase_item_get_uid (item), ":", etag ? etag : "", NULL);
+
+	g_free (etag);
+
+	return extra;
+}
+
+/* Returns the item UID stored in the 'extra', or NULL, when it's the base64 of the item */
+static gchar *
+e_etesync_connection_item_extra_dup_item_uid (const gchar *extra)
+{
+	const gchar *item_uid, *sep;
+
+	if (!extra || !g_str_has_prefix (extra, E_ETESYNC_ITEM_EXTRA_PREFIX))
+		return NULL;
+
+	item_uid = extra + strlen (E_ETESYNC_ITEM_EXTRA_PREFIX);
+	sep = strchr (item_uid, ':');
+
+	return sep ? g_strndup (item_uid, sep - item_uid) : NULL;
+}
+
+static ECache *
+e_etesync_connection_ref_backend_cache (EBackend *backend)
+{
+	if (E_IS_BOOK_META_BACKEND (backend))
+		return E_CACHE (e_book_meta_backend_ref_cache (E_BOOK_META_BACKEND (backend)));
+
+	if (E_IS_CAL_META_BACKEND (backend))
+		return E_CACHE (e_cal_meta_backend_ref_cache (E_CAL_META_BACKEND (backend)));
+
+	return NULL;
+}
+
+/* Stores the 'item_caches' of the 'items' into the 'cache' and frees them;
+   the NULL item caches are skipped */
+static gboolean
+e_etesync_connection_store_item_caches_sync (ECache *cache,
+					     const EtebaseItem *const *items,
+					     GBytes **item_caches,
+					     guint n_items,
+					     GCancellable *cancellable,
+					     GError **error)
+{
+	const gchar **item_uids;
+	gboolean success;
+	guint ii;
+
+	item_uids = g_new0 (const gchar *, n_items);
+
+	for (ii = 0; ii < n_items; ii++) {
+		if (item_caches[ii])
+			item_uids[ii] = etebase_item_get_uid (items[ii]);
+	}
+
+	success = e_etesync_cache_store_item_data_sync (cache, item_uids, item_caches, n_items, cancellable, error);
+
+	for (ii = 0; ii < n_items; ii++) {
+		if (item_caches[ii]) {
+			g_bytes_unref (item_caches[ii]);
+			item_caches[ii] = NULL;
+		}
+	}
+
+	g_free (item_uids);
+
+	return success;
+}
+
+typedef struct _ItemsToBytes {
+	EtebaseItemManager *item_mgr;
+	const EtebaseItem *const *items;
+	GBytes **item_caches;
+} ItemsToBytes;
+
+static void
+e_etesync_connection_item_to_bytes_worker (guint index,
+					   gpointer user_data)
+{
+	ItemsToBytes *data = user_data;
+
+	data->item_caches[index] = e_etesync_utils_etebase_item_to_bytes (data->items[index], data->item_mgr);
+}
+
+/* Serializes the 'items' in the shared worker threads; the returned array
+   has 'n_items' GBytes *, NULL for the items, which failed to be serialized */
+static GBytes **
+e_etesync_connection_items_to_bytes (EtebaseItemManager *item_mgr,
+				     const EtebaseItem *const *items,
+				     guint n_items)
+{
+	ItemsToBytes data;
+
+	data.item_mgr = item_mgr;
+	data.items = items;
+	data.item_caches = g_new0 (GBytes *, n_items);
+
+	e_etesync_workers_run (n_items, e_etesync_connection_item_to_bytes_worker, &data);
+
+	return data.item_caches;
+}
+
+/* Saves the 'items' into the 'cache', to be found by their extra later */
+static gboolean
+e_etesync_connection_save_items_sync (ECache *cache,
+				      EtebaseItemManager *item_mgr,
+				      const EtebaseItem *const *items,
+				      guint n_items,
+				      GCancellable *cancellable,
+				      GError **error)
+{
+	GBytes **item_caches;
+	gboolean success;
+
+	item_caches = e_etesync_connection_items_to_bytes (item_mgr, items, n_items);
+
+	success = e_etesync_connection_store_item_caches_sync (cache, items, item_caches, n_items, cancellable, error);
+
+	g_free (item_caches);
+
+	return success;
+}
+
+/* Removes the saved 'items' from the 'cache' */
+static gboolean
+e_etesync_connection_forget_items_sync (ECache *cache,
+					const EtebaseItem *const *items,
+					guint n_items,
+					GCancellable *cancellable,
+					GError **error)
+{
+	GSList *cache_items = NULL;
+	gboolean success;
+	guint ii;
+
+	for (ii = 0; ii < n_items; ii++)
+		cache_items = g_slist_prepend (cache_items, e_etesync_cache_item_new (etebase_item_get_uid (items[ii]), NULL, NULL));
+
+	success = e_etesync_cache_store_items_sync (cache, cache_items, cancellable, error);
+
+	g_slist_free_full (cache_items, e_etesync_cache_item_free);
+
+	return success;
+}
+
+/* Records the etags of the uploaded 'items', holding the objects 'uids', thus
+   the next get_changes can recognize them as our own changes and skip them,
+   instead of decrypting and parsing them again. The deleted items are recorded
+   without the uid, to not be found by e_etesync_cache_dup_item_uid_sync(). */
+static void
+e_etesync_connection_remember_uploaded_sync (ECache *cache,
+					     const EtebaseItem *const *items,
+					     const gchar *const *uids,
+					     guint n_items,
+					     GCancellable *cancellable)
+{
+	GSList *cache_items = NULL;
+	GError *local_error = NULL;
+	guint ii;
+
+	for (ii = 0; ii < n_items; ii++) {
+		gchar *etag;
+
+		if (!items[ii])
+			continue;
+
+		etag = etebase_item_get_etag (items[ii]);
+
+		if (etag) {
+			cache_items = g_slist_prepend (cache_items, e_etesync_cache_item_new (etebase_item_get_uid (items[ii]),
+				etebase_item_is_deleted (items[ii]) ? NULL : uids[ii], etag));
+		}
+
+		g_free (etag);
+	}
+
+	if (!e_etesync_cache_store_items_sync (cache, cache_items, cancellable, &local_error)) {
+		g_warning ("%s: Failed to store item states: %s", G_STRFUNC, local_error ? local_error->message : "Unknown error");
+		g_clear_error (&local_error);
+	}
+
+	g_slist_free_full (cache_items, e_etesync_cache_item_free);
+}
+
+/* A decoded item in the CollectionData::items LRU */
+typedef struct _CachedItem {
+	gchar *uid; /* the contact/component uid, the key */
+	gchar *extra; /* the item cache the 'item' was decoded from or encoded to */
+	EtebaseItem *item;
+} CachedItem;
+
+static void
+cached_item_free (gpointer ptr)
+{
+	CachedItem *cached = ptr;
+
+	if (cached) {
+		g_free (cached->uid);
+		g_free (cached->extra);
+		if (cached->item)
+			etebase_item_destroy (cached->item);
+		g_slice_free (CachedItem, cached);
+	}
+}
+
+/* Data shared by all the users of one collection; its item manager uses the
+   token of the session it had been created with, thus it's replaced with
+   a new one, with the decoded items moved over, after the session changes. */
+typedef struct _CollectionData {
+	volatile gint ref_count;
+	EtebaseItemManager *item_mgr;
+	EEteSyncExecutor *executor;
+	gint session_generation; /* of the session the 'item_mgr' is from */
+
+	GMutex items_lock;
+	GHashTable *items; /* gchar *uid ~> GList * in 'items_lru' */
+	GQueue items_lru; /* CachedItem *, the most recently used first */
+} CollectionData;
+
+static CollectionData *
+collection_data_new (EtebaseItemManager *item_mgr,
+		     EEteSyncExecutor *executor,
+		     gint session_generation)
+{
+	CollectionData *data;
+
+	data = g_slice_new0 (CollectionData);
+	data->ref_count = 1;
+	data->item_mgr = item_mgr;
+	data->executor = e_etesync_executor_ref (executor);
+	data->session_generation = session_generation;
+	data->items = g_hash_table_new (g_str_hash, g_str_equal);
+	g_mutex_init (&data->items_lock);
+	g_queue_init (&data->items_lru);
+
+	return data;
+}
+
+static CollectionData *
+collection_data_ref (CollectionData *data)
+{
+	g_atomic_int_inc (&data->ref_count);
+
+	return data;
+}
+
+static void
+collection_data_unref (gpointer ptr)
+{
+	CollectionData *data = ptr;
+
+	if (data && g_atomic_int_dec_and_test (&data->ref_count)) {
+		g_hash_table_destroy (data->items);
+		g_queue_foreach (&data->items_lru, (GFunc) cached_item_free, NULL);
+		g_queue_clear (&data->items_lru);
+		g_mutex_clear (&data->items_lock);
+		if (data->item_mgr)
+			etebase_item_manager_destroy (data->item_mgr);
+		e_etesync_executor_unref (data->executor);
+		g_slice_free (CollectionData, data);
+	}
+}
+
+/* Moves the decoded items of the 'from' into the new 'to', not used by other threads yet */
+static void
+collection_data_move_items (CollectionData *to,
+			    CollectionData *from)
+{
+	GHashTable *items;
+	GQueue items_lru;
+
+	g_mutex_lock (&from->items_lock);
+
+	items = to->items;
+	items_lru = to->items_lru;
+
+	to->items = from->items;
+	to->items_lru = from->items_lru;
+
+	from->items = items;
+	from->items_lru = items_lru;
+
+	g_mutex_unlock (&from->items_lock);
+}
+
+/* Returns the decoded item for the 'uid', removing it from the LRU, thus the caller
+   owns it, or NULL, when it's not there or it doesn't match the 'extra' */
+static EtebaseItem *
+collection_data_take_item (CollectionData *data,
+			   const gchar *uid,
+			   const gchar *extra)
+{
+	EtebaseItem *item = NULL;
+	GList *link;
+
+	if (!uid || !extra)
+		return NULL;
+
+	g_mutex_lock (&data->items_lock);
+
+	link = g_hash_table_lookup (data->items, uid);
+
+	if (link) {
+		CachedItem *cached = link->data;
+
+		g_hash_table_remove (data->items, uid);
+		g_queue_delete_link (&data->items_lru, link);
+
+		/* the cache had been updated from elsewhere, like by a sync */
+		if (g_strcmp0 (cached->extra, extra) == 0) {
+			item = cached->item;
+			cached->item = NULL;
+		}
+
+		cached_item_free (cached);
+	}
+
+	g_mutex_unlock (&data->items_lock);
+
+	return item;
+}
+
+/* Adds the 'item', which is stored as 'extra' for the 'uid', into the LRU; assumes ownership of the 'item' */
+static void
+collection_data_put_item (CollectionData *data,
+			  const gchar *uid,
+			  const gchar *extra,
+			  EtebaseItem *item)
+{
+	CachedItem *cached;
+	GList *link;
+
+	if (!uid || !extra) {
+		etebase_item_destroy (item);
+		return;
+	}
+
+	cached = g_slice_new0 (CachedItem);
+	cached->uid = g_strdup (uid);
+	cached->extra = g_strdup (extra);
+	cached->item = item;
+
+	g_mutex_lock (&data->items_lock);
+
+	link = g_hash_table_lookup (data->items, uid);
+
+	if (link) {
+		g_hash_table_remove (data->items, uid);
+		cached_item_free (link->data);
+		g_queue_delete_link (&data->items_lru, link);
+	}
+
+	g_queue_push_head (&data->items_lru, cached);
+	g_hash_table_insert (data->items, cached->uid, data->items_lru.head);
+
+	while (g_queue_get_length (&data->items_lru) > E_ETESYNC_ITEM_CACHE_SIZE) {
+		cached = g_queue_pop_tail (&data->items_lru);
+
+		g_hash_table_remove (data->items, cached->uid);
+		cached_item_free (cached);
+	}
+
+	g_mutex_unlock (&data->items_lock);
+}
+
+/* Returns the decoded item for the 'uid', either from the LRU or from the 'extra' */
+static EtebaseItem *
+collection_data_dup_item (CollectionData *data,
+			  ECache *cache,
+			  const gchar *uid,
+			  const gchar *extra)
+{
+	EtebaseItem *item;
+	gchar *item_uid;
+
+	item = collection_data_take_item (data, uid, extra);
+
+	if (item || !extra)
+		return item;
+
+	item_uid = e_etesync_connection_item_extra_dup_item_uid (extra);
+
+	if (item_uid) {
+		GBytes *item_cache = NULL;
+
+		if (e_etesync_cache_dup_item_data_sync (cache, item_uid, &item_cache, NULL, NULL) && item_cache) {
+			item = e_etesync_utils_etebase_item_from_bytes (item_cache, data->item_mgr);
+			g_bytes_unref (item_cache);
+		}
+
+		g_free (item_uid);
+	} else {
+		/* stored by an older version */
+		item = e_etesync_utils_etebase_item_from_base64 (extra, data->item_mgr);
+	}
+
+	return item;
+}
+
+/* Returns the shared data for the 'col_obj', unref it with collection_data_unref(),
+   or NULL, when not connected */
+static CollectionData *
+e_etesync_connection_ref_collection_data (EEteSyncConnection *connection,
+					  const EtebaseCollection *col_obj)
+{
+	CollectionData *data, *stale_data = NULL;
+	const gchar *col_uid;
+
+	g_rec_mutex_lock (&connection->priv->connection_lock);
+
+	col_uid = etebase_collection_get_uid (col_obj);
+	data = g_hash_table_lookup (connection->priv->collections, col_uid);
+
+	/* the item manager of the data is from an older session */
+	if (data && data->session_generation != connection->priv->session_generation) {
+		stale_data = data;
+		data = NULL;
+	}
+
+	if (!data && connection->priv->col_mgr) {
+		EtebaseItemManager *item_mgr;
+
+		item_mgr = etebase_collection_manager_get_item_manager (connection->priv->col_mgr, col_obj);
+
+		if (item_mgr) {
+			data = collection_data_new (item_mgr, connection->priv->executor, connection->priv->session_generation);
+
+			if (stale_data)
+				collection_data_move_items (data, stale_data);
+
+			g_hash_table_insert (connection->priv->collections, g_strdup (col_uid), data);
+		}
+	}
+
+	if (data)
+		collection_data_ref (data);
+
+	g_rec_mutex_unlock (&connection->priv->connection_lock);
+
+	return data;
+}
+
 static gchar *
 e_etesync_connection_notes_new_ical_string (time_t creation_date,
 					    time_t last_modified,
@@ -636,10 +1703,39 @@ e_etesync_connection_notes_new_ical_string (time_t creation_date,
 	return ical_str;
 }
 
-static gboolean
-e_etesync_connection_chunk_itemlist_fetch_sync (EtebaseItemManager *item_mgr,
-						const gchar *stoken,
-						gintptr fetch_limit,
+/* Fetches the item 'item_uid', as one of the request slots of the account */
+static EtebaseItem *
+e_etesync_connection_item_fetch_request_sync (CollectionData *data,
+					      const gchar *item_uid)
+{
+	EtebaseItem *item;
+
+	e_etesync_executor_begin_request (data->executor, E_ETESYNC_REQUEST_FETCH);
+	item = etebase_item_manager_fetch (data->item_mgr, item_uid, NULL);
+	e_etesync_executor_end_request (data->executor, E_ETESYNC_REQUEST_FETCH);
+
+	return item;
+}
+
+/* Uploads the 'items' in one request, as one of the request slots of the account */
+static gboolean
+e_etesync_connection_items_batch_request_sync (CollectionData *data,
+					       EtebaseItem **items,
+					       guint n_items)
+{
+	gboolean success;
+
+	e_etesync_executor_begin_request (data->executor, E_ETESYNC_REQUEST_BATCH);
+	success = !etebase_item_manager_batch (data->item_mgr, (const EtebaseItem **) items, n_items, NULL);
+	e_etesync_executor_end_request (data->executor, E_ETESYNC_REQUEST_BATCH);
+
+	return success;
+}
+
+static gboolean
+e_etesync_connection_chunk_itemlist_fetch_sync (CollectionData *data,
+						const gchar *stoken,
+						gintptr fetch_limit,
 						EtebaseItemListResponse **out_item_list,
 						guintptr *out_item_data_len,
 						gchar **out_stoken,
@@ -650,7 +1746,9 @@ e_etesync_connection_chunk_itemlist_fetch_sync (EtebaseItemManager *item_mgr,
 	etebase_fetch_options_set_stoken (fetch_options, stoken);
 	etebase_fetch_options_set_limit (fetch_options, fetch_limit);
 
-	*out_item_list = etebase_item_manager_list (item_mgr, fetch_options);
+	e_etesync_executor_begin_request (data->executor, E_ETESYNC_REQUEST_LIST_PAGE);
+	*out_item_list = etebase_item_manager_list (data->item_mgr, fetch_options);
+	e_etesync_executor_end_request (data->executor, E_ETESYNC_REQUEST_LIST_PAGE);
 
 	if (!*out_item_list) {
 		etebase_fetch_options_destroy (fetch_options);
@@ -667,417 +1765,2291 @@ e_etesync_connection_chunk_itemlist_fetch_sync (EtebaseItemManager *item_mgr,
 	return TRUE;
 }
 
+/* One page of items fetched by the page fetcher thread */
+typedef struct _FetchPage {
+	EtebaseItemListResponse *item_list;
+	guintptr items_data_len;
+	gchar *stoken; /* stoken to be used to fetch the page after this one */
+	gboolean done;
+} FetchPage;
+
+static void
+fetch_page_free (gpointer ptr)
+{
+	FetchPage *page = ptr;
+
+	if (page) {
+		etebase_item_list_response_destroy (page->item_list);
+		g_free (page->stoken);
+		g_slice_free (FetchPage, page);
+	}
+}
+
+/* Fetches the pages of items in a dedicated thread, while the caller
+   is processing the already fetched pages. At most E_ETESYNC_ITEM_FETCH_QUEUE_LENGTH
+   pages wait to be processed, to not hold whole collection in memory. */
+typedef struct _FetchPipeline {
+	CollectionData *data;
+	gchar *stoken; /* used only by the fetcher thread */
+	gchar *next_stoken; /* the next popped page continues from this stoken; used only by the consumer */
+	gchar *collection_stoken; /* the collection stoken known before the fetching started, or NULL */
+
+	GMutex lock;
+	GCond cond;
+	GQueue pages; /* FetchPage * */
+	gboolean stop; /* the consumer doesn't want more pages */
+	gboolean finished; /* the fetcher thread stopped fetching */
+
+	/* set when the fetcher thread failed; libetebase errors are thread-local,
+	   thus they should be copied here for the consumer */
+	EtebaseErrorCode etebase_error;
+	gchar *etebase_error_message;
+
+	GThread *thread;
+} FetchPipeline;
+
+static gpointer
+e_etesync_connection_fetch_pipeline_thread (gpointer user_data)
+{
+	FetchPipeline *pipeline = user_data;
+	gboolean done = FALSE;
+
+	while (!done) {
+		FetchPage *page;
+		EtebaseItemListResponse *item_list = NULL;
+		guintptr items_data_len = 0;
+
+		g_mutex_lock (&pipeline->lock);
+		while (!pipeline->stop && g_queue_get_length (&pipeline->pages) >= E_ETESYNC_ITEM_FETCH_QUEUE_LENGTH)
+			g_cond_wait (&pipeline->cond, &pipeline->lock);
+		done = pipeline->stop;
+		g_mutex_unlock (&pipeline->lock);
+
+		if (done)
+			break;
+
+		if (!e_etesync_connection_chunk_itemlist_fetch_sync (pipeline->data, pipeline->stoken, E_ETESYNC_ITEM_FETCH_LIMIT, &item_list, &items_data_len, &pipeline->stoken, &done)) {
+			g_mutex_lock (&pipeline->lock);
+			pipeline->etebase_error = etebase_error_get_code ();
+			pipeline->etebase_error_message = g_strdup (etebase_error_get_message ());
+			g_mutex_unlock (&pipeline->lock);
+			break;
+		}
+
+		page = g_slice_new0 (FetchPage);
+		page->item_list = item_list;
+		page->items_data_len = items_data_len;
+		page->stoken = g_strdup (pipeline->stoken);
+		page->done = done;
+
+		g_mutex_lock (&pipeline->lock);
+		g_queue_push_tail (&pipeline->pages, page);
+		g_cond_broadcast (&pipeline->cond);
+		g_mutex_unlock (&pipeline->lock);
+	}
+
+	g_mutex_lock (&pipeline->lock);
+	pipeline->finished = TRUE;
+	g_cond_broadcast (&pipeline->cond);
+	g_mutex_unlock (&pipeline->lock);
+
+	return NULL;
+}
+
+/* Assumes ownership of the 'data' */
+static FetchPipeline *
+e_etesync_connection_fetch_pipeline_new (CollectionData *data,
+					 const gchar *stoken)
+{
+	FetchPipeline *pipeline;
+
+	pipeline = g_slice_new0 (FetchPipeline);
+	pipeline->data = data;
+	pipeline->stoken = g_strdup (stoken);
+	pipeline->next_stoken = g_strdup (stoken);
+	g_mutex_init (&pipeline->lock);
+	g_cond_init (&pipeline->cond);
+	g_queue_init (&pipeline->pages);
+
+	pipeline->thread = g_thread_new ("etesync-fetch-items", e_etesync_connection_fetch_pipeline_thread, pipeline);
+
+	return pipeline;
+}
+
+static void
+e_etesync_connection_fetch_pipeline_free (FetchPipeline *pipeline)
+{
+	if (!pipeline)
+		return;
+
+	g_mutex_lock (&pipeline->lock);
+	pipeline->stop = TRUE;
+	g_cond_broadcast (&pipeline->cond);
+	g_mutex_unlock (&pipeline->lock);
+
+	/* waits for the currently running request, if any */
+	g_thread_join (pipeline->thread);
+
+	g_queue_foreach (&pipeline->pages, (GFunc) fetch_page_free, NULL);
+	g_queue_clear (&pipeline->pages);
+	g_mutex_clear (&pipeline->lock);
+	g_cond_clear (&pipeline->cond);
+	g_free (pipeline->etebase_error_message);
+	g_free (pipeline->stoken);
+	g_free (pipeline->next_stoken);
+	g_free (pipeline->collection_stoken);
+	collection_data_unref (pipeline->data);
+	g_slice_free (FetchPipeline, pipeline);
+}
+
+/* Returns the next fetched page, waiting for it when needed, or NULL, when
+   the fetching failed; the error is stored in the 'pipeline' in such case */
+static FetchPage *
+e_etesync_connection_fetch_pipeline_pop (FetchPipeline *pipeline)
+{
+	FetchPage *page;
+
+	g_mutex_lock (&pipeline->lock);
+
+	while (g_queue_is_empty (&pipeline->pages) && !pipeline->finished)
+		g_cond_wait (&pipeline->cond, &pipeline->lock);
+
+	page = g_queue_pop_head (&pipeline->pages);
+
+	/* wake up the fetcher thread, there's a free space in the queue now */
+	g_cond_broadcast (&pipeline->cond);
+	g_mutex_unlock (&pipeline->lock);
+
+	if (page) {
+		g_free (pipeline->next_stoken);
+		pipeline->next_stoken = g_strdup (page->stoken);
+	}
+
+	return page;
+}
+
+/* Handles failure of the 'pipeline', trying to reconnect when the token expired.
+   When it can continue, then it restarts the fetching from the last popped page and returns TRUE. */
+static gboolean
+e_etesync_connection_fetch_pipeline_restart_sync (EEteSyncConnection *connection,
+						  EBackend *backend,
+						  const EtebaseCollection *col_obj,
+						  FetchPipeline **inout_pipeline,
+						  GCancellable *cancellable,
+						  GError **error)
+{
+	FetchPipeline *pipeline = *inout_pipeline;
+	CollectionData *data;
+	gchar *stoken, *collection_stoken;
+	gboolean success = FALSE;
+
+	if (pipeline->etebase_error == ETEBASE_ERROR_CODE_UNAUTHORIZED)
+		success = e_etesync_connection_maybe_reconnect_sync (connection, backend, pipeline->data->session_generation, cancellable, error);
+
+	if (!success) {
+		e_etesync_utils_set_io_gerror (pipeline->etebase_error, pipeline->etebase_error_message, error);
+		return FALSE;
+	}
+
+	/* as collection manager may have changed */
+	data = e_etesync_connection_ref_collection_data (connection, col_obj);
+
+	if (!data) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_CONNECTED, _("Not connected"));
+		return FALSE;
+	}
+
+	stoken = g_strdup (pipeline->next_stoken);
+	collection_stoken = g_strdup (pipeline->collection_stoken);
+	e_etesync_connection_fetch_pipeline_free (pipeline);
+
+	*inout_pipeline = e_etesync_connection_fetch_pipeline_new (data, stoken);
+	(*inout_pipeline)->collection_stoken = collection_stoken;
+
+	g_free (stoken);
+
+	return TRUE;
+}
+
+/* The largest per-thread content buffer kept after use; the bigger
+   ones, like for the items with photos or attachments, are freed */
+#define CONTENT_BUFFER_MAX_SIZE (1024 * 1024)
+
+/* A per-thread buffer for the decrypted item content */
+typedef struct _ContentBuffer {
+	gchar *data;
+	gsize size;
+} ContentBuffer;
+
+static void
+content_buffer_free (gpointer ptr)
+{
+	ContentBuffer *buffer = ptr;
+
+	if (buffer) {
+		g_free (buffer->data);
+		g_slice_free (ContentBuffer, buffer);
+	}
+}
+
+static GPrivate content_buffer = G_PRIVATE_INIT (content_buffer_free);
+
+/* Returns the decrypted content of the 'item', NUL-terminated, or NULL on failure. It's stored
+   in a buffer owned by the calling thread, which is valid until the next call from that thread.
+   The buffer grows to the largest content seen, up to the CONTENT_BUFFER_MAX_SIZE, thus only
+   items bigger than any before it are decrypted twice, to find out their size first. Call
+   e_etesync_connection_item_release_content(), once the content is not needed. */
+static const gchar *
+e_etesync_connection_item_get_content (const EtebaseItem *item)
+{
+	ContentBuffer *buffer;
+	gintptr content_len;
+
+	buffer = g_private_get (&content_buffer);
+
+	if (!buffer) {
+		buffer = g_slice_new0 (ContentBuffer);
+		g_private_set (&content_buffer, buffer);
+	}
+
+	if (!buffer->data) {
+		buffer->size = BUFF_SIZE;
+		buffer->data = g_malloc (buffer->size);
+	}
+
+	content_len = etebase_item_get_content (item, buffer->data, buffer->size);
+
+	if (content_len >= 0 && content_len >= buffer->size) {
+		/* with some reserve, to not grow on each slightly bigger item */
+		buffer->size = content_len + 1 + (content_len / 4);
+		g_free (buffer->data);
+		buffer->data = g_malloc (buffer->size);
+
+		content_len = etebase_item_get_content (item, buffer->data, buffer->size);
+
+		if (content_len >= buffer->size)
+			content_len = -1;
+	}
+
+	if (content_len < 0)
+		return NULL;
+
+	buffer->data[content_len] = '\0';
+
+	return buffer->data;
+}
+
+/* Frees the content buffer of the calling thread, when it grew over the CONTENT_BUFFER_MAX_SIZE;
+   the content returned by e_etesync_connection_item_get_content() is not valid after it */
+static void
+e_etesync_connection_item_release_content (void)
+{
+	ContentBuffer *buffer;
+
+	buffer = g_private_get (&content_buffer);
+
+	if (buffer && buffer->size > CONTENT_BUFFER_MAX_SIZE) {
+		g_clear_pointer (&buffer->data, g_free);
+		buffer->size = 0;
+	}
+}
+
+/* Decrypts the 'item' and returns a new EBookMetaBackendInfo * or ECalMetaBackendInfo *
+   for it, depending on the 'type', or NULL on failure. The 'out_item_cache' is set to
+   the saved item, which the info's extra refers to. It's called from the worker threads. */
+static gpointer
+e_etesync_connection_item_to_info (const EtebaseItem *item,
+				   EtebaseItemManager *item_mgr,
+				   const EteSyncType type,
+				   gboolean is_memo,
+				   GBytes **out_item_cache)
+{
+	gpointer nfo = NULL;
+	const gchar *content;
+	gchar *data_uid = NULL, *revision = NULL, *item_extra;
+
+	content = e_etesync_connection_item_get_content (item);
+
+	if (!content) {
+		e_etesync_connection_item_release_content ();
+		return NULL;
+	}
+
+	/* the deleted items are only removed, thus do not need to be saved */
+	if (!etebase_item_is_deleted (item))
+		*out_item_cache = e_etesync_utils_etebase_item_to_bytes (item, item_mgr);
+
+	item_extra = e_etesync_connection_item_extra_new (item);
+
+	if (type == E_ETESYNC_ADDRESSBOOK) {
+		/* data_uid is contact uid */
+		e_etesync_utils_get_contact_uid_revision (content, &data_uid, &revision);
+		nfo = e_book_meta_backend_info_new (data_uid, revision, content, item_extra);
+	} else if (type == E_ETESYNC_CALENDAR) {
+		if (is_memo) {
+			EtebaseItemMetadata *item_meta;
+			const gchar *summary;
+			gchar *ical_str;
+			time_t now;
+
+			item_meta = etebase_item_get_meta (item);
+			summary = etebase_item_metadata_get_name (item_meta);
+			data_uid = g_strdup (etebase_item_get_uid (item));
+			e_etesync_utils_get_time_now (&now);
+
+			/* change plain text to a icomp vjournal object */
+			ical_str = e_etesync_connection_notes_new_ical_string ((time_t) now, (time_t) now, data_uid, NULL, summary, content);
+			nfo = e_cal_meta_backend_info_new (data_uid, NULL, ical_str, item_extra);
+
+			g_free (ical_str);
+			etebase_item_metadata_destroy (item_meta);
+		} else {
+			/* data_uid is component uid */
+			e_etesync_utils_get_component_uid_revision (content, &data_uid, &revision);
+			nfo = e_cal_meta_backend_info_new (data_uid, revision, content, item_extra);
+		}
+	}
+
+	g_free (data_uid);
+	g_free (revision);
+	g_free (item_extra);
+
+	e_etesync_connection_item_release_content ();
+
+	return nfo;
+}
+
+typedef struct _ItemsToInfos {
+	EtebaseItemManager *item_mgr;
+	EteSyncType type;
+	gboolean is_memo;
+	const EtebaseItem **items;
+	gpointer *infos; /* EBookMetaBackendInfo * or ECalMetaBackendInfo * */
+	GBytes **item_caches;
+} ItemsToInfos;
+
+static void
+e_etesync_connection_item_to_info_worker (guint index,
+					  gpointer user_data)
+{
+	ItemsToInfos *data = user_data;
+
+	data->infos[index] = e_etesync_connection_item_to_info (data->items[index], data->item_mgr, data->type, data->is_memo, &data->item_caches[index]);
+}
+
+/* Converts the 'items' into meta backend infos, using the shared worker threads,
+   and saves the items into the 'cache', thus the infos' extra can be used later.
+   The 'out_infos' is filled in the same order as the 'items' are; the failed
+   items have set NULL there. */
+static gboolean
+e_etesync_connection_items_to_infos_sync (const EtebaseItem **items,
+					  guint n_items,
+					  EtebaseItemManager *item_mgr,
+					  ECache *cache,
+					  const EteSyncType type,
+					  gboolean is_memo,
+					  gpointer *out_infos,
+					  GCancellable *cancellable,
+					  GError **error)
+{
+	ItemsToInfos data;
+	gboolean success;
+	guint ii;
+
+	data.item_mgr = item_mgr;
+	data.type = type;
+	data.is_memo = is_memo;
+	data.items = items;
+	data.infos = out_infos;
+	data.item_caches = g_new0 (GBytes *, n_items);
+
+	e_etesync_workers_run (n_items, e_etesync_connection_item_to_info_worker, &data);
+
+	/* the item cache is not needed for the items, which failed to be read */
+	for (ii = 0; ii < n_items; ii++) {
+		if (!out_infos[ii] && data.item_caches[ii]) {
+			g_bytes_unref (data.item_caches[ii]);
+			data.item_caches[ii] = NULL;
+		}
+	}
+
+	success = e_etesync_connection_store_item_caches_sync (cache, items, data.item_caches, n_items, cancellable, error);
+
+	g_free (data.item_caches);
+
+	return success;
+}
+
+static void
+e_etesync_connection_info_free (const EteSyncType type,
+				gpointer nfo)
+{
+	if (!nfo)
+		return;
+
+	if (type == E_ETESYNC_ADDRESSBOOK)
+		e_book_meta_backend_info_free (nfo);
+	else
+		e_cal_meta_backend_info_free (nfo);
+}
+
+static const gchar *
+e_etesync_connection_info_get_uid (const EteSyncType type,
+				   gpointer nfo)
+{
+	if (type == E_ETESYNC_ADDRESSBOOK)
+		return ((EBookMetaBackendInfo *) nfo)->uid;
+
+	return ((ECalMetaBackendInfo *) nfo)->uid;
+}
+
+/* Lists all the items of the collection. With the 'page_func' each listed page is passed
+   to it and the 'out_existing_objects' is left empty, thus the caller can store the pages
+   as they come, instead of having the whole collection in memory; the etags of the items
+   of each stored page are recorded too. When the 'resume_stoken' is set, the listing
+   continues from it. */
 gboolean
 e_etesync_connection_list_existing_sync (EEteSyncConnection *connection,
 					 EBackend *backend,
 					 const EteSyncType type,
 					 const EtebaseCollection *col_obj,
+					 const gchar *resume_stoken,
+					 EEteSyncListPageFunc page_func,
+					 gpointer page_func_user_data,
 					 gchar **out_new_sync_tag,
 					 GSList **out_existing_objects,
 					 GCancellable *cancellable,
 					 GError **error)
 {
-	EtebaseItemManager *item_mgr;
-	gchar *stoken = NULL;
+	EtebaseItem **items_data;
+	gpointer *infos;
+	CollectionData *data;
+	FetchPipeline *pipeline;
+	ECache *cache;
+	gchar *stoken;
 	gboolean done = FALSE;
 	gboolean success = TRUE;
 	gboolean is_memo;
 
-	*out_existing_objects = NULL;
-	*out_new_sync_tag = NULL;
+	*out_existing_objects = NULL;
+	*out_new_sync_tag = NULL;
+
+	if (g_cancellable_set_error_if_cancelled (cancellable, error))
+		return FALSE;
+
+	if (!col_obj) {
+		return FALSE;
+	}
+
+	stoken = g_strdup (resume_stoken);
+
+	is_memo = e_etesync_connection_backend_is_for_memos (backend);
+	data = e_etesync_connection_ref_collection_data (connection, col_obj);
+
+	if (!data) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_CONNECTED, _("Not connected"));
+		g_free (stoken);
+		return FALSE;
+	}
+
+	cache = e_etesync_connection_ref_backend_cache (backend);
+	pipeline = e_etesync_connection_fetch_pipeline_new (data, stoken);
+	items_data = g_alloca (sizeof (EtebaseItem *) * E_ETESYNC_ITEM_FETCH_LIMIT);
+	infos = g_alloca (sizeof (gpointer) * E_ETESYNC_ITEM_FETCH_LIMIT);
+
+	while (!done) {
+		FetchPage *page;
+
+		if (g_cancellable_set_error_if_cancelled (cancellable, error)) {
+			success = FALSE;
+			break;
+		}
+
+		page = e_etesync_connection_fetch_pipeline_pop (pipeline);
+
+		if (page) {
+			GSList *page_objects = NULL;
+			GSList *page_items = NULL; /* EEteSyncCacheItem * */
+			guintptr items_data_len, item_iter, n_items = 0;
+
+			items_data_len = page->items_data_len;
+			etebase_item_list_response_get_data (page->item_list, (const EtebaseItem **) items_data);
+
+			/* Deleted items are not part of the existing objects */
+			for (item_iter = 0; item_iter < items_data_len; item_iter++) {
+				if (!etebase_item_is_deleted (items_data[item_iter]))
+					items_data[n_items++] = items_data[item_iter];
+			}
+
+			success = e_etesync_connection_items_to_infos_sync ((const EtebaseItem **) items_data, n_items, pipeline->data->item_mgr,
+				cache, type, is_memo, infos, cancellable, error);
+
+			/* Keep the server order; stop at the first item, which failed to be read */
+			for (item_iter = 0; success && item_iter < n_items && infos[item_iter]; item_iter++) {
+				gchar *etag;
+
+				page_objects = g_slist_prepend (page_objects, infos[item_iter]);
+
+				etag = etebase_item_get_etag (items_data[item_iter]);
+
+				if (etag) {
+					page_items = g_slist_prepend (page_items, e_etesync_cache_item_new (etebase_item_get_uid (items_data[item_iter]),
+						e_etesync_connection_info_get_uid (type, infos[item_iter]), etag));
+				}
+
+				g_free (etag);
+			}
+
+			for (; item_iter < n_items; item_iter++)
+				e_etesync_connection_info_free (type, infos[item_iter]);
+
+			if (success && page_func) {
+				success = page_func (g_slist_reverse (page_objects), page->stoken, page_func_user_data, cancellable, error);
+
+				/* the page is stored now, thus the next get_changes can skip these items */
+				if (success) {
+					GError *local_error = NULL;
+
+					if (!e_etesync_cache_store_items_sync (cache, page_items, cancellable, &local_error)) {
+						g_warning ("%s: Failed to store item states: %s", G_STRFUNC, local_error ? local_error->message : "Unknown error");
+						g_clear_error (&local_error);
+					}
+				}
+			} else if (success) {
+				/* prepended in reverse order, the whole list is reversed at the end */
+				*out_existing_objects = g_slist_concat (page_objects, *out_existing_objects);
+			}
+
+			g_slist_free_full (page_items, e_etesync_cache_item_free);
+			g_free (stoken);
+			stoken = g_strdup (page->stoken);
+			done = page->done;
+
+			fetch_page_free (page);
+
+			if (!success)
+				break;
+		} else {
+			success = e_etesync_connection_fetch_pipeline_restart_sync (connection, backend, col_obj, &pipeline, cancellable, error);
+
+			if (!success)
+				break;
+		}
+	}
+
+	e_etesync_connection_fetch_pipeline_free (pipeline);
+	g_clear_object (&cache);
+	*out_existing_objects = g_slist_reverse (*out_existing_objects);
+	*out_new_sync_tag = stoken;
+
+	return success;
+}
+
+/* The item states of the changes returned by get_changes; they are stored
+   into the cache only after the meta backend saved the changes, which is
+   recognized by the next call continuing from the 'stoken' */
+typedef struct _PendingItems {
+	gchar *stoken;
+	GSList *items; /* EEteSyncCacheItem * */
+} PendingItems;
+
+static void
+pending_items_free (gpointer ptr)
+{
+	PendingItems *pending = ptr;
+
+	if (pending) {
+		g_free (pending->stoken);
+		g_slist_free_full (pending->items, e_etesync_cache_item_free);
+		g_slice_free (PendingItems, pending);
+	}
+}
+
+/* Removes the value for the 'col_uid' from the 'pending' table and returns it */
+static gpointer
+e_etesync_connection_take_pending (EEteSyncConnection *connection,
+				   GHashTable *pending,
+				   const gchar *col_uid)
+{
+	gpointer key = NULL, value = NULL;
+
+	g_rec_mutex_lock (&connection->priv->connection_lock);
+
+	if (g_hash_table_lookup_extended (pending, col_uid, &key, &value)) {
+		g_hash_table_steal (pending, col_uid);
+		g_free (key);
+	}
+
+	g_rec_mutex_unlock (&connection->priv->connection_lock);
+
+	return value;
+}
+
+static void
+e_etesync_connection_store_pending_items_sync (EEteSyncConnection *connection,
+					       const gchar *col_uid,
+					       const gchar *last_sync_tag,
+					       ECache *cache,
+					       GCancellable *cancellable)
+{
+	PendingItems *pending;
+
+	pending = e_etesync_connection_take_pending (connection, connection->priv->pending_items, col_uid);
+
+	/* Nothing to trust, when starting from scratch */
+	if (!last_sync_tag) {
+		e_etesync_cache_remove_all_items_sync (cache, cancellable, NULL);
+	} else if (pending && g_strcmp0 (pending->stoken, last_sync_tag) == 0) {
+		GError *local_error = NULL;
+
+		if (!e_etesync_cache_store_items_sync (cache, pending->items, cancellable, &local_error)) {
+			g_warning ("%s: Failed to store item states: %s", G_STRFUNC, local_error ? local_error->message : "Unknown error");
+			g_clear_error (&local_error);
+		}
+	}
+
+	pending_items_free (pending);
+}
+
+/* Refreshes the known stokens of the collections of the account, with one request
+   for the collections changed since the previous check. It's done at most once
+   per E_ETESYNC_COLLECTION_CHECK_INTERVAL, thus the backends refreshing at about
+   the same time share it, instead of each listing its items. */
+static gboolean
+e_etesync_connection_check_collections_sync (EEteSyncConnection *connection)
+{
+	EtebaseCollectionManager *col_mgr;
+	EtebaseFetchOptions *fetch_options;
+	gchar *stoken;
+	gboolean success = TRUE, done = FALSE;
+	gint64 now;
+
+	/* the other threads wait for the result of the running check */
+	g_mutex_lock (&connection->priv->collections_check_lock);
+
+	now = g_get_monotonic_time ();
+
+	g_rec_mutex_lock (&connection->priv->connection_lock);
+
+	if (connection->priv->collections_checked &&
+	    now - connection->priv->collections_checked < E_ETESYNC_COLLECTION_CHECK_INTERVAL * G_TIME_SPAN_SECOND) {
+		g_rec_mutex_unlock (&connection->priv->connection_lock);
+		g_mutex_unlock (&connection->priv->collections_check_lock);
+		return TRUE;
+	}
+
+	stoken = g_strdup (connection->priv->collections_stoken);
+
+	g_rec_mutex_unlock (&connection->priv->connection_lock);
+
+	col_mgr = e_etesync_connection_dup_collection_manager (connection, NULL);
+
+	if (!col_mgr) {
+		g_mutex_unlock (&connection->priv->collections_check_lock);
+		g_free (stoken);
+		return FALSE;
+	}
+
+	fetch_options = etebase_fetch_options_new ();
+	etebase_fetch_options_set_prefetch (fetch_options, ETEBASE_PREFETCH_OPTION_MEDIUM);
+	etebase_fetch_options_set_limit (fetch_options, E_ETESYNC_COLLECTION_FETCH_LIMIT);
+
+	while (!done && success) {
+		EtebaseCollectionListResponse *col_list;
+		const EtebaseCollection **col_objs;
+		guintptr col_objs_len, col_iter;
+
+		etebase_fetch_options_set_stoken (fetch_options, stoken);
+
+		col_list = e_etesync_connection_collection_list_sync (connection, col_mgr, fetch_options);
+
+		if (!col_list) {
+			success = FALSE;
+			break;
+		}
+
+		col_objs_len = etebase_collection_list_response_get_data_length (col_list);
+		col_objs = g_new0 (const EtebaseCollection *, col_objs_len + 1);
+		etebase_collection_list_response_get_data (col_list, col_objs);
+
+		g_rec_mutex_lock (&connection->priv->connection_lock);
+
+		for (col_iter = 0; col_iter < col_objs_len; col_iter++) {
+			const EtebaseCollection *col_obj = col_objs[col_iter];
+
+			if (etebase_collection_is_deleted (col_obj)) {
+				g_hash_table_remove (connection->priv->collection_stokens, etebase_collection_get_uid (col_obj));
+			} else {
+				g_hash_table_insert (connection->priv->collection_stokens,
+					g_strdup (etebase_collection_get_uid (col_obj)),
+					g_strdup (etebase_collection_get_stoken (col_obj)));
+			}
+		}
+
+		g_rec_mutex_unlock (&connection->priv->connection_lock);
+
+		g_free (stoken);
+		stoken = g_strdup (etebase_collection_list_response_get_stoken (col_list));
+		done = etebase_collection_list_response_is_done (col_list);
+
+		g_free (col_objs);
+		etebase_collection_list_response_destroy (col_list);
+	}
+
+	if (success) {
+		g_rec_mutex_lock (&connection->priv->connection_lock);
+		g_free (connection->priv->collections_stoken);
+		connection->priv->collections_stoken = stoken;
+		connection->priv->collections_checked = now;
+		g_rec_mutex_unlock (&connection->priv->connection_lock);
+		stoken = NULL;
+	}
+
+	etebase_fetch_options_destroy (fetch_options);
+	etebase_collection_manager_destroy (col_mgr);
+	g_free (stoken);
+
+	g_mutex_unlock (&connection->priv->collections_check_lock);
+
+	return success;
+}
+
+/* Returns the current stoken of the collection 'col_obj', as known by the connection,
+   or NULL, when not known. The backend can receive a newer 'col_obj' from the registry,
+   which checks the collections on its own, then the stoken is not known until the next
+   check, unless they match. */
+static gchar *
+e_etesync_connection_dup_collection_stoken_sync (EEteSyncConnection *connection,
+						 const EtebaseCollection *col_obj)
+{
+	const gchar *col_uid, *col_obj_stoken, *known_stoken;
+	gchar *stoken = NULL;
+	gboolean checked;
+
+	col_uid = etebase_collection_get_uid (col_obj);
+	col_obj_stoken = etebase_collection_get_stoken (col_obj);
+	checked = e_etesync_connection_check_collections_sync (connection);
+
+	g_rec_mutex_lock (&connection->priv->connection_lock);
+
+	if (checked) {
+		known_stoken = g_hash_table_lookup (connection->priv->collection_stokens, col_uid);
+
+		if (g_strcmp0 (g_hash_table_lookup (connection->priv->col_obj_stokens, col_uid), col_obj_stoken) == 0 ||
+		    g_strcmp0 (known_stoken, col_obj_stoken) == 0)
+			stoken = g_strdup (known_stoken);
+	}
+
+	if (col_obj_stoken)
+		g_hash_table_insert (connection->priv->col_obj_stokens, g_strdup (col_uid), g_strdup (col_obj_stoken));
+
+	g_rec_mutex_unlock (&connection->priv->connection_lock);
+
+	return stoken;
+}
+
+/* Returns changes from one page of items since the 'last_sync_tag'. The 'out_repeat'
+   is set to TRUE when there are more pages to be fetched, starting from the 'out_new_sync_tag'.
+   The fetching of the next page is not stopped, it's used in the following call. */
+gboolean
+e_etesync_connection_get_changes_sync (EEteSyncConnection *connection,
+				       EBackend *backend,
+				       const EteSyncType type,
+				       const gchar *last_sync_tag,
+				       const EtebaseCollection *col_obj,
+				       ECache *cache,
+				       gchar **out_new_sync_tag,
+				       gboolean *out_repeat,
+				       GSList **out_created_objects, /* EBookMetaBackendInfo* or ECalMetaBackendInfo* */
+				       GSList **out_modified_objects, /* EBookMetaBackendInfo* or ECalMetaBackendInfo* */
+				       GSList **out_removed_objects, /* EBookMetaBackendInfo* or ECalMetaBackendInfo* */
+				       GCancellable *cancellable,
+				       GError **error)
+{
+	EtebaseItem **items_data;
+	gpointer *infos;
+	FetchPipeline *pipeline;
+	FetchPage *page = NULL;
+	gchar *col_uid;
+	gboolean success = TRUE;
+	gboolean is_memo;
+
+	*out_repeat = FALSE;
+
+	if (g_cancellable_set_error_if_cancelled (cancellable, error))
+		return FALSE;
+
+	if (!col_obj) {
+		return FALSE;
+	}
+
+	is_memo = e_etesync_connection_backend_is_for_memos (backend);
+	col_uid = g_strdup (etebase_collection_get_uid (col_obj));
+
+	e_etesync_connection_store_pending_items_sync (connection, col_uid, last_sync_tag, cache, cancellable);
+
+	/* Reuse the fetching of the previous call, when it continues from where that one stopped */
+	pipeline = e_etesync_connection_take_pending (connection, connection->priv->pending_fetches, col_uid);
+
+	if (pipeline && g_strcmp0 (pipeline->next_stoken, last_sync_tag) != 0)
+		g_clear_pointer (&pipeline, e_etesync_connection_fetch_pipeline_free);
+
+	if (!pipeline) {
+		CollectionData *data;
+		gchar *collection_stoken, *checked_stoken;
+
+		collection_stoken = e_etesync_connection_dup_collection_stoken_sync (connection, col_obj);
+		checked_stoken = e_cache_dup_key (cache, E_ETESYNC_CACHE_KEY_COLLECTION_STOKEN, NULL);
+
+		/* Nothing changed in the collection since the last listing, thus skip it */
+		if (last_sync_tag && collection_stoken &&
+		    (g_strcmp0 (collection_stoken, last_sync_tag) == 0 ||
+		     g_strcmp0 (collection_stoken, checked_stoken) == 0)) {
+			*out_new_sync_tag = g_strdup (last_sync_tag);
+			g_free (collection_stoken);
+			g_free (checked_stoken);
+			g_free (col_uid);
+			return TRUE;
+		}
+
+		g_free (checked_stoken);
+
+		data = e_etesync_connection_ref_collection_data (connection, col_obj);
+
+		if (!data) {
+			g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_CONNECTED, _("Not connected"));
+			g_free (collection_stoken);
+			g_free (col_uid);
+			return FALSE;
+		}
+
+		pipeline = e_etesync_connection_fetch_pipeline_new (data, last_sync_tag);
+		pipeline->collection_stoken = collection_stoken;
+	}
+
+	while (!page && success) {
+		if (g_cancellable_set_error_if_cancelled (cancellable, error)) {
+			success = FALSE;
+			break;
+		}
+
+		page = e_etesync_connection_fetch_pipeline_pop (pipeline);
+
+		if (!page)
+			success = e_etesync_connection_fetch_pipeline_restart_sync (connection, backend, col_obj, &pipeline, cancellable, error);
+	}
+
+	if (page) {
+		PendingItems *pending;
+		GHashTable *stored_etags = NULL, *queued = NULL, *contained = NULL;
+		GSList *echoed_deletes = NULL; /* EEteSyncCacheItem * */
+		const gchar **item_uids, **data_uids;
+		gchar **etags;
+		guintptr items_data_len, item_iter, n_items = 0, n_infos = 0;
+
+		items_data = g_alloca (sizeof (EtebaseItem *) * E_ETESYNC_ITEM_FETCH_LIMIT);
+		infos = g_alloca (sizeof (gpointer) * E_ETESYNC_ITEM_FETCH_LIMIT);
+		item_uids = g_alloca (sizeof (gchar *) * E_ETESYNC_ITEM_FETCH_LIMIT);
+		data_uids = g_alloca (sizeof (gchar *) * E_ETESYNC_ITEM_FETCH_LIMIT);
+		etags = g_alloca (sizeof (gchar *) * E_ETESYNC_ITEM_FETCH_LIMIT);
+
+		items_data_len = page->items_data_len;
+		etebase_item_list_response_get_data (page->item_list, (const EtebaseItem **) items_data);
+
+		for (item_iter = 0; item_iter < items_data_len; item_iter++)
+			item_uids[item_iter] = etebase_item_get_uid (items_data[item_iter]);
+
+		if (!e_etesync_cache_get_item_etags_sync (cache, item_uids, items_data_len, &stored_etags, cancellable, NULL))
+			g_hash_table_remove_all (stored_etags);
+
+		if (!e_etesync_cache_get_queued_item_uids_sync (cache, item_uids, items_data_len, &queued, cancellable, NULL))
+			g_hash_table_remove_all (queued);
+
+		/* Skip the items, which did not change since they had been stored or uploaded by us;
+		   the deletions uploaded by us are recorded only until they are seen here. The items
+		   with a local change, which was not uploaded yet, are skipped too, to not overwrite it;
+		   the local changes, which failed to be uploaded, are replaced by the server version. */
+		for (item_iter = 0; item_iter < items_data_len; item_iter++) {
+			const EtebaseItem *item = items_data[item_iter];
+			gchar *etag;
+
+			if (g_hash_table_contains (queued, item_uids[item_iter]))
+				continue;
+
+			etag = etebase_item_get_etag (item);
+
+			if (etag && g_strcmp0 (g_hash_table_lookup (stored_etags, item_uids[item_iter]), etag) == 0) {
+				if (etebase_item_is_deleted (item))
+					echoed_deletes = g_slist_prepend (echoed_deletes, e_etesync_cache_item_new (item_uids[item_iter], NULL, NULL));
+				g_free (etag);
+				continue;
+			}
+
+			items_data[n_items] = items_data[item_iter];
+			item_uids[n_items] = item_uids[item_iter];
+			etags[n_items] = etag;
+			n_items++;
+		}
+
+		g_hash_table_destroy (stored_etags);
+		g_hash_table_destroy (queued);
+
+		/* Before the data is stored, which is skipped for the queued items */
+		e_etesync_cache_unqueue_failed_items_sync (cache, item_uids, n_items, cancellable, NULL);
+
+		success = e_etesync_connection_items_to_infos_sync ((const EtebaseItem **) items_data, n_items, pipeline->data->item_mgr,
+			cache, type, is_memo, infos, cancellable, error);
+
+		if (success) {
+			/* Stop at the first item, which failed to be read */
+			for (n_infos = 0; n_infos < n_items && infos[n_infos]; n_infos++)
+				data_uids[n_infos] = e_etesync_connection_info_get_uid (type, infos[n_infos]);
+
+			success = e_etesync_cache_get_contained_uids_sync (cache, data_uids, n_infos, &contained, cancellable, error);
+		}
+
+		if (success) {
+			pending = g_slice_new0 (PendingItems);
+			pending->stoken = g_strdup (page->stoken);
+			pending->items = echoed_deletes;
+			echoed_deletes = NULL;
+
+			/* Keep the server order */
+			for (item_iter = 0; item_iter < n_infos; item_iter++) {
+				gpointer nfo = infos[item_iter];
+				gboolean is_deleted;
+
+				is_deleted = etebase_item_is_deleted (items_data[item_iter]);
+
+				pending->items = g_slist_prepend (pending->items, e_etesync_cache_item_new (item_uids[item_iter],
+					data_uids[item_iter], is_deleted ? NULL : etags[item_iter]));
+
+				/* data with uid exist, then it is modified or deleted, else it is new data */
+				if (g_hash_table_contains (contained, data_uids[item_iter])) {
+					if (is_deleted)
+						*out_removed_objects = g_slist_prepend (*out_removed_objects, nfo);
+					else
+						*out_modified_objects = g_slist_prepend (*out_modified_objects, nfo);
+				} else {
+					if (!is_deleted)
+						*out_created_objects = g_slist_prepend (*out_created_objects, nfo);
+					else
+						e_etesync_connection_info_free (type, nfo);
+				}
+			}
+
+			g_rec_mutex_lock (&connection->priv->connection_lock);
+			g_hash_table_insert (connection->priv->pending_items, g_strdup (col_uid), pending);
+			g_rec_mutex_unlock (&connection->priv->connection_lock);
+
+			*out_new_sync_tag = g_strdup (page->stoken);
+			*out_repeat = !page->done;
+
+			/* The listing contains all the changes up to the collection stoken known
+			   before it started, thus it's enough to compare with it next time */
+			if (page->done)
+				e_cache_set_key (cache, E_ETESYNC_CACHE_KEY_COLLECTION_STOKEN, pipeline->collection_stoken, NULL);
+		} else {
+			/* the page is fetched again by the next call */
+			item_iter = 0;
+		}
+
+		for (; item_iter < n_items; item_iter++)
+			e_etesync_connection_info_free (type, infos[item_iter]);
+
+		for (item_iter = 0; item_iter < n_items; item_iter++)
+			g_free (etags[item_iter]);
+
+		if (contained)
+			g_hash_table_destroy (contained);
+
+		g_slist_free_full (echoed_deletes, e_etesync_cache_item_free);
+		fetch_page_free (page);
+	}
+
+	if (success && *out_repeat) {
+		g_rec_mutex_lock (&connection->priv->connection_lock);
+		g_hash_table_insert (connection->priv->pending_fetches, col_uid, pipeline);
+		g_rec_mutex_unlock (&connection->priv->connection_lock);
+	} else {
+		e_etesync_connection_fetch_pipeline_free (pipeline);
+		g_free (col_uid);
+	}
+
+	return success;
+}
+
+/* Returns the UID of the EteSync item holding the object 'uid', or NULL, when not known */
+static gchar *
+e_etesync_connection_dup_item_uid (CollectionData *data,
+				   ECache *cache,
+				   gboolean is_memo,
+				   const gchar *uid,
+				   const gchar *extra)
+{
+	gchar *item_uid = NULL;
+
+	/* notes have the item UID as their UID */
+	if (is_memo)
+		return g_strdup (uid);
+
+	if (extra) {
+		item_uid = e_etesync_connection_item_extra_dup_item_uid (extra);
+
+		if (!item_uid) {
+			EtebaseItem *item;
+
+			/* stored by an older version */
+			item = e_etesync_utils_etebase_item_from_base64 (extra, data->item_mgr);
+
+			if (item) {
+				item_uid = g_strdup (etebase_item_get_uid (item));
+				etebase_item_destroy (item);
+			}
+		}
+	}
+
+	if (!item_uid && cache)
+		e_etesync_cache_dup_item_uid_sync (cache, uid, &item_uid, NULL, NULL);
+
+	return item_uid;
+}
+
+/* Fetches only the item holding the object 'uid' from the server and sets 'out_info'
+   to a new EBookMetaBackendInfo * or ECalMetaBackendInfo * for it, depending on the 'type'.
+   Fails with G_IO_ERROR_NOT_FOUND, when the item is not known or it had been deleted. */
+gboolean
+e_etesync_connection_item_fetch_sync (EEteSyncConnection *connection,
+				      EBackend *backend,
+				      const EteSyncType type,
+				      const EtebaseCollection *col_obj,
+				      const gchar *uid,
+				      const gchar *extra,
+				      gpointer *out_info,
+				      GCancellable *cancellable,
+				      GError **error)
+{
+	CollectionData *data;
+	ECache *cache;
+	EtebaseItem *item;
+	gchar *item_uid;
+	gboolean is_memo;
+	gboolean success = FALSE;
+
+	g_return_val_if_fail (connection != NULL, FALSE);
+	g_return_val_if_fail (col_obj != NULL, FALSE);
+	g_return_val_if_fail (uid != NULL, FALSE);
+	g_return_val_if_fail (out_info != NULL, FALSE);
+
+	*out_info = NULL;
+
+	if (g_cancellable_set_error_if_cancelled (cancellable, error))
+		return FALSE;
+
+	data = e_etesync_connection_ref_collection_data (connection, col_obj);
+
+	if (!data) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_CONNECTED, _("Not connected"));
+		return FALSE;
+	}
+
+	is_memo = e_etesync_connection_backend_is_for_memos (backend);
+	cache = e_etesync_connection_ref_backend_cache (backend);
+	item_uid = e_etesync_connection_dup_item_uid (data, cache, is_memo, uid, extra);
+
+	if (!item_uid) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, _("Item not found"));
+		collection_data_unref (data);
+		g_clear_object (&cache);
+		return FALSE;
+	}
+
+	item = e_etesync_connection_item_fetch_request_sync (data, item_uid);
+
+	if (!item) {
+		EtebaseErrorCode etebase_error = etebase_error_get_code ();
+		GError *local_error = NULL;
+
+		/* This is used to check if the error was due to expired token, if so try to get a new token, then try again */
+		if (etebase_error == ETEBASE_ERROR_CODE_UNAUTHORIZED &&
+		    e_etesync_connection_maybe_reconnect_sync (connection, backend, data->session_generation, cancellable, &local_error)) {
+			collection_data_unref (data);
+			data = e_etesync_connection_ref_collection_data (connection, col_obj);
+
+			if (data) {
+				item = e_etesync_connection_item_fetch_request_sync (data, item_uid);
+
+				if (!item)
+					etebase_error = etebase_error_get_code ();
+			} else {
+				g_set_error_literal (&local_error, G_IO_ERROR, G_IO_ERROR_NOT_CONNECTED, _("Not connected"));
+			}
+		}
+
+		/* always fail with an error, the callers fall back to the refresh on the NOT_FOUND */
+		if (item) {
+			g_clear_error (&local_error);
+		} else if (local_error) {
+			g_propagate_error (error, local_error);
+		} else if (etebase_error == ETEBASE_ERROR_CODE_NOT_FOUND) {
+			g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, _("Item not found"));
+		} else {
+			const gchar *message = etebase_error_get_message ();
+
+			g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED, message && *message ? message : _("Failed to fetch item"));
+		}
+	}
+
+	if (item && etebase_item_is_deleted (item)) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, _("Item not found"));
+	} else if (item) {
+		const EtebaseItem *items[1] = { item };
+
+		success = e_etesync_connection_items_to_infos_sync (items, 1, data->item_mgr, cache, type, is_memo, out_info, cancellable, error);
+
+		if (success && !*out_info) {
+			g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, _("Failed to read item"));
+			success = FALSE;
+		}
+	}
+
+	if (item)
+		etebase_item_destroy (item);
+
+	collection_data_unref (data);
+	g_clear_object (&cache);
+	g_free (item_uid);
+
+	return success;
+}
+
+/* ------------------------ Uploading item functions -----------------------*/
+
+/* Uploads the 'items' in one request, retrying with a new token when the current
+   one had expired; the 'inout_data' is replaced by the new collection data in such case.
+   The 'out_etebase_error' is set to the error code of the failed upload. */
+static gboolean
+e_etesync_connection_items_request_sync (EEteSyncConnection *connection,
+					 EBackend *backend,
+					 const EtebaseCollection *col_obj,
+					 CollectionData **inout_data,
+					 EtebaseItem **items,
+					 guint n_items,
+					 EtebaseErrorCode *out_etebase_error,
+					 GCancellable *cancellable,
+					 GError **error)
+{
+	gboolean success;
+
+	if (out_etebase_error)
+		*out_etebase_error = ETEBASE_ERROR_CODE_NO_ERROR;
+
+	success = e_etesync_connection_items_batch_request_sync (*inout_data, items, n_items);
+
+	if (!success) {
+		EtebaseErrorCode etebase_error = etebase_error_get_code ();
+		gchar *message = g_strdup (etebase_error_get_message ());
+
+		/* This is used to check if the error was due to expired token, if so try to get a new token, then try again */
+		if (etebase_error == ETEBASE_ERROR_CODE_UNAUTHORIZED &&
+		    e_etesync_connection_maybe_reconnect_sync (connection, backend, (*inout_data)->session_generation, cancellable, error)) {
+			CollectionData *data;
+
+			/* the item manager of the previous collection manager is gone with the reconnect */
+			data = e_etesync_connection_ref_collection_data (connection, col_obj);
+
+			if (data) {
+				collection_data_unref (*inout_data);
+				*inout_data = data;
+
+				success = e_etesync_connection_items_batch_request_sync (data, items, n_items);
+
+				if (!success) {
+					etebase_error = etebase_error_get_code ();
+					g_free (message);
+					message = g_strdup (etebase_error_get_message ());
+				}
+			}
+		}
+
+		if (!success) {
+			e_etesync_utils_set_io_gerror (etebase_error, message, error);
+
+			if (out_etebase_error)
+				*out_etebase_error = etebase_error;
+		}
+
+		g_free (message);
+	}
+
+	return success;
+}
+
+/* Sets the error of the 'item_errors', which have none yet, to a copy of the 'error' */
+static void
+e_etesync_connection_set_item_errors (GError **item_errors,
+				      guint n_items,
+				      const GError *error)
+{
+	guint ii;
+
+	for (ii = 0; ii < n_items; ii++) {
+		if (item_errors[ii])
+			continue;
+
+		if (error)
+			item_errors[ii] = g_error_copy (error);
+		else
+			item_errors[ii] = g_error_new_literal (G_IO_ERROR, G_IO_ERROR_FAILED, _("Failed to upload item"));
+	}
+}
+
+/* Whether the server refused the request for its size. libetebase has no error code for
+   the 413 Payload Too Large status, it reports it as ETEBASE_ERROR_CODE_HTTP with the message
+   "HTTP error <status>! ..."; this is the only rule used, the status is read from there. */
+static gboolean
+e_etesync_connection_is_too_large_error (EtebaseErrorCode etebase_error,
+					 const GError *error)
+{
+	const gchar *prefix = "HTTP error ";
+
+	if (etebase_error != ETEBASE_ERROR_CODE_HTTP || !error || !error->message ||
+	    !g_str_has_prefix (error->message, prefix))
+		return FALSE;
+
+	return g_ascii_strtoull (error->message + strlen (prefix), NULL, 10) == 413;
+}
+
+/* Uploads the 'items' in one request; when the server refuses it as too large,
+   it is split into halves, which are tried again. With the 'item_errors', also
+   the requests with a conflicting item are split, until the failing items are
+   found; their errors are set there and the rest is uploaded. Any other error
+   fails the whole request. The FALSE is returned only on errors, which are not
+   caused by the items, then the 'item_errors' are set for all the items, which
+   were not uploaded. */
+static gboolean
+e_etesync_connection_items_split_sync (EEteSyncConnection *connection,
+				       EBackend *backend,
+				       const EtebaseCollection *col_obj,
+				       CollectionData **inout_data,
+				       EtebaseItem **items,
+				       guint n_items,
+				       GError **item_errors,
+				       EtebaseErrorCode *out_etebase_error,
+				       GCancellable *cancellable,
+				       GError **error)
+{
+	EtebaseErrorCode etebase_error = ETEBASE_ERROR_CODE_NO_ERROR;
+	GError *local_error = NULL;
+	gboolean is_item_error;
+	guint half;
+
+	if (e_etesync_connection_items_request_sync (connection, backend, col_obj, inout_data, items, n_items, &etebase_error, cancellable, &local_error))
+		return TRUE;
+
+	is_item_error = e_etesync_connection_is_too_large_error (etebase_error, local_error) ||
+		(item_errors && etebase_error == ETEBASE_ERROR_CODE_CONFLICT);
+
+	if (is_item_error && n_items > 1) {
+		g_clear_error (&local_error);
+
+		half = n_items / 2;
+
+		if (!e_etesync_connection_items_split_sync (connection, backend, col_obj, inout_data, items, half, item_errors,
+			out_etebase_error, cancellable, &local_error)) {
+			if (item_errors)
+				e_etesync_connection_set_item_errors (item_errors + half, n_items - half, local_error);
+
+			g_propagate_error (error, local_error);
+
+			return FALSE;
+		}
+
+		return e_etesync_connection_items_split_sync (connection, backend, col_obj, inout_data, items + half, n_items - half,
+			item_errors ? item_errors + half : NULL, out_etebase_error, cancellable, error);
+	}
+
+	if (item_errors)
+		e_etesync_connection_set_item_errors (item_errors, n_items, local_error);
+
+	/* the single item is skipped, the others can be uploaded */
+	if (item_errors && is_item_error) {
+		g_clear_error (&local_error);
+		return TRUE;
+	}
+
+	if (out_etebase_error)
+		*out_etebase_error = etebase_error;
+
+	g_propagate_error (error, local_error);
+
+	return FALSE;
+}
+
+/* Uploads the 'items' in as few requests as the push limits of the 'backend' source allow,
+   counting the 'item_sizes', the size of each item serialized, as it is encrypted in the request,
+   or NULL to count the items only. The 'out_etebase_error' is set to the error code
+   of the failed upload. The requests done before the failed one are not reverted. When the
+   'item_errors' is set, it is an array of 'n_items', where the errors of the items, which
+   were not uploaded, are set, as described at e_etesync_connection_items_split_sync(). */
+static gboolean
+e_etesync_connection_items_batch_sync (EEteSyncConnection *connection,
+				       EBackend *backend,
+				       const EtebaseCollection *col_obj,
+				       CollectionData **inout_data,
+				       EtebaseItem **items,
+				       const gsize *item_sizes,
+				       guint n_items,
+				       GError **item_errors,
+				       EtebaseErrorCode *out_etebase_error,
+				       GCancellable *cancellable,
+				       GError **error)
+{
+	GError *local_error = NULL;
+	guint max_items, max_bytes;
+	guint ii, first = 0;
+	gsize batch_bytes = 0;
+	gboolean success = TRUE;
+
+	if (out_etebase_error)
+		*out_etebase_error = ETEBASE_ERROR_CODE_NO_ERROR;
+
+	e_etesync_utils_get_push_limits (e_backend_get_source (backend), &max_items, &max_bytes);
+
+	for (ii = 0; ii < n_items && success; ii++) {
+		gsize item_bytes = item_sizes ? item_sizes[ii] : 0;
+
+		if (ii > first && (ii - first >= max_items || batch_bytes + item_bytes > max_bytes)) {
+			success = e_etesync_connection_items_split_sync (connection, backend, col_obj, inout_data,
+				items + first, ii - first, item_errors ? item_errors + first : NULL,
+				out_etebase_error, cancellable, &local_error);
+
+			first = ii;
+			batch_bytes = 0;
+		}
+
+		batch_bytes += item_bytes;
+	}
+
+	if (success && first < n_items) {
+		success = e_etesync_connection_items_split_sync (connection, backend, col_obj, inout_data,
+			items + first, n_items - first, item_errors ? item_errors + first : NULL,
+			out_etebase_error, cancellable, &local_error);
+
+		first = n_items;
+	}
+
+	if (!success) {
+		/* the items from the 'first' on were not tried */
+		if (item_errors)
+			e_etesync_connection_set_item_errors (item_errors + first, n_items - first, local_error);
+
+		g_propagate_error (error, local_error);
+	}
+
+	return success;
+}
+
+/* Saves the uploaded 'items' into the 'cache' and returns their extras, or, when
+   they cannot be saved, the extras holding the whole items, as it used to be */
+static gchar **
+e_etesync_connection_dup_uploaded_extras (ECache *cache,
+					  EtebaseItemManager *item_mgr,
+					  EtebaseItem *const *items,
+					  guint n_items,
+					  GCancellable *cancellable)
+{
+	GError *local_error = NULL;
+	gchar **extras;
+	guint ii;
+
+	extras = g_new0 (gchar *, n_items + 1);
+
+	if (e_etesync_connection_save_items_sync (cache, item_mgr, (const EtebaseItem *const *) items, n_items, cancellable, &local_error)) {
+		for (ii = 0; ii < n_items; ii++)
+			extras[ii] = e_etesync_connection_item_extra_new (items[ii]);
+	} else {
+		g_warning ("%s: Failed to save items: %s", G_STRFUNC, local_error ? local_error->message : "Unknown error");
+		g_clear_error (&local_error);
+
+		for (ii = 0; ii < n_items; ii++)
+			extras[ii] = e_etesync_utils_etebase_item_to_base64 (items[ii], item_mgr);
+	}
+
+	return extras;
+}
+
+static void
+e_etesync_connection_info_take_extra (const EteSyncType type,
+				      gpointer nfo,
+				      gchar *extra)
+{
+	if (type == E_ETESYNC_ADDRESSBOOK) {
+		g_free (((EBookMetaBackendInfo *) nfo)->extra);
+		((EBookMetaBackendInfo *) nfo)->extra = extra;
+	} else {
+		g_free (((ECalMetaBackendInfo *) nfo)->extra);
+		((ECalMetaBackendInfo *) nfo)->extra = extra;
+	}
+}
+
+/* Applies the change to the item and stores it into the cache, to be uploaded
+   later by e_etesync_connection_queued_items_upload_sync(), together with other
+   changes; the 'conflict_resolution' is used, when the item had been changed on
+   the server meanwhile. The 'out_new_uid' and 'out_new_extra' are the final values,
+   because the item is created locally. */
+gboolean
+e_etesync_connection_item_queue_sync (EEteSyncConnection *connection,
+				      EBackend *backend,
+				      const EtebaseCollection *col_obj,
+				      const EteSyncAction action,
+				      const gchar *content,
+				      const gchar *uid,
+				      const gchar *extra, /* item_cache_b64 */
+				      EConflictResolution conflict_resolution,
+				      gchar **out_new_uid,
+				      gchar **out_new_extra,
+				      GCancellable *cancellable,
+				      GError **error)
+{
+	CollectionData *data;
+	ECache *cache;
+	gboolean success = TRUE;
+	gboolean is_memo;
+	const gchar *item_cache_b64 = extra;
+
+	g_return_val_if_fail (connection != NULL, FALSE);
+	g_return_val_if_fail (col_obj != NULL, FALSE);
+
+	if (g_cancellable_set_error_if_cancelled (cancellable, error))
+		return FALSE;
+
+	e_etesync_connection_lock_collection (connection, col_obj);
+
+	is_memo = e_etesync_connection_backend_is_for_memos (backend);
+	cache = e_etesync_connection_ref_backend_cache (backend);
+	data = e_etesync_connection_ref_collection_data (connection, col_obj);
+
+	if (data) {
+		EtebaseItemMetadata *item_metadata = NULL;
+		EtebaseItem *item;
+		time_t now;
+		gchar *item_name, *item_content; /* Added to support EteSync notes type */
+
+		e_etesync_utils_get_time_now (&now);
+
+		/* If it is etesync note item, then set the EteSyncitem metadata name (uid) to summary in VJOURNAL
+		   and set the EteSyncItem content to the description in VJOURNAL */
+		if (action != E_ETESYNC_ITEM_ACTION_DELETE && is_memo) {
+			ICalComponent *icomp = i_cal_component_new_from_string (content);
+
+			item_name = g_strdup (i_cal_component_get_summary (icomp)); /* set data_uid to summary */
+			item_content = g_strdup (i_cal_component_get_description (icomp)); /* set content to description */
+
+			g_object_unref (icomp);
+		} else {
+			item_name = g_strdup (uid);
+			item_content = g_strdup (content);
+		}
+
+		if (action == E_ETESYNC_ITEM_ACTION_CREATE) {
+			item_metadata = etebase_item_metadata_new ();
+
+			etebase_item_metadata_set_name (item_metadata, item_name);
+			etebase_item_metadata_set_mtime (item_metadata, &now);
+
+			item = etebase_item_manager_create (data->item_mgr, item_metadata, item_content ? item_content : "" , item_content ? strlen (item_content) : 0);
+		} else {
+			item = collection_data_dup_item (data, cache, uid, item_cache_b64);
+			if (!item) {
+				success = FALSE;
+				g_clear_error (error);
+				g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED, _("Item not found"));
+			} else {
+				item_metadata = etebase_item_get_meta (item);
+
+				etebase_item_metadata_set_name (item_metadata, item_name);
+				etebase_item_metadata_set_mtime (item_metadata, &now);
+				etebase_item_set_meta(item, item_metadata);
+
+				if (action == E_ETESYNC_ITEM_ACTION_MODIFY)
+					etebase_item_set_content (item, item_content ? item_content : "" , item_content ? strlen (item_content) : 0);
+				else if (action == E_ETESYNC_ITEM_ACTION_DELETE)
+					etebase_item_delete (item);
+			}
+		}
+
+		/* This could fail when trying to fetch an item and it wasn't found in modify/delete */
+		if (success) {
+			GBytes *item_cache;
+			const gchar *data_uid = uid;
+			gchar *new_extra = NULL;
+
+			/* notes use the item UID as their UID */
+			if (is_memo && action == E_ETESYNC_ITEM_ACTION_CREATE)
+				data_uid = etebase_item_get_uid (item);
+
+			item_cache = e_etesync_utils_etebase_item_to_bytes (item, data->item_mgr);
+
+			if (item_cache) {
+				success = e_etesync_cache_queue_item_sync (cache, etebase_item_get_uid (item), data_uid, item_cache,
+					conflict_resolution, cancellable, error);
+				g_bytes_unref (item_cache);
+			} else {
+				success = FALSE;
+				e_etesync_utils_set_io_gerror (etebase_error_get_code (), etebase_error_get_message (), error);
+			}
+
+			if (success)
+				new_extra = e_etesync_connection_item_extra_new (item);
+
+			if (out_new_extra)
+				*out_new_extra = g_strdup (new_extra);
+
+			/* Set the new uid for notes from the EteSyncitem uid, as EteSync notes item doesn't contain
+			   uid in its content as other etesync types (calendar, tasks, contacts) */
+			if (action == E_ETESYNC_ITEM_ACTION_CREATE &&
+			    out_new_uid &&
+			    is_memo)
+				*out_new_uid = g_strdup (etebase_item_get_uid (item));
+
+			if (item_metadata)
+				etebase_item_metadata_destroy (item_metadata);
+
+			/* Keep the item decoded for its next change */
+			if (success && action != E_ETESYNC_ITEM_ACTION_DELETE)
+				collection_data_put_item (data, data_uid, new_extra, item);
+			else
+				etebase_item_destroy (item);
+
+			g_free (new_extra);
+		}
+
+		g_free (item_name);
+		g_free (item_content);
+		collection_data_unref (data);
+	} else {
+		success = FALSE;
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_CONNECTED, _("Not connected"));
+	}
+
+	g_clear_object (&cache);
+
+	e_etesync_connection_unlock_collection (connection, col_obj);
+
+	return success;
+}
+
+/* Fetches the server version of the items, which conflicted with the local change,
+   and adds it into the 'out_modified_objects' or the 'out_removed_objects' */
+static gboolean
+e_etesync_connection_resolve_conflicts_sync (CollectionData *data,
+					     ECache *cache,
+					     const EteSyncType type,
+					     gboolean is_memo,
+					     GPtrArray *item_uids,
+					     GSList **out_modified_objects,
+					     GSList **out_removed_objects,
+					     GCancellable *cancellable,
+					     GError **error)
+{
+	gboolean success = TRUE;
+	guint ii;
+
+	for (ii = 0; ii < item_uids->len && success; ii++) {
+		const EtebaseItem *items[1];
+		gpointer nfo = NULL;
+
+		items[0] = e_etesync_connection_item_fetch_request_sync (data, g_ptr_array_index (item_uids, ii));
+
+		if (!items[0]) {
+			e_etesync_utils_set_io_gerror (etebase_error_get_code (), etebase_error_get_message (), error);
+			success = FALSE;
+			break;
+		}
+
+		success = e_etesync_connection_items_to_infos_sync (items, 1, data->item_mgr, cache, type, is_memo, &nfo, cancellable, error);
+
+		if (success && nfo) {
+			if (etebase_item_is_deleted (items[0]))
+				*out_removed_objects = g_slist_prepend (*out_removed_objects, nfo);
+			else
+				*out_modified_objects = g_slist_prepend (*out_modified_objects, nfo);
+		} else {
+			e_etesync_connection_info_free (type, nfo);
+		}
+
+		etebase_item_destroy ((EtebaseItem *) items[0]);
+	}
+
+	return success;
+}
+
+/* Applies the local change of the 'local' item onto the 'server' version of it,
+   thus it can be uploaded over the server version */
+static gboolean
+e_etesync_connection_item_rebase (EtebaseItem *server,
+				  const EtebaseItem *local)
+{
+	EtebaseItemMetadata *item_metadata;
+	const gchar *content;
+
+	if (etebase_item_is_deleted (local)) {
+		etebase_item_delete (server);
+		return TRUE;
+	}
+
+	content = e_etesync_connection_item_get_content (local);
+
+	if (!content) {
+		e_etesync_connection_item_release_content ();
+		return FALSE;
+	}
+
+	item_metadata = etebase_item_get_meta (local);
+	etebase_item_set_meta (server, item_metadata);
+	etebase_item_metadata_destroy (item_metadata);
+
+	etebase_item_set_content (server, content, strlen (content));
+
+	e_etesync_connection_item_release_content ();
+
+	return TRUE;
+}
+
+/* Keeps the queued 'item' in the queue, but marked as failed, thus it is not uploaded
+   again until it is changed, and tells the user about it */
+static void
+e_etesync_connection_queued_item_failed (EBackend *backend,
+					 ECache *cache,
+					 const EEteSyncCacheItem *item,
+					 const gchar *error_message,
+					 GCancellable *cancellable)
+{
+	gchar *message;
+
+	e_etesync_cache_set_queued_item_error_sync (cache, item->item_uid, error_message, cancellable, NULL);
+
+	message = g_strdup_printf (_("Failed to upload the change of “%s”: %s"), item->uid ? item->uid : item->item_uid, error_message);
+	e_backend_notify_error (backend, message);
+	g_free (message);
+}
+
+/* Uploads up to the push limit of the changes queued by e_etesync_connection_item_queue_sync()
+   in one batch and sets the 'out_done' to TRUE, when there is nothing more queued. When some of them
+   conflict with a change done on the server, the conflict resolution of the change is used: with
+   the E_CONFLICT_RESOLUTION_KEEP_SERVER the local change is dropped and the server version
+   is returned in the 'out_modified_objects' or the 'out_removed_objects' (EBookMetaBackendInfo*
+   or ECalMetaBackendInfo*), to be stored by the caller; with the E_CONFLICT_RESOLUTION_KEEP_LOCAL
+   the local change is uploaded over the server version. Any other conflict resolution, or an item
+   refused by the server, keeps the change in the queue, marked as failed, and the error is notified
+   on the 'backend'. The FALSE is returned only when the upload itself fails, then it can be retried. */
+gboolean
+e_etesync_connection_queued_items_upload_sync (EEteSyncConnection *connection,
+					       EBackend *backend,
+					       const EteSyncType type,
+					       const EtebaseCollection *col_obj,
+					       gboolean *out_done,
+					       GSList **out_modified_objects,
+					       GSList **out_removed_objects,
+					       GCancellable *cancellable,
+					       GError **error)
+{
+	CollectionData *data;
+	ECache *cache;
+	GSList *queued = NULL, *uploaded = NULL, *link;
+	GPtrArray *conflicted;
+	GHashTable *failed;
+	EtebaseItem **items;
+	gsize *item_sizes;
+	EEteSyncCacheItem **items_queued;
+	EtebaseErrorCode etebase_error = ETEBASE_ERROR_CODE_NO_ERROR;
+	GError *local_error = NULL;
+	guint ii, n_items = 0, max_items;
+	gboolean is_memo;
+	gboolean success;
+
+	g_return_val_if_fail (connection != NULL, FALSE);
+	g_return_val_if_fail (col_obj != NULL, FALSE);
+	g_return_val_if_fail (out_done != NULL, FALSE);
+
+	*out_done = FALSE;
+
+	if (g_cancellable_set_error_if_cancelled (cancellable, error))
+		return FALSE;
+
+	e_etesync_connection_lock_collection (connection, col_obj);
+
+	data = e_etesync_connection_ref_collection_data (connection, col_obj);
+
+	if (!data) {
+		e_etesync_connection_unlock_collection (connection, col_obj);
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_CONNECTED, _("Not connected"));
+		return FALSE;
+	}
+
+	is_memo = e_etesync_connection_backend_is_for_memos (backend);
+	cache = e_etesync_connection_ref_backend_cache (backend);
+	e_etesync_utils_get_push_limits (e_backend_get_source (backend), &max_items, NULL);
+	success = e_etesync_cache_dup_queued_items_sync (cache, max_items, &queued, cancellable, error);
+
+	if (!success || !queued) {
+		*out_done = success;
+		collection_data_unref (data);
+		g_clear_object (&cache);
+		e_etesync_connection_unlock_collection (connection, col_obj);
+		return success;
+	}
+
+	items = g_new0 (EtebaseItem *, g_slist_length (queued));
+	item_sizes = g_new0 (gsize, g_slist_length (queued));
+	items_queued = g_new0 (EEteSyncCacheItem *, g_slist_length (queued));
+	conflicted = g_ptr_array_new_with_free_func (g_free);
+	failed = g_hash_table_new (g_str_hash, g_str_equal);
+
+	for (link = queued; link; link = g_slist_next (link)) {
+		EEteSyncCacheItem *queued_item = link->data;
+		GBytes *item_cache = NULL;
+
+		/* the item can be gone, when it had been deleted on the server meanwhile */
+		if (e_etesync_cache_dup_item_data_sync (cache, queued_item->item_uid, &item_cache, cancellable, NULL) && item_cache) {
+			items[n_items] = e_etesync_utils_etebase_item_from_bytes (item_cache, data->item_mgr);
+
+			if (items[n_items]) {
+				item_sizes[n_items] = g_bytes_get_size (item_cache);
+				items_queued[n_items] = queued_item;
+				n_items++;
+			}
+
+			g_bytes_unref (item_cache);
+		}
+	}
+
+	if (n_items)
+		success = e_etesync_connection_items_batch_sync (connection, backend, col_obj, &data, items, item_sizes, n_items, NULL, &etebase_error, cancellable, &local_error);
+
+	/* The server refuses the whole batch, when any of the items conflicts or is too large,
+	   thus upload them one by one, to find out which are those */
+	if (!success && (etebase_error == ETEBASE_ERROR_CODE_CONFLICT ||
+	    e_etesync_connection_is_too_large_error (etebase_error, local_error))) {
+		success = TRUE;
+		g_clear_error (&local_error);
+
+		for (ii = 0; ii < n_items && success; ii++) {
+			EEteSyncCacheItem *queued_item = items_queued[ii];
+
+			success = e_etesync_connection_items_batch_sync (connection, backend, col_obj, &data, &items[ii], &item_sizes[ii], 1, NULL, &etebase_error, cancellable, &local_error);
+
+			/* upload the local change over the server version */
+			if (!success && etebase_error == ETEBASE_ERROR_CODE_CONFLICT &&
+			    queued_item->conflict_resolution == E_CONFLICT_RESOLUTION_KEEP_LOCAL) {
+				EtebaseItem *server_item;
+
+				g_clear_error (&local_error);
+
+				server_item = e_etesync_connection_item_fetch_request_sync (data, queued_item->item_uid);
+
+				if (!server_item) {
+					e_etesync_utils_set_io_gerror (etebase_error_get_code (), etebase_error_get_message (), &local_error);
+					etebase_error = ETEBASE_ERROR_CODE_NO_ERROR;
+				} else if (e_etesync_connection_item_rebase (server_item, items[ii])) {
+					etebase_item_destroy (items[ii]);
+					items[ii] = server_item;
+
+					success = e_etesync_connection_items_batch_sync (connection, backend, col_obj, &data, &items[ii], &item_sizes[ii], 1, NULL, &etebase_error, cancellable, &local_error);
+				} else {
+					etebase_item_destroy (server_item);
+				}
+			}
+
+			if (!success && etebase_error == ETEBASE_ERROR_CODE_CONFLICT &&
+			    queued_item->conflict_resolution == E_CONFLICT_RESOLUTION_KEEP_SERVER) {
+				success = TRUE;
+				g_clear_error (&local_error);
+
+				g_ptr_array_add (conflicted, g_strdup (queued_item->item_uid));
+				g_clear_pointer (&items[ii], etebase_item_destroy);
+			} else if (!success && (etebase_error == ETEBASE_ERROR_CODE_CONFLICT ||
+				   e_etesync_connection_is_too_large_error (etebase_error, local_error))) {
+				success = TRUE;
+
+				e_etesync_connection_queued_item_failed (backend, cache, queued_item,
+					etebase_error == ETEBASE_ERROR_CODE_CONFLICT ? _("The item was changed on the server") :
+					local_error ? local_error->message : _("The item is too large"), cancellable);
+
+				g_clear_error (&local_error);
+
+				g_hash_table_add (failed, queued_item->item_uid);
+				g_clear_pointer (&items[ii], etebase_item_destroy);
+			}
+		}
+	}
+
+	if (!success)
+		g_propagate_error (error, local_error);
+
+	for (link = queued; link; link = g_slist_next (link)) {
+		EEteSyncCacheItem *queued_item = link->data;
+
+		if (!g_hash_table_contains (failed, queued_item->item_uid))
+			uploaded = g_slist_prepend (uploaded, queued_item);
+	}
+
+	/* Unqueue before saving, otherwise the stored data would not be replaced */
+	if (success)
+		success = e_etesync_cache_unqueue_items_sync (cache, uploaded, cancellable, error);
+
+	if (success) {
+		for (ii = 0; ii < n_items; ii++) {
+			const EtebaseItem *item = items[ii];
+			const gchar *uid;
+
+			if (!item)
+				continue;
+
+			uid = items_queued[ii]->uid;
+
+			if (etebase_item_is_deleted (item)) {
+				e_etesync_connection_forget_items_sync (cache, &item, 1, cancellable, NULL);
+				e_etesync_connection_remember_uploaded_sync (cache, &item, &uid, 1, cancellable);
+			} else {
+				gchar *extra;
+
+				e_etesync_connection_save_items_sync (cache, data->item_mgr, &item, 1, cancellable, NULL);
+				e_etesync_connection_remember_uploaded_sync (cache, &item, &uid, 1, cancellable);
+
+				/* Keep the uploaded item decoded for its next change; the LRU can
+				   have the item as it was before the upload */
+				extra = e_etesync_connection_item_extra_new (item);
+				collection_data_put_item (data, items_queued[ii]->uid, extra, items[ii]);
+				items[ii] = NULL;
+				g_free (extra);
+			}
+		}
+
+		success = e_etesync_connection_resolve_conflicts_sync (data, cache, type, is_memo, conflicted,
+			out_modified_objects, out_removed_objects, cancellable, error);
+	}
+
+	for (ii = 0; ii < n_items; ii++) {
+		if (items[ii])
+			etebase_item_destroy (items[ii]);
+	}
+
+	g_hash_table_destroy (failed);
+	g_ptr_array_unref (conflicted);
+	g_slist_free (uploaded);
+	g_free (items_queued);
+	g_free (item_sizes);
+	g_free (items);
+	g_slist_free_full (queued, e_etesync_cache_item_free);
+	collection_data_unref (data);
+	g_clear_object (&cache);
+
+	e_etesync_connection_unlock_collection (connection, col_obj);
+
+	return success;
+}
+
+/* Items of a batch operation, built in the shared worker threads */
+typedef struct _ItemsBuild {
+	CollectionData *data;
+	ECache *cache;
+	EteSyncAction action;
+	EteSyncType type;
+	gboolean is_memo;
+	time_t now;
+	const gchar *const *content;
+	const gchar *const *data_uids;
+
+	/* results, at the index of the content */
+	EtebaseItem **items;
+	gsize *item_sizes; /* of the serialized encrypted items, to size the requests */
+	gpointer *infos; /* EBookMetaBackendInfo * or ECalMetaBackendInfo * */
+	gchar **items_uids;
+	GError **errors;
+} ItemsBuild;
+
+static ItemsBuild *
+items_build_new (CollectionData *data,
+		 ECache *cache,
+		 const EteSyncAction action,
+		 const EteSyncType type,
+		 gboolean is_memo,
+		 const gchar *const *content,
+		 const gchar *const *data_uids,
+		 guint n_items)
+{
+	ItemsBuild *build;
+
+	build = g_slice_new0 (ItemsBuild);
+	build->data = collection_data_ref (data);
+	build->cache = cache;
+	build->action = action;
+	build->type = type;
+	build->is_memo = is_memo;
+	build->content = content;
+	build->data_uids = data_uids;
+	build->items = g_new0 (EtebaseItem *, n_items);
+	build->item_sizes = g_new0 (gsize, n_items);
+	build->infos = g_new0 (gpointer, n_items);
+	build->items_uids = g_new0 (gchar *, n_items);
+	build->errors = g_new0 (GError *, n_items);
+
+	e_etesync_utils_get_time_now (&build->now);
+
+	return build;
+}
+
+/* Frees the 'build', together with the items, which were not taken from it */
+static void
+items_build_free (ItemsBuild *build,
+		  guint n_items)
+{
+	guint ii;
+
+	for (ii = 0; ii < n_items; ii++) {
+		if (build->items[ii])
+			etebase_item_destroy (build->items[ii]);
+		g_free (build->items_uids[ii]);
+		g_clear_error (&build->errors[ii]);
+	}
+
+	g_free (build->items);
+	g_free (build->item_sizes);
+	g_free (build->infos);
+	g_free (build->items_uids);
+	g_free (build->errors);
+	collection_data_unref (build->data);
+	g_slice_free (ItemsBuild, build);
+}
+
+/* Sets the size of the built item at the 'index' to the size of the item serialized,
+   which is about the size of the encrypted item in the upload request. It's called
+   from the worker threads, thus the encryption does not delay the upload. */
+static void
+items_build_measure_item (ItemsBuild *build,
+			  guint index)
+{
+	GBytes *item_cache;
+
+	item_cache = e_etesync_utils_etebase_item_to_bytes (build->items[index], build->data->item_mgr);
+
+	if (item_cache) {
+		build->item_sizes[index] = g_bytes_get_size (item_cache);
+		g_bytes_unref (item_cache);
+	}
+}
+
+/* Takes the items, which were uploaded, from the 'build'; the 'out_indexes'
+   has their indexes in the content. Returns the count of the uploaded items. */
+static guint
+items_build_take_uploaded (ItemsBuild *build,
+			   guint n_items,
+			   EtebaseItem ***out_items,
+			   guint **out_indexes)
+{
+	guint ii, n_uploaded = 0;
 
-	if (g_cancellable_set_error_if_cancelled (cancellable, error))
-		return FALSE;
+	*out_items = g_new0 (EtebaseItem *, n_items);
+	*out_indexes = g_new0 (guint, n_items);
 
-	if (!col_obj) {
-		return FALSE;
+	for (ii = 0; ii < n_items; ii++) {
+		if (build->items[ii] && !build->errors[ii]) {
+			(*out_items)[n_uploaded] = build->items[ii];
+			(*out_indexes)[n_uploaded] = ii;
+			build->items[ii] = NULL;
+			n_uploaded++;
+		}
 	}
 
-	is_memo = e_etesync_connection_backend_is_for_memos (backend);
-	item_mgr = etebase_collection_manager_get_item_manager (connection->priv->col_mgr, col_obj);
+	return n_uploaded;
+}
 
-	while (!done) {
-		EtebaseItem **items_data;
-		EtebaseItemListResponse *item_list;
-		guintptr items_data_len, item_iter;
-
-		if (e_etesync_connection_chunk_itemlist_fetch_sync (item_mgr, stoken, E_ETESYNC_ITEM_FETCH_LIMIT, &item_list, &items_data_len, &stoken, &done)) {
-
-			items_data = g_alloca (sizeof (EtebaseItem *) * E_ETESYNC_ITEM_FETCH_LIMIT);
-			etebase_item_list_response_get_data (item_list, (const EtebaseItem **) items_data);
-
-			/* At this point, items_data are not empty, then we should loop on items and add each
-			   one to the hashtable as meta backend info for each contact */
-			if (items_data && *items_data) {
-				for (item_iter = 0; item_iter < items_data_len; item_iter++) {
-					const EtebaseItem *item = items_data[item_iter];
-
-					/* check action add, change or delete */
-					if (!etebase_item_is_deleted (item)) {
-						gchar *content = NULL, *data_uid = NULL, *revision = NULL, *item_cache_b64, buf[BUFF_SIZE];
-						gintptr content_len;
-
-						content_len = etebase_item_get_content (item, buf, sizeof (buf));
-
-						if (content_len < 0) {
-							break;
-						} else if (content_len >= sizeof (buf)) {
-							content = g_slice_alloc0 (content_len + 1);
-							etebase_item_get_content (item, content, content_len);
-							content[content_len] = 0;
-						} else {
-							buf[content_len] = 0;
-						}
-
-						item_cache_b64 = e_etesync_utils_etebase_item_to_base64 (item, item_mgr);
-
-						if (type == E_ETESYNC_ADDRESSBOOK) {
-							EBookMetaBackendInfo *nfo;
-
-							/* create EBookMetaBackendInfo * to be stored in GSList, data_uid is contact uid */
-							e_etesync_utils_get_contact_uid_revision (content ? content : buf, &data_uid, &revision);
-							nfo = e_book_meta_backend_info_new (data_uid, revision, content ? content : buf, item_cache_b64);
-							*out_existing_objects = g_slist_append (*out_existing_objects, nfo);
-						} else if (type == E_ETESYNC_CALENDAR) {
-							ECalMetaBackendInfo *nfo;
-
-							if (is_memo) {
-								EtebaseItemMetadata *item_meta;
-								const gchar *summary;
-								gchar *ical_str;
-								time_t now;
-
-								item_meta = etebase_item_get_meta (item);
-								summary = etebase_item_metadata_get_name (item_meta);
-								data_uid = g_strdup (etebase_item_get_uid (item));
-								e_etesync_utils_get_time_now (&now);
-
-								/* change plain text to a icomp vjournal object */
-								ical_str = e_etesync_connection_notes_new_ical_string ((time_t) now, (time_t) now, data_uid, NULL, summary, content ? content : buf);
-								nfo = e_cal_meta_backend_info_new (data_uid, NULL, ical_str, item_cache_b64);
-
-								g_free (ical_str);
-								etebase_item_metadata_destroy (item_meta);
-							} else {
-								/* create ECalMetaBackendInfo * to be stored in GSList, data_uid is component uid */
-								e_etesync_utils_get_component_uid_revision (content ? content : buf, &data_uid, &revision);
-								nfo = e_cal_meta_backend_info_new (data_uid, revision, content ? content : buf, item_cache_b64);
-							}
-
-							*out_existing_objects = g_slist_prepend (*out_existing_objects, nfo);
-						}
-
-						g_free (data_uid);
-						g_free (revision);
-						g_slice_free1 (content_len + 1, content);
-						g_free (item_cache_b64);
-					}
-				}
+/* Adds the infos of the items, which did not fail, into the 'out_batch_info', in the order
+   of the content. When some items failed, the error of the first of them is propagated */
+static gboolean
+items_build_finish (ItemsBuild *build,
+		    guint n_items,
+		    GSList **out_batch_info,
+		    GError **error)
+{
+	GError *first_error = NULL;
+	guint ii, n_failed = 0;
+
+	for (ii = 0; ii < n_items; ii++) {
+		if (build->errors[ii]) {
+			if (!first_error) {
+				first_error = build->errors[ii];
+				build->errors[ii] = NULL;
 			}
-			etebase_item_list_response_destroy (item_list);
 
-		} else {
-			EtebaseErrorCode etebase_error;
+			e_etesync_connection_info_free (build->type, build->infos[ii]);
+			build->infos[ii] = NULL;
+			n_failed++;
+		} else if (build->infos[ii]) {
+			*out_batch_info = g_slist_prepend (*out_batch_info, build->infos[ii]);
+		}
+	}
 
-			etebase_error = etebase_error_get_code ();
-			success = FALSE;
+	if (!n_failed)
+		return TRUE;
 
-			if (etebase_error == ETEBASE_ERROR_CODE_UNAUTHORIZED)
-				success = e_etesync_connection_maybe_reconnect_sync (connection, backend, cancellable, error);
+	if (n_failed == 1)
+		g_propagate_error (error, first_error);
+	else
+		g_propagate_prefixed_error (error, first_error, _("Failed to store %u of %u items: "), n_failed, n_items);
 
-			if (!success) {
-				e_etesync_utils_set_io_gerror (etebase_error, etebase_error_get_message (), error);
-				break;
-			} else /* as collection manager may have changed */
-				item_mgr = etebase_collection_manager_get_item_manager (connection->priv->col_mgr, col_obj);
-		}
-	}
+	return FALSE;
+}
 
-	etebase_item_manager_destroy (item_mgr);
-	*out_new_sync_tag = stoken;
+/* A range of the items to be built in the worker threads */
+typedef struct _ItemsBuildChunk {
+	ItemsBuild *build;
+	EEteSyncWorkerFunc func;
+	guint first;
+	guint n_items;
+} ItemsBuildChunk;
 
-	return success;
+static void
+items_build_chunk_worker (guint index,
+			  gpointer user_data)
+{
+	ItemsBuildChunk *chunk = user_data;
+
+	chunk->func (chunk->first + index, chunk->build);
 }
 
-gboolean
-e_etesync_connection_get_changes_sync (EEteSyncConnection *connection,
-				       EBackend *backend,
-				       const EteSyncType type,
-				       const gchar *last_sync_tag,
-				       const EtebaseCollection *col_obj,
-				       ECache *cache,
-				       gchar **out_new_sync_tag,
-				       GSList **out_created_objects, /* EBookMetaBackendInfo* or ECalMetaBackendInfo* */
-				       GSList **out_modified_objects, /* EBookMetaBackendInfo* or ECalMetaBackendInfo* */
-				       GSList **out_removed_objects, /* EBookMetaBackendInfo* or ECalMetaBackendInfo* */
-				       GCancellable *cancellable,
-				       GError **error)
+/* Builds the items of the 'build' with the 'func' and uploads them, by the push limit of the
+   'backend' source; the next chunk of the items is built while the previous one is uploaded.
+   The items, which failed to be built or uploaded, have set their error in the 'build'; when
+   the upload cannot continue, like when the connection is lost, it is set to all the rest. */
+static void
+e_etesync_connection_items_build_upload_sync (EEteSyncConnection *connection,
+					      EBackend *backend,
+					      const EtebaseCollection *col_obj,
+					      CollectionData **inout_data,
+					      ItemsBuild *build,
+					      EEteSyncWorkerFunc func,
+					      guint n_items,
+					      GCancellable *cancellable)
 {
-	EtebaseItemManager *item_mgr;
-	gchar *stoken;
-	gboolean done = FALSE;
+	ItemsBuildChunk chunk, next;
+	GError *local_error = NULL;
 	gboolean success = TRUE;
-	gboolean is_memo;
+	guint max_items, ii;
 
-	stoken = g_strdup (last_sync_tag);
+	e_etesync_utils_get_push_limits (e_backend_get_source (backend), &max_items, NULL);
 
-	if (g_cancellable_set_error_if_cancelled (cancellable, error))
-		return FALSE;
+	chunk.build = build;
+	chunk.func = func;
+	chunk.first = 0;
+	chunk.n_items = MIN (max_items, n_items);
 
-	if (!col_obj) {
-		return FALSE;
-	}
+	e_etesync_workers_run (chunk.n_items, items_build_chunk_worker, &chunk);
 
-	is_memo = e_etesync_connection_backend_is_for_memos (backend);
-	item_mgr = etebase_collection_manager_get_item_manager (connection->priv->col_mgr, col_obj);
+	while (chunk.n_items && success) {
+		EEteSyncWorkersRun *next_run = NULL;
+		EtebaseItem **items;
+		gsize *item_sizes;
+		GError **item_errors;
+		guint n_built = 0, jj;
 
-	while (!done) {
-		EtebaseItem **items_data;
-		EtebaseItemListResponse *item_list;
-		guintptr items_data_len, item_iter;
-
-		if (e_etesync_connection_chunk_itemlist_fetch_sync (item_mgr, stoken, E_ETESYNC_ITEM_FETCH_LIMIT, &item_list, &items_data_len, &stoken, &done)) {
-
-			items_data = g_alloca (sizeof (EtebaseItem *) * E_ETESYNC_ITEM_FETCH_LIMIT);
-			etebase_item_list_response_get_data (item_list, (const EtebaseItem **) items_data);
-
-			/* At this point, items_data are not empty, then we should loop on items and add each
-			   one to the hashtable as meta backend info for each contact */
-			if (items_data) {
-				for (item_iter = 0; item_iter < items_data_len; item_iter++) {
-					const EtebaseItem *item = items_data[item_iter];
-					gchar *content = NULL, *data_uid = NULL, *revision = NULL, *item_cache_b64, buf[BUFF_SIZE];
-					gintptr content_len;
-					gboolean is_exist = FALSE;
-
-					content_len = etebase_item_get_content (item, buf, sizeof (buf));
-
-					if (content_len < 0) {
-						break;
-					} else if (content_len >= sizeof (buf)) {
-						content = g_slice_alloc0 (content_len + 1);
-						etebase_item_get_content (item, content, content_len);
-						content[content_len] = 0;
-					} else {
-						buf[content_len] = 0;
-					}
+		next = chunk;
+		next.first = chunk.first + chunk.n_items;
+		next.n_items = MIN (max_items, n_items - next.first);
 
-					item_cache_b64 = e_etesync_utils_etebase_item_to_base64 (item, item_mgr);
-
-					if (type == E_ETESYNC_ADDRESSBOOK) {
-						EBookMetaBackendInfo *nfo;
-
-						/* create EBookMetaBackendInfo * to be stored in GSList, data uid is contact uid */
-						e_etesync_utils_get_contact_uid_revision (content ? content : buf, &data_uid, &revision);
-
-						nfo = e_book_meta_backend_info_new (data_uid, revision, content ? content : buf, item_cache_b64);
-						is_exist = e_cache_contains (cache, data_uid, E_CACHE_EXCLUDE_DELETED);
-
-						/* data with uid exist, then it is modified or deleted, else it is new data */
-						if (is_exist) {
-							if (etebase_item_is_deleted (item))
-								*out_removed_objects = g_slist_prepend (*out_removed_objects, nfo);
-							else
-								*out_modified_objects = g_slist_prepend (*out_modified_objects, nfo);
-						} else {
-							if (!etebase_item_is_deleted (item))
-								*out_created_objects = g_slist_prepend (*out_created_objects, nfo);
-							else
-								e_book_meta_backend_info_free (nfo);
-						}
-					} else if (type == E_ETESYNC_CALENDAR) {
-						ECalMetaBackendInfo *nfo;
-
-						if (is_memo) {
-							EtebaseItemMetadata *item_meta;
-							const gchar *summary;
-							gchar *ical_str;
-							time_t now;
-
-							item_meta = etebase_item_get_meta (item);
-							summary = etebase_item_metadata_get_name (item_meta);
-							data_uid = g_strdup (etebase_item_get_uid (item));
-							e_etesync_utils_get_time_now (&now);
-
-							/* change plain text to a icomp vjournal object */
-							ical_str = e_etesync_connection_notes_new_ical_string ((time_t) now, (time_t) now, data_uid, NULL, summary, content ? content : buf);
-							nfo = e_cal_meta_backend_info_new (data_uid, NULL, ical_str, item_cache_b64);
-
-							g_free (ical_str);
-							etebase_item_metadata_destroy (item_meta);
-						} else {
-							/* create ECalMetaBackendInfo * to be stored in GSList, data uid is compounent uid */
-							e_etesync_utils_get_component_uid_revision (content ? content : buf, &data_uid, &revision);
-							nfo = e_cal_meta_backend_info_new (data_uid, revision, content ? content : buf, item_cache_b64);
-						}
-
-						is_exist = e_cache_contains (cache, data_uid, E_CACHE_EXCLUDE_DELETED);
-
-						/* data with uid exist, then it is modified or deleted, else it is new data */
-						if (is_exist) {
-							if (etebase_item_is_deleted (item))
-								*out_removed_objects = g_slist_prepend (*out_removed_objects, nfo);
-							else
-								*out_modified_objects = g_slist_prepend (*out_modified_objects, nfo);
-						} else {
-							if (!etebase_item_is_deleted (item))
-								*out_created_objects = g_slist_prepend (*out_created_objects, nfo);
-							else
-								e_cal_meta_backend_info_free (nfo);
-						}
-					}
+		if (next.n_items)
+			next_run = e_etesync_workers_start (next.n_items, items_build_chunk_worker, &next);
 
-					g_free (revision);
-					g_slice_free1 (content_len + 1, content);
-					g_free (data_uid);
-					g_free (item_cache_b64);
-				}
-			}
-			etebase_item_list_response_destroy (item_list);
+		items = g_new0 (EtebaseItem *, chunk.n_items);
+		item_sizes = g_new0 (gsize, chunk.n_items);
+		item_errors = g_new0 (GError *, chunk.n_items);
 
-		} else {
-			EtebaseErrorCode etebase_error;
+		/* only the items, which were built, are uploaded */
+		for (ii = chunk.first; ii < next.first; ii++) {
+			if (build->items[ii] && !build->errors[ii]) {
+				item_sizes[n_built] = build->item_sizes[ii];
+				items[n_built++] = build->items[ii];
+			}
+		}
 
-			etebase_error = etebase_error_get_code ();
+		if (g_cancellable_set_error_if_cancelled (cancellable, &local_error))
 			success = FALSE;
+		else if (n_built)
+			success = e_etesync_connection_items_batch_sync (connection, backend, col_obj, inout_data, items, item_sizes, n_built, item_errors, NULL, cancellable, &local_error);
+
+		if (!success) {
+			if (!local_error)
+				local_error = g_error_new_literal (G_IO_ERROR, G_IO_ERROR_FAILED, _("Failed to upload items"));
 
-			if (etebase_error == ETEBASE_ERROR_CODE_UNAUTHORIZED)
-				success = e_etesync_connection_maybe_reconnect_sync (connection, backend, cancellable, error);
+			e_etesync_connection_set_item_errors (item_errors, n_built, local_error);
+		}
 
-			if (!success) {
-				e_etesync_utils_set_io_gerror (etebase_error, etebase_error_get_message (), error);
-				break;
-			} else /* as collection manager may have changed */
-				item_mgr = etebase_collection_manager_get_item_manager (connection->priv->col_mgr, col_obj);
+		for (ii = chunk.first, jj = 0; ii < next.first; ii++) {
+			if (build->items[ii] && !build->errors[ii])
+				build->errors[ii] = item_errors[jj++];
 		}
+
+		g_free (item_errors);
+		g_free (item_sizes);
+		g_free (items);
+
+		if (next_run)
+			e_etesync_workers_wait (next_run);
+
+		chunk = next;
 	}
 
-	etebase_item_manager_destroy (item_mgr);
-	*out_new_sync_tag = stoken;
+	if (local_error) {
+		for (ii = chunk.first; ii < n_items; ii++) {
+			if (!build->errors[ii])
+				build->errors[ii] = g_error_copy (local_error);
+		}
 
-	return success;
+		g_clear_error (&local_error);
+	}
 }
 
-/* ------------------------ Uploading item functions -----------------------*/
-
-gboolean
-e_etesync_connection_item_upload_sync (EEteSyncConnection *connection,
-				       EBackend *backend,
-				       const EtebaseCollection *col_obj,
-				       const EteSyncAction action,
-				       const gchar *content,
-				       const gchar *uid,
-				       const gchar *extra, /* item_cache_b64 */
-				       gchar **out_new_uid,
-				       gchar **out_new_extra,
-				       GCancellable *cancellable,
-				       GError **error)
+/* Creates and encrypts a new item for the content at the 'index' */
+static void
+e_etesync_connection_create_item_worker (guint index,
+					 gpointer user_data)
 {
-	EtebaseItemManager *item_mgr;
-	gboolean success = TRUE;
-	gboolean is_memo;
-	const gchar *item_cache_b64 = extra;
-
-	g_return_val_if_fail (connection != NULL, FALSE);
-	g_return_val_if_fail (col_obj != NULL, FALSE);
+	ItemsBuild *build = user_data;
+	const gchar *content = build->content[index];
+	EtebaseItemMetadata *item_metadata = NULL;
+	gchar *data_uid = NULL, *revision = NULL, *notes_item_content = NULL; /* notes_item_content is add to support EteSync notes */
+
+	if (build->type == E_ETESYNC_ADDRESSBOOK) /* Contact */
+		e_etesync_utils_get_contact_uid_revision (content, &data_uid, &revision);
+	else if (build->type == E_ETESYNC_CALENDAR) { /* Calendar */
+		if (build->is_memo) { /* Notes */
+			ICalComponent *icomp = i_cal_component_new_from_string (content);
 
-	if (g_cancellable_set_error_if_cancelled (cancellable, error))
-		return FALSE;
+			data_uid = g_strdup (i_cal_component_get_summary (icomp));
+			notes_item_content = g_strdup (i_cal_component_get_description (icomp));
 
-	g_rec_mutex_lock (&connection->priv->connection_lock);
+			g_object_unref (icomp);
+		} else { /* Events and Tasks */
+			e_etesync_utils_get_component_uid_revision (content, &data_uid, &revision);
+		}
+	}
 
-	is_memo = e_etesync_connection_backend_is_for_memos (backend);
-	item_mgr = etebase_collection_manager_get_item_manager (connection->priv->col_mgr, col_obj);
+	item_metadata = etebase_item_metadata_new ();
 
-	if (item_mgr) {
-		EtebaseItemMetadata *item_metadata = NULL;
-		EtebaseItem *item;
-		time_t now;
-		gchar *item_name, *item_content; /* Added to support EteSync notes type */
+	etebase_item_metadata_set_name (item_metadata, data_uid);
+	etebase_item_metadata_set_mtime (item_metadata, &build->now);
 
-		e_etesync_utils_get_time_now (&now);
+	if (build->is_memo) { /* Notes */
+		build->items[index] = etebase_item_manager_create (build->data->item_mgr, item_metadata, notes_item_content ? notes_item_content : "", notes_item_content ? strlen (notes_item_content) : 0);
+		g_free (notes_item_content);
+	} else { /* Addressbook, Calendar, Task */
+		build->items[index] = etebase_item_manager_create (build->data->item_mgr, item_metadata, content, strlen (content));
+	}
 
-		/* If it is etesync note item, then set the EteSyncitem metadata name (uid) to summary in VJOURNAL
-		   and set the EteSyncItem content to the description in VJOURNAL */
-		if (action != E_ETESYNC_ITEM_ACTION_DELETE && is_memo) {
-			ICalComponent *icomp = i_cal_component_new_from_string (content);
+	if (!build->items[index]) {
+		/* the etebase error is per thread, thus it belongs to this item */
+		e_etesync_utils_set_io_gerror (etebase_error_get_code (), etebase_error_get_message (), &build->errors[index]);
 
-			item_name = g_strdup (i_cal_component_get_summary (icomp)); /* set data_uid to summary */
-			item_content = g_strdup (i_cal_component_get_description (icomp)); /* set content to description */
+		if (!build->errors[index])
+			g_set_error_literal (&build->errors[index], G_IO_ERROR, G_IO_ERROR_FAILED, _("Failed to create item"));
+	} else {
+		/* the extra is set once the item is uploaded */
+		if (build->type == E_ETESYNC_ADDRESSBOOK) { /* Contact */
+			build->infos[index] = e_book_meta_backend_info_new (data_uid, revision, content, NULL);
+		} else if (build->type == E_ETESYNC_CALENDAR) { /* Calendar */
+			if (build->is_memo) { /* Notes */
+				g_free (data_uid);
+				data_uid = g_strdup (etebase_item_get_uid (build->items[index]));
+			}
 
-			g_object_unref (icomp);
-		} else {
-			item_name = g_strdup (uid);
-			item_content = g_strdup (content);
+			build->infos[index] = e_cal_meta_backend_info_new (data_uid, revision, content, NULL);
 		}
 
-		if (action == E_ETESYNC_ITEM_ACTION_CREATE) {
-			item_metadata = etebase_item_metadata_new ();
+		build->items_uids[index] = data_uid;
+		data_uid = NULL;
 
-			etebase_item_metadata_set_name (item_metadata, item_name);
-			etebase_item_metadata_set_mtime (item_metadata, &now);
+		items_build_measure_item (build, index);
+	}
 
-			item = etebase_item_manager_create (item_mgr, item_metadata, item_content ? item_content : "" , item_content ? strlen (item_content) : 0);
-		} else {
-			item = e_etesync_utils_etebase_item_from_base64 (item_cache_b64, item_mgr);
-			if (!item) {
-				success = FALSE;
-				g_clear_error (error);
-				g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED, _("Item not found"));
-			} else {
-				item_metadata = etebase_item_get_meta (item);
+	g_free (data_uid);
+	g_free (revision);
+	etebase_item_metadata_destroy (item_metadata);
+}
 
-				etebase_item_metadata_set_name (item_metadata, item_name);
-				etebase_item_metadata_set_mtime (item_metadata, &now);
-				etebase_item_set_meta(item, item_metadata);
+/* Applies the modify or the delete action on the item of the content at the 'index' */
+static void
+e_etesync_connection_change_item_worker (guint index,
+					 gpointer user_data)
+{
+	ItemsBuild *build = user_data;
+	const gchar *content = build->content[index];
+	EtebaseItemMetadata *item_metadata = NULL;
+	EtebaseItem *item;
+	gchar *data_uid = NULL, *revision = NULL, *item_cache_b64 = NULL;
+
+	if (build->type == E_ETESYNC_ADDRESSBOOK) {/* Contact */
+		e_etesync_utils_get_contact_uid_revision (content, &data_uid, &revision);
+		e_book_cache_get_contact_extra (E_BOOK_CACHE (build->cache), data_uid, &item_cache_b64, NULL, NULL);
+	} else if (build->type == E_ETESYNC_CALENDAR) {/* Calendar */
+
+		if (build->is_memo)
+			data_uid = g_strdup (build->data_uids[index]);
+		else
+			e_etesync_utils_get_component_uid_revision (content, &data_uid, &revision);
 
-				if (action == E_ETESYNC_ITEM_ACTION_MODIFY)
-					etebase_item_set_content (item, item_content ? item_content : "" , item_content ? strlen (item_content) : 0);
-				else if (action == E_ETESYNC_ITEM_ACTION_DELETE)
-					etebase_item_delete (item);
-			}
-		}
+		e_cal_cache_get_component_extra (E_CAL_CACHE (build->cache), data_uid, NULL, &item_cache_b64, NULL, NULL);
+	}
 
-		/* This could fail when trying to fetch an item and it wasn't found in modify/delete */
-		if (success) {
-			success = !etebase_item_manager_batch (item_mgr, (const EtebaseItem **) &item, 1, NULL);
+	item = collection_data_dup_item (build->data, build->cache, data_uid, item_cache_b64);
 
-			if (!success) {
-				EtebaseErrorCode etebase_error = etebase_error_get_code ();
-				/* This is used to check if the error was due to expired token, if so try to get a new token, then try again */
-				if (etebase_error == ETEBASE_ERROR_CODE_UNAUTHORIZED &&
-				    e_etesync_connection_maybe_reconnect_sync (connection, backend, cancellable, error)) {
+	if (!item) {
+		g_set_error_literal (&build->errors[index], G_IO_ERROR, G_IO_ERROR_FAILED, _("Item not found"));
+	} else {
+		item_metadata = etebase_item_get_meta (item);
 
-					success = !etebase_item_manager_batch (item_mgr, (const EtebaseItem **) &item, 1, NULL);
-				}
+		etebase_item_metadata_set_mtime (item_metadata, &build->now);
+		etebase_item_set_meta(item, item_metadata);
 
-				if (!success)
-					e_etesync_utils_set_io_gerror (etebase_error, etebase_error_get_message (), error);
-			}
+		if (build->action == E_ETESYNC_ITEM_ACTION_MODIFY) {/* Modify */
 
-			if (out_new_extra)
-				*out_new_extra = success ? e_etesync_utils_etebase_item_to_base64 (item, item_mgr) : NULL;
+			if (build->is_memo) { /* notes */
+				ICalComponent *icomp;
+				const gchar *notes_item_content; /* notes_item_content is add to support EteSync notes */
 
-			/* Set the new uid for notes from the EteSyncitem uid, as EteSync notes item doesn't contain
-			   uid in its content as other etesync types (calendar, tasks, contacts) */
-			if (action == E_ETESYNC_ITEM_ACTION_CREATE &&
-			    out_new_uid &&
-			    is_memo)
-				*out_new_uid = g_strdup (etebase_item_get_uid (item));
+				icomp = i_cal_component_new_from_string (content);
+				notes_item_content = i_cal_component_get_description (icomp);
 
-			if (item_metadata)
-				etebase_item_metadata_destroy (item_metadata);
-			etebase_item_destroy (item);
-		}
+				etebase_item_metadata_set_name (item_metadata, i_cal_component_get_summary (icomp));
+				etebase_item_set_meta (item, item_metadata);
 
-		g_free (item_name);
-		g_free (item_content);
-		etebase_item_manager_destroy (item_mgr);
-	}
+				etebase_item_set_content (item, notes_item_content ? notes_item_content : "", notes_item_content ? strlen (notes_item_content) : 0);
 
-	g_rec_mutex_unlock (&connection->priv->connection_lock);
+				g_object_unref (icomp);
+			} else { /* Events and Tasks */
+				etebase_item_set_content (item, content, strlen (content));
+			}
+		} else if (build->action == E_ETESYNC_ITEM_ACTION_DELETE) /* Delete */
+			etebase_item_delete (item);
 
-	return success;
+		/* the extra is set once the item is uploaded */
+		if (build->type == E_ETESYNC_ADDRESSBOOK) /* Contact */
+			build->infos[index] = e_book_meta_backend_info_new (data_uid, revision, content, NULL);
+		else if (build->type == E_ETESYNC_CALENDAR) /* Calendar */
+			build->infos[index] = e_cal_meta_backend_info_new (data_uid, revision, content, NULL);
+
+		build->items[index] = item;
+		build->items_uids[index] = g_strdup (data_uid);
+
+		items_build_measure_item (build, index);
+	}
+
+	g_free (data_uid);
+	g_free (revision);
+	g_free (item_cache_b64);
+	if (item_metadata)
+		etebase_item_metadata_destroy (item_metadata);
 }
 
 static gboolean
@@ -1094,7 +4066,7 @@ e_etesync_connection_batch_modify_delete_sync (EEteSyncConnection *connection,
 					       GCancellable *cancellable,
 					       GError **error)
 {
-	EtebaseItemManager *item_mgr;
+	CollectionData *data;
 	gboolean success = TRUE;
 	gboolean is_memo;
 
@@ -1104,116 +4076,75 @@ e_etesync_connection_batch_modify_delete_sync (EEteSyncConnection *connection,
 	if (g_cancellable_set_error_if_cancelled (cancellable, error))
 		return FALSE;
 
-	g_rec_mutex_lock (&connection->priv->connection_lock);
+	e_etesync_connection_lock_collection (connection, col_obj);
 
 	is_memo = e_etesync_connection_backend_is_for_memos (backend);
-	item_mgr = etebase_collection_manager_get_item_manager (connection->priv->col_mgr, col_obj);
-
-	if (item_mgr) {
-		EtebaseItem *items[content_len];
-		guint ii;
-		time_t now;
-
-		e_etesync_utils_get_time_now (&now);
-
-		memset (items, 0, content_len);
+	data = e_etesync_connection_ref_collection_data (connection, col_obj);
 
-		for (ii = 0; ii < content_len && success; ii++) {
-			EtebaseItemMetadata *item_metadata = NULL;
-			gchar *data_uid = NULL, *revision = NULL, *item_cache_b64 = NULL;
+	if (data) {
+		ItemsBuild *build;
+		EtebaseItem **uploaded = NULL;
+		const gchar **uploaded_uids;
+		guint *uploaded_indexes = NULL;
+		guint ii, n_uploaded;
 
-			if (type == E_ETESYNC_ADDRESSBOOK) {/* Contact */
-				e_etesync_utils_get_contact_uid_revision (content[ii], &data_uid, &revision);
-				e_book_cache_get_contact_extra (E_BOOK_CACHE (cache), data_uid, &item_cache_b64, NULL, NULL);
-			} else if (type == E_ETESYNC_CALENDAR) {/* Calendar */
+		/* the items are built and encrypted in parallel, only the upload is serialized;
+		   this could fail when trying to fetch an item and it wasn't found in modify */
+		build = items_build_new (data, cache, action, type, is_memo, content, data_uids, content_len);
 
-				if (is_memo)
-					data_uid = g_strdup (data_uids[ii]);
-				else
-					e_etesync_utils_get_component_uid_revision (content[ii], &data_uid, &revision);
+		e_etesync_connection_items_build_upload_sync (connection, backend, col_obj, &data, build,
+			e_etesync_connection_change_item_worker, content_len, cancellable);
 
-				e_cal_cache_get_component_extra (E_CAL_CACHE (cache), data_uid, NULL, &item_cache_b64, NULL, NULL);
-			}
-
-			items[ii] = e_etesync_utils_etebase_item_from_base64 (item_cache_b64, item_mgr);
-
-			if (!items[ii]) {
-				success = FALSE;
-				g_clear_error (error);
-				g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED, _("Item not found"));
-			} else {
-				item_metadata = etebase_item_get_meta (items[ii]);
-
-				etebase_item_metadata_set_mtime (item_metadata, &now);
-				etebase_item_set_meta(items[ii], item_metadata);
-
-				if (action == E_ETESYNC_ITEM_ACTION_MODIFY) {/* Modify */
-
-					if (is_memo) { /* notes */
-						ICalComponent *icomp;
-						const gchar *notes_item_content; /* notes_item_content is add to support EteSync notes */
-
-						icomp = i_cal_component_new_from_string (content[ii]);
-						notes_item_content = i_cal_component_get_description (icomp);
+		n_uploaded = items_build_take_uploaded (build, content_len, &uploaded, &uploaded_indexes);
 
-						etebase_item_metadata_set_name (item_metadata, i_cal_component_get_summary (icomp));
-						etebase_item_set_meta (items[ii], item_metadata);
+		uploaded_uids = g_new0 (const gchar *, n_uploaded + 1);
 
-						etebase_item_set_content (items[ii], notes_item_content ? notes_item_content : "", notes_item_content ? strlen (notes_item_content) : 0);
+		for (ii = 0; ii < n_uploaded; ii++)
+			uploaded_uids[ii] = build->items_uids[uploaded_indexes[ii]];
 
-						g_object_unref (icomp);
-					} else { /* Events and Tasks */
-						etebase_item_set_content (items[ii], content[ii], strlen (content[ii]));
-					}
-				} else if (action == E_ETESYNC_ITEM_ACTION_DELETE) /* Delete */
-					etebase_item_delete (items[ii]);
+		if (n_uploaded && action == E_ETESYNC_ITEM_ACTION_MODIFY) {
+			gchar **extras;
 
-				g_free (item_cache_b64);
-				item_cache_b64 = e_etesync_utils_etebase_item_to_base64 (items[ii], item_mgr);
+			extras = e_etesync_connection_dup_uploaded_extras (cache, data->item_mgr, uploaded, n_uploaded, cancellable);
+			e_etesync_connection_remember_uploaded_sync (cache, (const EtebaseItem *const *) uploaded, uploaded_uids, n_uploaded, cancellable);
 
-				if (type == E_ETESYNC_ADDRESSBOOK) { /* Contact */
-					EBookMetaBackendInfo *nfo;
+			for (ii = 0; ii < n_uploaded; ii++) {
+				guint index = uploaded_indexes[ii];
 
-					nfo = e_book_meta_backend_info_new (data_uid, revision, content[ii], item_cache_b64);
-					*out_batch_info = g_slist_prepend (*out_batch_info, nfo);
-				} else if (type == E_ETESYNC_CALENDAR) { /* Calendar */
-					ECalMetaBackendInfo *nfo;
+				if (build->infos[index])
+					e_etesync_connection_info_take_extra (type, build->infos[index], g_strdup (extras[ii]));
 
-					nfo = e_cal_meta_backend_info_new (data_uid, revision, content[ii], item_cache_b64);
-					*out_batch_info = g_slist_prepend (*out_batch_info, nfo);
-				}
+				/* Keep the modified items decoded for their next change */
+				collection_data_put_item (data, build->items_uids[index], extras[ii], uploaded[ii]);
+				uploaded[ii] = NULL;
 			}
-			g_free (data_uid);
-			g_free (revision);
-			g_free (item_cache_b64);
-			if (item_metadata)
-				etebase_item_metadata_destroy (item_metadata);
-		}
 
-		/* This could fail when trying to fetch an item and it wasn't found in modify */
-		if (success) {
-			success = !etebase_item_manager_batch (item_mgr, (const EtebaseItem **) items, ETEBASE_UTILS_C_ARRAY_LEN (items), NULL);
+			g_strfreev (extras);
+		} else if (n_uploaded) {
+			e_etesync_connection_forget_items_sync (cache, (const EtebaseItem *const *) uploaded, n_uploaded, cancellable, NULL);
+			e_etesync_connection_remember_uploaded_sync (cache, (const EtebaseItem *const *) uploaded, uploaded_uids, n_uploaded, cancellable);
+		}
 
-			if (!success) {
-				EtebaseErrorCode etebase_error = etebase_error_get_code ();
+		/* the items, which failed, are left out of the 'out_batch_info' */
+		success = items_build_finish (build, content_len, out_batch_info, error);
 
-				/* This is used to check if the error was due to expired token, if so try to get a new token, then try again */
-				if (etebase_error == ETEBASE_ERROR_CODE_UNAUTHORIZED &&
-				    e_etesync_connection_maybe_reconnect_sync (connection, backend, cancellable, error)) {
+		for (ii = 0; ii < n_uploaded; ii++) {
+			if (uploaded[ii])
+				etebase_item_destroy (uploaded[ii]);
+		}
 
-					success = !etebase_item_manager_batch (item_mgr, (const EtebaseItem **) items, ETEBASE_UTILS_C_ARRAY_LEN (items), NULL);
-				}
+		g_free (uploaded);
+		g_free (uploaded_uids);
+		g_free (uploaded_indexes);
+		items_build_free (build, content_len);
 
-				if (!success)
-					e_etesync_utils_set_io_gerror (etebase_error, etebase_error_get_message (), error);
-			}
-		}
-		for (ii = 0; ii < content_len && items[ii]; ii++)
-			etebase_item_destroy (items[ii]);
+		collection_data_unref (data);
+	} else {
+		success = FALSE;
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_CONNECTED, _("Not connected"));
 	}
-	etebase_item_manager_destroy (item_mgr);
 
-	g_rec_mutex_unlock (&connection->priv->connection_lock);
+	e_etesync_connection_unlock_collection (connection, col_obj);
 
 	return success;
 }
@@ -1229,7 +4160,8 @@ e_etesync_connection_batch_create_sync (EEteSyncConnection *connection,
 					GCancellable *cancellable,
 					GError **error)
 {
-	EtebaseItemManager *item_mgr;
+	CollectionData *data;
+	ECache *cache;
 	gboolean success = TRUE;
 	gboolean is_memo;
 
@@ -1239,96 +4171,68 @@ e_etesync_connection_batch_create_sync (EEteSyncConnection *connection,
 	if (g_cancellable_set_error_if_cancelled (cancellable, error))
 		return FALSE;
 
-	g_rec_mutex_lock (&connection->priv->connection_lock);
+	e_etesync_connection_lock_collection (connection, col_obj);
 
 	is_memo = e_etesync_connection_backend_is_for_memos (backend);
-	item_mgr = etebase_collection_manager_get_item_manager (connection->priv->col_mgr, col_obj);
-
-	if (item_mgr) {
-		EtebaseItem *items[content_len];
-		guint ii;
-		time_t now;
-
-		e_etesync_utils_get_time_now (&now);
-
-		for (ii = 0; ii < content_len; ii++) {
-			EtebaseItemMetadata *item_metadata = NULL;
-			gchar *data_uid = NULL, *revision = NULL, *notes_item_content = NULL; /* notes_item_content is add to support EteSync notes */
-			gchar *item_cache_b64;
+	cache = e_etesync_connection_ref_backend_cache (backend);
+	data = e_etesync_connection_ref_collection_data (connection, col_obj);
 
-			if (type == E_ETESYNC_ADDRESSBOOK) /* Contact */
-				e_etesync_utils_get_contact_uid_revision (content[ii], &data_uid, &revision);
-			else if (type == E_ETESYNC_CALENDAR) { /* Calendar */
-				if (is_memo) { /* Notes */
-					ICalComponent *icomp = i_cal_component_new_from_string (content[ii]);
+	if (data) {
+		ItemsBuild *build;
+		EtebaseItem **uploaded = NULL;
+		guint *uploaded_indexes = NULL;
+		guint ii, n_uploaded;
 
-					data_uid = g_strdup (i_cal_component_get_summary (icomp));
-					notes_item_content = g_strdup (i_cal_component_get_description (icomp));
+		/* the items are built and encrypted in parallel, only the upload is serialized */
+		build = items_build_new (data, cache, E_ETESYNC_ITEM_ACTION_CREATE, type, is_memo, content, NULL, content_len);
 
-					g_object_unref (icomp);
-				} else { /* Events and Tasks */
-					e_etesync_utils_get_component_uid_revision (content[ii], &data_uid, &revision);
-				}
-			}
+		e_etesync_connection_items_build_upload_sync (connection, backend, col_obj, &data, build,
+			e_etesync_connection_create_item_worker, content_len, cancellable);
 
-			item_metadata = etebase_item_metadata_new ();
+		n_uploaded = items_build_take_uploaded (build, content_len, &uploaded, &uploaded_indexes);
 
-			etebase_item_metadata_set_name (item_metadata, data_uid);
-			etebase_item_metadata_set_mtime (item_metadata, &now);
+		if (n_uploaded) {
+			const gchar **uploaded_uids;
+			gchar **extras;
 
-			if (is_memo) { /* Notes */
-				items[ii] = etebase_item_manager_create (item_mgr, item_metadata, notes_item_content ? notes_item_content : "", notes_item_content ? strlen (notes_item_content) : 0);
-				g_free (notes_item_content);
-			} else { /* Addressbook, Calendar, Task */
-				items[ii] = etebase_item_manager_create (item_mgr, item_metadata, content[ii], strlen (content[ii]));
-			}
+			uploaded_uids = g_new0 (const gchar *, n_uploaded + 1);
 
-			item_cache_b64 = e_etesync_utils_etebase_item_to_base64 (items[ii], item_mgr);
+			for (ii = 0; ii < n_uploaded; ii++)
+				uploaded_uids[ii] = build->items_uids[uploaded_indexes[ii]];
 
-			if (type == E_ETESYNC_ADDRESSBOOK) { /* Contact */
-				EBookMetaBackendInfo *nfo;
+			extras = e_etesync_connection_dup_uploaded_extras (cache, data->item_mgr, uploaded, n_uploaded, cancellable);
+			e_etesync_connection_remember_uploaded_sync (cache, (const EtebaseItem *const *) uploaded, uploaded_uids, n_uploaded, cancellable);
+			g_free (uploaded_uids);
 
-				nfo = e_book_meta_backend_info_new (data_uid, revision, content[ii], item_cache_b64);
-				*out_batch_info = g_slist_prepend (*out_batch_info, nfo);
-			} else if (type == E_ETESYNC_CALENDAR) { /* Calendar */
-				ECalMetaBackendInfo *nfo;
+			for (ii = 0; ii < n_uploaded; ii++) {
+				guint index = uploaded_indexes[ii];
 
-				if (is_memo) { /* Notes */
-					g_free (data_uid);
-					data_uid = g_strdup (etebase_item_get_uid (items[ii]));
-				}
+				if (build->infos[index])
+					e_etesync_connection_info_take_extra (type, build->infos[index], g_strdup (extras[ii]));
 
-				nfo = e_cal_meta_backend_info_new (data_uid, revision, content[ii], item_cache_b64);
-				*out_batch_info = g_slist_prepend (*out_batch_info, nfo);
+				/* Keep the created items decoded for their next change */
+				collection_data_put_item (data, build->items_uids[index], extras[ii], uploaded[ii]);
 			}
-			g_free (data_uid);
-			g_free (revision);
-			g_free (item_cache_b64);
-			etebase_item_metadata_destroy (item_metadata);
-		}
-
-		success = !etebase_item_manager_batch (item_mgr, (const EtebaseItem **) items, ETEBASE_UTILS_C_ARRAY_LEN (items), NULL);
-
-		if (!success) {
-			EtebaseErrorCode etebase_error = etebase_error_get_code ();
 
-			/* This is used to check if the error was due to expired token, if so try to get a new token, then try again */
-			if (etebase_error == ETEBASE_ERROR_CODE_UNAUTHORIZED &&
-			    e_etesync_connection_maybe_reconnect_sync (connection, backend, cancellable, error)) {
+			g_strfreev (extras);
+		}
 
-				success = !etebase_item_manager_batch (item_mgr, (const EtebaseItem **) items, ETEBASE_UTILS_C_ARRAY_LEN (items), NULL);
-			}
+		/* the items, which failed, are left out of the 'out_batch_info' */
+		success = items_build_finish (build, content_len, out_batch_info, error);
 
-			if (!success)
-				e_etesync_utils_set_io_gerror (etebase_error, etebase_error_get_message (), error);
-		}
+		g_free (uploaded);
+		g_free (uploaded_indexes);
+		items_build_free (build, content_len);
 
-		for (ii = 0; ii < content_len && success; ii++)
-			etebase_item_destroy (items[ii]);
+		collection_data_unref (data);
+	} else {
+		success = FALSE;
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_CONNECTED, _("Not connected"));
 	}
-	etebase_item_manager_destroy (item_mgr);
 
-	g_rec_mutex_unlock (&connection->priv->connection_lock);
+	g_clear_object (&cache);
+
+	e_etesync_connection_unlock_collection (connection, col_obj);
 
 	return success;
 }
@@ -1388,9 +4292,21 @@ etesync_connection_finalize (GObject *object)
 	e_etesync_connection_clear (connection);
 	g_free (connection->priv->hash_key);
 	g_clear_object (&connection->priv->collection_source);
+	g_hash_table_destroy (connection->priv->collections);
+	g_hash_table_destroy (connection->priv->pending_fetches);
+	g_hash_table_destroy (connection->priv->pending_items);
+	g_hash_table_destroy (connection->priv->collection_stokens);
+	g_hash_table_destroy (connection->priv->col_obj_stokens);
+	g_hash_table_destroy (connection->priv->collection_locks);
+	g_hash_table_destroy (connection->priv->known_collections);
+	g_free (connection->priv->collections_stoken);
 	g_rec_mutex_unlock (&connection->priv->connection_lock);
 
+	e_etesync_executor_unref (connection->priv->executor);
+
 	g_rec_mutex_clear (&connection->priv->connection_lock);
+	g_rec_mutex_clear (&connection->priv->reconnect_lock);
+	g_mutex_clear (&connection->priv->collections_check_lock);
 
 	/* Chain up to parent's finalize() method. */
 	G_OBJECT_CLASS (e_etesync_connection_parent_class)->finalize (object);
@@ -1412,27 +4328,35 @@ e_etesync_connection_init (EEteSyncConnection *connection)
 
 	connection->priv->requested_credentials = FALSE;
 	connection->priv->hash_key = NULL;
+	connection->priv->collections = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, collection_data_unref);
+	connection->priv->pending_fetches = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+		(GDestroyNotify) e_etesync_connection_fetch_pipeline_free);
+	connection->priv->pending_items = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, pending_items_free);
+	connection->priv->collection_stokens = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+	connection->priv->col_obj_stokens = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+	connection->priv->collection_locks = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, collection_lock_free);
+	connection->priv->executor = e_etesync_executor_new (E_ETESYNC_MAX_REQUESTS);
+	connection->priv->known_collections = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, known_collection_free);
 	g_rec_mutex_init (&connection->priv->connection_lock);
+	g_rec_mutex_init (&connection->priv->reconnect_lock);
+	g_mutex_init (&connection->priv->collections_check_lock);
 }
 
 /* ---------------------Encapsulation functions------------------- */
 
-const gchar *
-e_etesync_connection_get_session_key (EEteSyncConnection *connection)
+/* Returns a copy of the current session key, free it with g_free(); or NULL, when not connected */
+gchar *
+e_etesync_connection_dup_session_key (EEteSyncConnection *connection)
 {
-	g_return_val_if_fail (E_IS_ETESYNC_CONNECTION (connection), NULL);
+	gchar *session_key;
 
-	return connection->priv->session_key;
-}
+	g_return_val_if_fail (E_IS_ETESYNC_CONNECTION (connection), NULL);
 
-void
-e_etesync_connection_set_session_key (EEteSyncConnection *connection,
-				      const gchar* session_key)
-{
-	g_return_if_fail (E_IS_ETESYNC_CONNECTION (connection));
+	g_rec_mutex_lock (&connection->priv->connection_lock);
+	session_key = g_strdup (connection->priv->session_key);
+	g_rec_mutex_unlock (&connection->priv->connection_lock);
 
-	g_free (connection->priv->session_key);
-	connection->priv->session_key = g_strdup (session_key);
+	return session_key;
 }
 
 gboolean
@@ -1442,27 +4366,3 @@ e_etesync_connection_get_requested_credentials (EEteSyncConnection *connection)
 
 	return connection->priv->requested_credentials;
 }
-
-EtebaseClient *
-e_etesync_connection_get_etebase_client (EEteSyncConnection *connection)
-{
-	g_return_val_if_fail (E_IS_ETESYNC_CONNECTION (connection), NULL);
-
-	return connection->priv->etebase_client;
-}
-
-EtebaseAccount *
-e_etesync_connection_get_etebase_account (EEteSyncConnection *connection)
-{
-	g_return_val_if_fail (E_IS_ETESYNC_CONNECTION (connection), NULL);
-
-	return connection->priv->etebase_account;
-}
-
-EtebaseCollectionManager *
-e_etesync_connection_get_collection_manager (EEteSyncConnection *connection)
-{
-	g_return_val_if_fail (E_IS_ETESYNC_CONNECTION (connection), NULL);
-
-	return connection->priv->col_mgr;
-}
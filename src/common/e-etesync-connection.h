@@ -48,6 +48,16 @@ struct _EEteSyncConnectionClass {
 	GObjectClass parent_class;
 };
 
+/* Called for each listed page of items by e_etesync_connection_list_existing_sync();
+   the 'page_objects' (EBookMetaBackendInfo* or ECalMetaBackendInfo*) are in the server
+   order and the function takes their ownership, the 'stoken' can be used to continue
+   the listing after this page. */
+typedef gboolean (* EEteSyncListPageFunc)	(GSList *page_objects,
+						 const gchar *stoken,
+						 gpointer user_data,
+						 GCancellable *cancellable,
+						 GError **error);
+
 EEteSyncConnection *
 		e_etesync_connection_new	(ESource *collection);
 ESourceAuthenticationResult
@@ -66,6 +76,12 @@ gboolean	e_etesync_connection_login_connection_sync
 						 EtebaseErrorCode *out_etebase_error);
 gboolean	e_etesync_connection_is_connected
 						(EEteSyncConnection *connection);
+gboolean	e_etesync_connection_fetch_token_sync
+						(EEteSyncConnection *connection,
+						 EtebaseErrorCode *out_etebase_error,
+						 GError **error);
+void		e_etesync_connection_logout_sync
+						(EEteSyncConnection *connection);
 gboolean	e_etesync_connection_reconnect_sync
 						(EEteSyncConnection *connection,
 						 ESourceAuthenticationResult *out_result,
@@ -74,8 +90,37 @@ gboolean	e_etesync_connection_reconnect_sync
 gboolean	e_etesync_connection_maybe_reconnect_sync
 						(EEteSyncConnection *connection,
 						 EBackend *backend,
+						 gint rejected_generation,
 						 GCancellable *cancellable,
 						 GError **error);
+EtebaseCollectionManager *
+		e_etesync_connection_dup_collection_manager
+						(EEteSyncConnection *connection,
+						 gint *out_session_generation);
+EtebaseCollectionListResponse *
+		e_etesync_connection_collection_list_sync
+						(EEteSyncConnection *connection,
+						 const EtebaseCollectionManager *col_mgr,
+						 EtebaseFetchOptions *fetch_options);
+EtebaseCollection *
+		e_etesync_connection_dup_collection
+						(EEteSyncConnection *connection,
+						 const gchar *col_uid,
+						 const gchar *col_obj_b64);
+gboolean	e_etesync_connection_update_collection_from_source
+						(EEteSyncConnection *connection,
+						 ESource *source,
+						 EtebaseCollection **inout_col_obj);
+void		e_etesync_connection_set_collection
+						(EEteSyncConnection *connection,
+						 const EtebaseCollection *col_obj,
+						 const gchar *col_obj_b64);
+gchar *		e_etesync_connection_collection_to_base64
+						(EEteSyncConnection *connection,
+						 const EtebaseCollection *col_obj);
+void		e_etesync_connection_forget_collection
+						(EEteSyncConnection *connection,
+						 const gchar *col_uid);
 gboolean	e_etesync_connection_collection_create_upload_sync
 						(EEteSyncConnection *connection,
 						 EBackend *backend,
@@ -104,6 +149,9 @@ gboolean	e_etesync_connection_list_existing_sync
 						 EBackend *backend,
 						 const EteSyncType type,
 						 const EtebaseCollection *col_obj,
+						 const gchar *resume_stoken,
+						 EEteSyncListPageFunc page_func,
+						 gpointer page_func_user_data,
 						 gchar **out_new_sync_tag,
 						 GSList **out_existing_objects,
 						 GCancellable *cancellable,
@@ -116,12 +164,23 @@ gboolean	e_etesync_connection_get_changes_sync
 						 const EtebaseCollection *col_obj,
 						 ECache *cache,
 						 gchar **out_new_sync_tag,
+						 gboolean *out_repeat,
 						 GSList **out_created_objects, /* EBookMetaBackendInfo* or ECalMetaBackendInfo* */
 						 GSList **out_modified_objects, /* EBookMetaBackendInfo* or ECalMetaBackendInfo* */
 						 GSList **out_removed_objects,
 						 GCancellable *cancellable,
 						 GError **error);
-gboolean	e_etesync_connection_item_upload_sync
+gboolean	e_etesync_connection_item_fetch_sync
+						(EEteSyncConnection *connection,
+						 EBackend *backend,
+						 const EteSyncType type,
+						 const EtebaseCollection *col_obj,
+						 const gchar *uid,
+						 const gchar *extra,
+						 gpointer *out_info, /* EBookMetaBackendInfo* or ECalMetaBackendInfo* */
+						 GCancellable *cancellable,
+						 GError **error);
+gboolean	e_etesync_connection_item_queue_sync
 						(EEteSyncConnection *connection,
 						 EBackend *backend,
 						 const EtebaseCollection *col_obj,
@@ -129,10 +188,25 @@ gboolean	e_etesync_connection_item_upload_sync
 						 const gchar *content,
 						 const gchar *uid,
 						 const gchar *extra,
+						 EConflictResolution conflict_resolution,
 						 gchar **out_new_uid,
 						 gchar **out_new_extra,
 						 GCancellable *cancellable,
 						 GError **error);
+gboolean	e_etesync_connection_queued_items_upload_sync
+						(EEteSyncConnection *connection,
+						 EBackend *backend,
+						 const EteSyncType type,
+						 const EtebaseCollection *col_obj,
+						 gboolean *out_done,
+						 GSList **out_modified_objects, /* EBookMetaBackendInfo* or ECalMetaBackendInfo* */
+						 GSList **out_removed_objects, /* EBookMetaBackendInfo* or ECalMetaBackendInfo* */
+						 GCancellable *cancellable,
+						 GError **error);
+/* The batch functions can succeed only partially: the 'out_batch_info' has the infos of the
+   items, which were stored on the server, in the order of the 'content', also when FALSE is
+   returned for the items, which failed, with the error of the first of them. The caller is
+   expected to apply the 'out_batch_info' to its cache in both cases. */
 gboolean	e_etesync_connection_batch_create_sync
 						(EEteSyncConnection *connection,
 						 EBackend *backend,
@@ -172,22 +246,10 @@ GType		e_etesync_connection_get_type	(void) G_GNUC_CONST;
 const gchar *	e_etesync_connection_get_token	(EEteSyncConnection *connection);
 const gchar *	e_etesync_connection_get_derived_key
 						(EEteSyncConnection *connection);
-const gchar *
-		e_etesync_connection_get_session_key
+gchar *		e_etesync_connection_dup_session_key
 						(EEteSyncConnection *connection);
-void		e_etesync_connection_set_session_key
-						(EEteSyncConnection *connection,
-						 const gchar* session_key);
 gboolean 	e_etesync_connection_get_requested_credentials
 						(EEteSyncConnection *connection);
-EtebaseClient *	e_etesync_connection_get_etebase_client
-						(EEteSyncConnection *connection);
-EtebaseAccount *
-		e_etesync_connection_get_etebase_account
-						(EEteSyncConnection *connection);
-EtebaseCollectionManager *
-		e_etesync_connection_get_collection_manager
-						(EEteSyncConnection *connection);
 
 G_END_DECLS
 
@@ -21,6 +21,13 @@ typedef enum {
 
 #define E_ETESYNC_CREDENTIAL_SESSION_KEY "session_key"
 
+/* ECache key with the stoken to resume an interrupted listing of all items */
+#define E_ETESYNC_CACHE_KEY_LIST_STOKEN "etesync-list-stoken"
+/* ECache key with the collection stoken known before the last complete listing of the changes */
+#define E_ETESYNC_CACHE_KEY_COLLECTION_STOKEN "etesync-collection-stoken"
+/* Prefix of the 'extra' of the stored objects, followed by the item UID and its etag */
+#define E_ETESYNC_ITEM_EXTRA_PREFIX "etebase-item-v2:"
+
 #define E_ETESYNC_COLLECTION_TYPE_CALENDAR "etebase.vevent"
 #define E_ETESYNC_COLLECTION_TYPE_ADDRESS_BOOK "etebase.vcard"
 #define E_ETESYNC_COLLECTION_TYPE_TASKS "etebase.vtodo"
@@ -29,7 +36,16 @@ typedef enum {
 #define E_ETESYNC_COLLECTION_DEFAULT_COLOR "#8BC34A"
 
 #define E_ETESYNC_COLLECTION_FETCH_LIMIT 30
+#define E_ETESYNC_COLLECTION_CHECK_INTERVAL 30 /* seconds */
 #define E_ETESYNC_ITEM_FETCH_LIMIT 50
+#define E_ETESYNC_ITEM_FETCH_QUEUE_LENGTH 2
 #define E_ETESYNC_ITEM_PUSH_LIMIT 30
+#define E_ETESYNC_ITEM_PUSH_SIZE_LIMIT (900 * 1024) /* bytes, below the common 1 MB request limit */
+#define E_ETESYNC_ITEM_CACHE_SIZE 128
+#define E_ETESYNC_MAX_REQUESTS 4 /* concurrent requests of one account */
+
+#define E_ETESYNC_OUTBOX_DELAY 500 /* milliseconds */
+#define E_ETESYNC_TOKEN_REFRESH_INTERVAL (12 * 60 * 60) /* seconds */
+#define E_ETESYNC_OUTBOX_RETRY_DELAY 30 /* seconds */
 
 #endif /* E_ETESYNC_DEFINES_H */
@@ -0,0 +1,161 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/* e-etesync-executor.c - Limits the concurrent requests to the server of one account.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "evolution-etesync-config.h"
+
+#include "e-etesync-executor.h"
+
+struct _EEteSyncExecutor {
+	volatile gint ref_count;
+
+	GMutex lock;
+	GCond cond;
+	guint max_requests;
+	guint n_running;
+	guint n_waiting;
+	guint n_waiting_interactive;
+};
+
+static gboolean
+e_etesync_executor_kind_is_interactive (EEteSyncRequestKind kind)
+{
+	return kind == E_ETESYNC_REQUEST_FETCH;
+}
+
+/* Returns a new executor, which lets at most 'max_requests' requests run
+   at the same time; free it with e_etesync_executor_unref() */
+EEteSyncExecutor *
+e_etesync_executor_new (guint max_requests)
+{
+	EEteSyncExecutor *executor;
+
+	executor = g_slice_new0 (EEteSyncExecutor);
+	executor->ref_count = 1;
+	executor->max_requests = MAX (max_requests, 1);
+	g_mutex_init (&executor->lock);
+	g_cond_init (&executor->cond);
+
+	return executor;
+}
+
+EEteSyncExecutor *
+e_etesync_executor_ref (EEteSyncExecutor *executor)
+{
+	g_return_val_if_fail (executor != NULL, NULL);
+
+	g_atomic_int_inc (&executor->ref_count);
+
+	return executor;
+}
+
+void
+e_etesync_executor_unref (EEteSyncExecutor *executor)
+{
+	if (!executor)
+		return;
+
+	if (g_atomic_int_dec_and_test (&executor->ref_count)) {
+		g_mutex_clear (&executor->lock);
+		g_cond_clear (&executor->cond);
+		g_slice_free (EEteSyncExecutor, executor);
+	}
+}
+
+guint
+e_etesync_executor_get_max_requests (EEteSyncExecutor *executor)
+{
+	guint max_requests;
+
+	g_return_val_if_fail (executor != NULL, 0);
+
+	g_mutex_lock (&executor->lock);
+	max_requests = executor->max_requests;
+	g_mutex_unlock (&executor->lock);
+
+	return max_requests;
+}
+
+void
+e_etesync_executor_set_max_requests (EEteSyncExecutor *executor,
+				     guint max_requests)
+{
+	g_return_if_fail (executor != NULL);
+
+	g_mutex_lock (&executor->lock);
+
+	executor->max_requests = MAX (max_requests, 1);
+
+	/* more requests can run now */
+	g_cond_broadcast (&executor->cond);
+
+	g_mutex_unlock (&executor->lock);
+}
+
+/* Returns how many requests are waiting in e_etesync_executor_begin_request() */
+guint
+e_etesync_executor_get_n_waiting (EEteSyncExecutor *executor)
+{
+	guint n_waiting;
+
+	g_return_val_if_fail (executor != NULL, 0);
+
+	g_mutex_lock (&executor->lock);
+	n_waiting = executor->n_waiting;
+	g_mutex_unlock (&executor->lock);
+
+	return n_waiting;
+}
+
+/* Waits until the request of the 'kind' can be sent to the server; the interactive
+   requests are let in before the waiting background requests. Each call should
+   be paired with e_etesync_executor_end_request(), once the response is received.
+   The calls cannot be nested, the request would wait for itself. */
+void
+e_etesync_executor_begin_request (EEteSyncExecutor *executor,
+				  EEteSyncRequestKind kind)
+{
+	g_return_if_fail (executor != NULL);
+
+	g_mutex_lock (&executor->lock);
+
+	executor->n_waiting++;
+
+	if (e_etesync_executor_kind_is_interactive (kind)) {
+		executor->n_waiting_interactive++;
+
+		while (executor->n_running >= executor->max_requests)
+			g_cond_wait (&executor->cond, &executor->lock);
+
+		executor->n_waiting_interactive--;
+	} else {
+		while (executor->n_running >= executor->max_requests ||
+		       executor->n_waiting_interactive > 0)
+			g_cond_wait (&executor->cond, &executor->lock);
+	}
+
+	executor->n_waiting--;
+	executor->n_running++;
+
+	g_mutex_unlock (&executor->lock);
+}
+
+void
+e_etesync_executor_end_request (EEteSyncExecutor *executor,
+				EEteSyncRequestKind kind)
+{
+	g_return_if_fail (executor != NULL);
+
+	g_mutex_lock (&executor->lock);
+
+	g_warn_if_fail (executor->n_running > 0);
+
+	if (executor->n_running > 0)
+		executor->n_running--;
+
+	g_cond_broadcast (&executor->cond);
+
+	g_mutex_unlock (&executor->lock);
+}
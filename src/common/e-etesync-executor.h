@@ -0,0 +1,46 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/* e-etesync-executor.h
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#ifndef E_ETESYNC_EXECUTOR_H
+#define E_ETESYNC_EXECUTOR_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* The kinds of the requests to the server; the fetch of an item is done
+   for the user, thus it is interactive and runs before the waiting
+   background requests */
+typedef enum {
+	E_ETESYNC_REQUEST_LIST_PAGE,
+	E_ETESYNC_REQUEST_BATCH,
+	E_ETESYNC_REQUEST_FETCH,
+	E_ETESYNC_REQUEST_COLLECTION_LIST
+} EEteSyncRequestKind;
+
+typedef struct _EEteSyncExecutor EEteSyncExecutor;
+
+EEteSyncExecutor *
+		e_etesync_executor_new		(guint max_requests);
+EEteSyncExecutor *
+		e_etesync_executor_ref		(EEteSyncExecutor *executor);
+void		e_etesync_executor_unref	(EEteSyncExecutor *executor);
+guint		e_etesync_executor_get_max_requests
+						(EEteSyncExecutor *executor);
+void		e_etesync_executor_set_max_requests
+						(EEteSyncExecutor *executor,
+						 guint max_requests);
+guint		e_etesync_executor_get_n_waiting
+						(EEteSyncExecutor *executor);
+void		e_etesync_executor_begin_request
+						(EEteSyncExecutor *executor,
+						 EEteSyncRequestKind kind);
+void		e_etesync_executor_end_request	(EEteSyncExecutor *executor,
+						 EEteSyncRequestKind kind);
+
+G_END_DECLS
+
+#endif /* E_ETESYNC_EXECUTOR_H */
@@ -0,0 +1,170 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/* e-etesync-outbox.c - Coalesces single object changes into batched uploads.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "evolution-etesync-config.h"
+
+#include "e-etesync-defines.h"
+#include "e-etesync-outbox.h"
+
+/* The changes themselves are stored in the cache by the caller, thus they survive
+   a restart; the outbox only decides when to upload them. The upload starts once
+   E_ETESYNC_OUTBOX_DELAY passed since the first scheduled change, or right away,
+   when there is enough of them to fill a whole batch. */
+struct _EEteSyncOutbox {
+	EEteSyncOutboxUploadFunc upload_func;
+	EEteSyncOutboxErrorFunc error_func;
+	gpointer user_data;
+
+	GMutex lock;
+	GCond cond;
+	GThread *thread;
+	GCancellable *cancellable;
+	gboolean stop;
+
+	guint n_scheduled; /* changes scheduled since the last upload */
+	gint64 upload_time; /* monotonic time to upload them at */
+	gboolean failing; /* the last upload failed and it had been reported */
+};
+
+static gpointer
+e_etesync_outbox_thread (gpointer user_data)
+{
+	EEteSyncOutbox *outbox = user_data;
+
+	g_mutex_lock (&outbox->lock);
+
+	while (!outbox->stop) {
+		GError *local_error = NULL;
+		gboolean success;
+
+		if (!outbox->n_scheduled) {
+			g_cond_wait (&outbox->cond, &outbox->lock);
+			continue;
+		}
+
+		if (outbox->n_scheduled < E_ETESYNC_ITEM_PUSH_LIMIT &&
+		    g_get_monotonic_time () < outbox->upload_time) {
+			g_cond_wait_until (&outbox->cond, &outbox->lock, outbox->upload_time);
+			continue;
+		}
+
+		outbox->n_scheduled = 0;
+
+		g_mutex_unlock (&outbox->lock);
+
+		success = e_etesync_outbox_flush_sync (outbox, outbox->cancellable, &local_error);
+
+		g_mutex_lock (&outbox->lock);
+
+		/* try again later; the changes are still stored */
+		if (!success && !outbox->stop) {
+			if (!outbox->failing && outbox->error_func) {
+				g_mutex_unlock (&outbox->lock);
+				outbox->error_func (outbox->user_data, local_error);
+				g_mutex_lock (&outbox->lock);
+			}
+
+			outbox->failing = TRUE;
+
+			if (!outbox->n_scheduled)
+				outbox->n_scheduled = 1;
+			outbox->upload_time = g_get_monotonic_time () + E_ETESYNC_OUTBOX_RETRY_DELAY * G_TIME_SPAN_SECOND;
+		} else if (success) {
+			outbox->failing = FALSE;
+		}
+
+		g_clear_error (&local_error);
+	}
+
+	g_mutex_unlock (&outbox->lock);
+
+	return NULL;
+}
+
+/* The 'upload_func' is called from a dedicated thread, or from
+   the e_etesync_outbox_flush_sync() caller; the 'error_func' is optional */
+EEteSyncOutbox *
+e_etesync_outbox_new (EEteSyncOutboxUploadFunc upload_func,
+		      EEteSyncOutboxErrorFunc error_func,
+		      gpointer user_data)
+{
+	EEteSyncOutbox *outbox;
+
+	g_return_val_if_fail (upload_func != NULL, NULL);
+
+	outbox = g_slice_new0 (EEteSyncOutbox);
+	outbox->upload_func = upload_func;
+	outbox->error_func = error_func;
+	outbox->user_data = user_data;
+	outbox->cancellable = g_cancellable_new ();
+
+	g_mutex_init (&outbox->lock);
+	g_cond_init (&outbox->cond);
+
+	return outbox;
+}
+
+/* Stops the uploads; the changes not uploaded yet are left in the cache */
+void
+e_etesync_outbox_free (EEteSyncOutbox *outbox)
+{
+	if (!outbox)
+		return;
+
+	g_mutex_lock (&outbox->lock);
+	outbox->stop = TRUE;
+	g_cancellable_cancel (outbox->cancellable);
+	g_cond_signal (&outbox->cond);
+	g_mutex_unlock (&outbox->lock);
+
+	if (outbox->thread)
+		g_thread_join (outbox->thread);
+
+	g_object_unref (outbox->cancellable);
+	g_mutex_clear (&outbox->lock);
+	g_cond_clear (&outbox->cond);
+	g_slice_free (EEteSyncOutbox, outbox);
+}
+
+/* Notes a new change had been queued, to be uploaded with the others in the background */
+void
+e_etesync_outbox_schedule (EEteSyncOutbox *outbox)
+{
+	g_return_if_fail (outbox != NULL);
+
+	g_mutex_lock (&outbox->lock);
+
+	if (!outbox->stop) {
+		if (!outbox->n_scheduled)
+			outbox->upload_time = g_get_monotonic_time () + E_ETESYNC_OUTBOX_DELAY * G_TIME_SPAN_MILLISECOND;
+
+		outbox->n_scheduled++;
+
+		if (!outbox->thread)
+			outbox->thread = g_thread_new ("etesync-outbox", e_etesync_outbox_thread, outbox);
+		else
+			g_cond_signal (&outbox->cond);
+	}
+
+	g_mutex_unlock (&outbox->lock);
+}
+
+/* Uploads all the queued changes now, in batches */
+gboolean
+e_etesync_outbox_flush_sync (EEteSyncOutbox *outbox,
+			     GCancellable *cancellable,
+			     GError **error)
+{
+	gboolean done = FALSE;
+	gboolean success = TRUE;
+
+	g_return_val_if_fail (outbox != NULL, FALSE);
+
+	while (success && !done)
+		success = outbox->upload_func (outbox->user_data, &done, cancellable, error);
+
+	return success;
+}
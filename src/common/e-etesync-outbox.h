@@ -0,0 +1,40 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/* e-etesync-outbox.h
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#ifndef E_ETESYNC_OUTBOX_H
+#define E_ETESYNC_OUTBOX_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef struct _EEteSyncOutbox EEteSyncOutbox;
+
+/* Uploads one batch of the queued changes; sets 'out_done' to TRUE,
+   when there is nothing more to upload */
+typedef gboolean (* EEteSyncOutboxUploadFunc)	(gpointer user_data,
+						 gboolean *out_done,
+						 GCancellable *cancellable,
+						 GError **error);
+
+/* Called from the outbox thread, when its uploads start to fail; it is not called
+   again for the retries, until an upload succeeds */
+typedef void	(* EEteSyncOutboxErrorFunc)	(gpointer user_data,
+						 const GError *error);
+
+EEteSyncOutbox *
+		e_etesync_outbox_new		(EEteSyncOutboxUploadFunc upload_func,
+						 EEteSyncOutboxErrorFunc error_func,
+						 gpointer user_data);
+void		e_etesync_outbox_free		(EEteSyncOutbox *outbox);
+void		e_etesync_outbox_schedule	(EEteSyncOutbox *outbox);
+gboolean	e_etesync_outbox_flush_sync	(EEteSyncOutbox *outbox,
+						 GCancellable *cancellable,
+						 GError **error);
+
+G_END_DECLS
+
+#endif /* E_ETESYNC_OUTBOX_H */
@@ -10,6 +10,315 @@
 #include <glib/gi18n-lib.h>
 #include "e-etesync-service.h"
 
+/* The secrets are cached in the process, thus the secret store is not asked on each
+   reconnect, and the changes of the secret store are written in a background thread,
+   in the order of the calls; the synchronous stores and the deletes wait for their turn */
+typedef struct _CachedSecret {
+	gchar *secret; /* NULL, when it's going to be deleted */
+	guint n_pending; /* the stores and deletes not written yet */
+} CachedSecret;
+
+typedef struct _StoreData {
+	gchar *uid;
+	gchar *label;
+	gchar *secret; /* NULL to delete the secret */
+	gboolean permanently;
+	GCancellable *cancellable;
+
+	/* used, when the caller waits for the result */
+	gboolean wait;
+	GMutex lock;
+	GCond cond;
+	gboolean done;
+	gboolean abandoned; /* the caller was cancelled, the thread frees the data */
+	gboolean success;
+	GError *error;
+} StoreData;
+
+G_LOCK_DEFINE_STATIC (secrets);
+static GHashTable *secrets = NULL; /* gchar *uid ~> CachedSecret * */
+static GThreadPool *store_pool = NULL;
+
+/* counts the queued changes of the secret store, for e_etesync_service_wait_stores() */
+static GMutex stores_lock;
+static GCond stores_cond;
+static guint n_stores = 0;
+
+static void
+cached_secret_free (gpointer ptr)
+{
+	CachedSecret *cached = ptr;
+
+	if (cached) {
+		e_util_safe_free_string (cached->secret);
+		g_slice_free (CachedSecret, cached);
+	}
+}
+
+static void
+store_data_free (StoreData *data)
+{
+	if (data) {
+		g_free (data->uid);
+		g_free (data->label);
+		e_util_safe_free_string (data->secret);
+		g_clear_object (&data->cancellable);
+		g_clear_error (&data->error);
+		g_mutex_clear (&data->lock);
+		g_cond_clear (&data->cond);
+		g_slice_free (StoreData, data);
+	}
+}
+
+/* Sets the cached secret for the 'uid', which is going to be written into the secret
+   store; the 'secret' can be NULL, when it's going to be deleted. Call with the lock held. */
+static void
+e_etesync_service_cache_pending_secret_locked (const gchar *uid,
+					       const gchar *secret)
+{
+	CachedSecret *cached;
+
+	if (!secrets)
+		secrets = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, cached_secret_free);
+
+	cached = g_hash_table_lookup (secrets, uid);
+
+	if (!cached) {
+		cached = g_slice_new0 (CachedSecret);
+		g_hash_table_insert (secrets, g_strdup (uid), cached);
+	}
+
+	if (g_strcmp0 (cached->secret, secret) != 0) {
+		e_util_safe_free_string (cached->secret);
+		cached->secret = g_strdup (secret);
+	}
+
+	cached->n_pending++;
+}
+
+/* Sets 'out_secret' to a copy of the cached secret for the 'uid' and returns TRUE,
+   or returns FALSE, when it's not cached. The 'out_secret' is set to NULL, when
+   the secret is going to be deleted. */
+static gboolean
+e_etesync_service_dup_cached_secret (const gchar *uid,
+				     gchar **out_secret)
+{
+	CachedSecret *cached;
+	gboolean found = FALSE;
+
+	*out_secret = NULL;
+
+	G_LOCK (secrets);
+
+	cached = secrets ? g_hash_table_lookup (secrets, uid) : NULL;
+
+	if (cached && (cached->secret || cached->n_pending)) {
+		*out_secret = g_strdup (cached->secret);
+		found = TRUE;
+	}
+
+	G_UNLOCK (secrets);
+
+	return found;
+}
+
+static gboolean
+e_etesync_service_lookup_secret_sync (const gchar *uid,
+				      gchar **out_secret,
+				      GCancellable *cancellable,
+				      GError **error)
+{
+	CachedSecret *cached;
+
+	if (e_etesync_service_dup_cached_secret (uid, out_secret))
+		return TRUE;
+
+	if (!e_secret_store_lookup_sync (uid, out_secret, cancellable, error))
+		return FALSE;
+
+	if (*out_secret) {
+		G_LOCK (secrets);
+
+		if (!secrets)
+			secrets = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, cached_secret_free);
+
+		/* a store or a delete could be queued meanwhile, then it's newer */
+		if (!g_hash_table_contains (secrets, uid)) {
+			cached = g_slice_new0 (CachedSecret);
+			cached->secret = g_strdup (*out_secret);
+			g_hash_table_insert (secrets, g_strdup (uid), cached);
+		}
+
+		G_UNLOCK (secrets);
+	}
+
+	return TRUE;
+}
+
+static void
+e_etesync_service_store_thread (gpointer data,
+				gpointer user_data)
+{
+	StoreData *sd = data;
+	CachedSecret *cached;
+	GError *local_error = NULL;
+	gboolean success;
+
+	if (sd->secret)
+		success = e_secret_store_store_sync (sd->uid, sd->secret, sd->label, sd->permanently, sd->cancellable, &local_error);
+	else
+		success = e_secret_store_delete_sync (sd->uid, sd->cancellable, &local_error);
+
+	G_LOCK (secrets);
+
+	cached = secrets ? g_hash_table_lookup (secrets, sd->uid) : NULL;
+
+	if (cached && cached->n_pending)
+		cached->n_pending--;
+
+	/* the deleted secret is not cached, neither the secret, which failed to be stored */
+	if (cached && !cached->n_pending && (!cached->secret || !success))
+		g_hash_table_remove (secrets, sd->uid);
+
+	G_UNLOCK (secrets);
+
+	g_mutex_lock (&stores_lock);
+	n_stores--;
+	if (!n_stores)
+		g_cond_broadcast (&stores_cond);
+	g_mutex_unlock (&stores_lock);
+
+	if (sd->wait) {
+		gboolean abandoned;
+
+		g_mutex_lock (&sd->lock);
+		abandoned = sd->abandoned;
+		sd->success = success;
+		sd->error = local_error;
+		sd->done = TRUE;
+		g_cond_signal (&sd->cond);
+		g_mutex_unlock (&sd->lock);
+
+		if (abandoned)
+			store_data_free (sd);
+	} else {
+		if (!success) {
+			g_warning ("%s: Failed to store credentials: %s", G_STRFUNC, local_error ? local_error->message : "Unknown error");
+			g_clear_error (&local_error);
+		}
+
+		store_data_free (sd);
+	}
+}
+
+static void
+e_etesync_service_store_cancelled_cb (GCancellable *cancellable,
+				      gpointer user_data)
+{
+	StoreData *sd = user_data;
+
+	g_mutex_lock (&sd->lock);
+	g_cond_signal (&sd->cond);
+	g_mutex_unlock (&sd->lock);
+}
+
+/* Waits for the queued changes of the secret store to be written; the backends
+   call it when they are disposed, thus the last stored token is not lost */
+void
+e_etesync_service_wait_stores (void)
+{
+	g_mutex_lock (&stores_lock);
+	while (n_stores)
+		g_cond_wait (&stores_cond, &stores_lock);
+	g_mutex_unlock (&stores_lock);
+}
+
+/* Queues the change of the secret store for the 'uid'; the 'secret' is NULL to delete
+   it. With the 'wait' it returns after the change is written, with its result, or when
+   the 'cancellable' is cancelled; the change is still written then, unless the write
+   itself is cancelled. */
+static gboolean
+e_etesync_service_queue_secret_sync (const gchar *uid,
+				     const gchar *label,
+				     gchar *secret, /* (transfer full) */
+				     gboolean permanently,
+				     gboolean wait,
+				     GCancellable *cancellable,
+				     GError **error)
+{
+	StoreData *sd;
+	gulong cancelled_id = 0;
+	gboolean success = TRUE;
+
+	if (wait && g_cancellable_set_error_if_cancelled (cancellable, error)) {
+		e_util_safe_free_string (secret);
+		return FALSE;
+	}
+
+	sd = g_slice_new0 (StoreData);
+	sd->uid = g_strdup (uid);
+	sd->label = g_strdup (label);
+	sd->secret = secret;
+	sd->permanently = permanently;
+	sd->cancellable = wait && cancellable ? g_object_ref (cancellable) : NULL;
+	sd->wait = wait;
+	g_mutex_init (&sd->lock);
+	g_cond_init (&sd->cond);
+
+	g_mutex_lock (&stores_lock);
+	n_stores++;
+	g_mutex_unlock (&stores_lock);
+
+	G_LOCK (secrets);
+
+	e_etesync_service_cache_pending_secret_locked (uid, secret);
+
+	/* one thread, to write the changes in order */
+	if (!store_pool)
+		store_pool = g_thread_pool_new (e_etesync_service_store_thread, NULL, 1, FALSE, NULL);
+
+	g_thread_pool_push (store_pool, sd, NULL);
+
+	G_UNLOCK (secrets);
+
+	if (wait) {
+		gboolean done;
+
+		if (cancellable)
+			cancelled_id = g_cancellable_connect (cancellable, G_CALLBACK (e_etesync_service_store_cancelled_cb), sd, NULL);
+
+		g_mutex_lock (&sd->lock);
+		while (!sd->done && !g_cancellable_is_cancelled (cancellable))
+			g_cond_wait (&sd->cond, &sd->lock);
+		g_mutex_unlock (&sd->lock);
+
+		/* before the thread can free the 'sd' */
+		if (cancelled_id)
+			g_cancellable_disconnect (cancellable, cancelled_id);
+
+		g_mutex_lock (&sd->lock);
+		done = sd->done;
+		sd->abandoned = !done;
+		g_mutex_unlock (&sd->lock);
+
+		if (done) {
+			success = sd->success;
+
+			if (sd->error) {
+				g_propagate_error (error, sd->error);
+				sd->error = NULL;
+			}
+
+			store_data_free (sd);
+		} else {
+			success = FALSE;
+			g_cancellable_set_error_if_cancelled (cancellable, error);
+		}
+	}
+
+	return success;
+}
+
 gboolean
 e_etesync_service_store_credentials_sync (const gchar *uid,
 					  const gchar *label,
@@ -18,7 +327,6 @@ e_etesync_service_store_credentials_sync (const gchar *uid,
 					  GCancellable *cancellable,
 					  GError **error)
 {
-	gboolean success = FALSE;
 	gchar *secret = NULL;
 
 	g_return_val_if_fail (uid != NULL, FALSE);
@@ -27,12 +335,51 @@ e_etesync_service_store_credentials_sync (const gchar *uid,
 
 	secret = e_named_parameters_to_string (credentials);
 
+	if (!secret)
+		return FALSE;
+
+	/* after the stores queued before it */
+	return e_etesync_service_queue_secret_sync (uid, label, secret, permanently, TRUE, cancellable, error);
+}
+
+/* Updates the cached credentials right away and writes them into the secret
+   store in a background thread, thus the caller does not wait for it */
+void
+e_etesync_service_store_credentials (const gchar *uid,
+				     const gchar *label,
+				     const ENamedParameters *credentials,
+				     gboolean permanently)
+{
+	gchar *secret;
+
+	g_return_if_fail (uid != NULL);
+	g_return_if_fail (label != NULL);
+	g_return_if_fail (credentials != NULL);
+
+	secret = e_named_parameters_to_string (credentials);
+
 	if (secret)
-		success = e_secret_store_store_sync (uid, secret, label, permanently, cancellable, error);
+		e_etesync_service_queue_secret_sync (uid, label, secret, permanently, FALSE, NULL, NULL);
+}
 
-	e_util_safe_free_string (secret);
+/* Drops the cached credentials of the 'uid', thus the next lookup reads them
+   from the secret store, where another process could change them; the credentials
+   waiting to be written are kept, they are newer than those in the secret store */
+void
+e_etesync_service_forget_cached_credentials (const gchar *uid)
+{
+	CachedSecret *cached;
 
-	return success;
+	g_return_if_fail (uid != NULL);
+
+	G_LOCK (secrets);
+
+	cached = secrets ? g_hash_table_lookup (secrets, uid) : NULL;
+
+	if (cached && !cached->n_pending)
+		g_hash_table_remove (secrets, uid);
+
+	G_UNLOCK (secrets);
 }
 
 gboolean
@@ -46,7 +393,7 @@ e_etesync_service_lookup_credentials_sync (const gchar *uid,
 
 	g_return_val_if_fail (uid != NULL, FALSE);
 
-	if (!e_secret_store_lookup_sync (uid, &secret, cancellable, error))
+	if (!e_etesync_service_lookup_secret_sync (uid, &secret, cancellable, error))
 		return FALSE;
 
 	if (!secret) {
@@ -75,7 +422,7 @@ e_etesync_service_lookup_password_sync (const gchar *uid,
 
 	g_return_val_if_fail (uid != NULL, FALSE);
 
-	if (!e_secret_store_lookup_sync (uid, &secret, cancellable, error))
+	if (!e_etesync_service_lookup_secret_sync (uid, &secret, cancellable, error))
 		return FALSE;
 
 	if (!secret) {
@@ -100,5 +447,6 @@ e_etesync_service_delete_sync (const gchar *uid,
 {
 	g_return_val_if_fail (uid != NULL, FALSE);
 
-	return e_secret_store_delete_sync (uid, cancellable, error);;
+	/* after the stores queued before it, thus they do not write the secret back */
+	return e_etesync_service_queue_secret_sync (uid, NULL, NULL, FALSE, TRUE, cancellable, error);
 }
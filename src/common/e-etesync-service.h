@@ -19,6 +19,14 @@ gboolean	e_etesync_service_store_credentials_sync
 						 gboolean permanently,
 						 GCancellable *cancellable,
 						 GError **error);
+void		e_etesync_service_store_credentials
+						(const gchar *uid,
+						 const gchar *label,
+						 const ENamedParameters *credentials,
+						 gboolean permanently);
+void		e_etesync_service_wait_stores	(void);
+void		e_etesync_service_forget_cached_credentials
+						(const gchar *uid);
 gboolean	e_etesync_service_lookup_credentials_sync
 						(const gchar *uid,
 						 ENamedParameters **out_credentials,
@@ -7,9 +7,12 @@
 
 #include "evolution-etesync-config.h"
 
+#include <string.h>
+
 #include <libedata-book/libedata-book.h>
 #include <libedata-cal/libedata-cal.h>
 #include "e-etesync-defines.h"
+#include "e-source-etesync.h"
 #include "e-etesync-utils.h"
 
 static const gchar *const collection_supported_types[] = {
@@ -29,19 +32,198 @@ e_etesync_utils_get_time_now (time_t *now)
 	*now = g_get_real_time() / 1000;
 }
 
+static gboolean
+e_etesync_utils_scan_name_equal (const gchar *name,
+				 gsize name_len,
+				 const gchar *expected)
+{
+	return strlen (expected) == name_len && g_ascii_strncasecmp (name, expected, name_len) == 0;
+}
+
+/* Returns the value of a property, which starts at 'value' and ends at 'value_end';
+   when 'folded', then the continuation lines up to 'line_end' are added to it */
+static gchar *
+e_etesync_utils_scan_dup_value (const gchar *value,
+				const gchar *value_end,
+				const gchar *line_end,
+				gboolean folded)
+{
+	GString *str;
+	const gchar *ptr;
+
+	if (!folded)
+		return g_strndup (value, value_end - value);
+
+	str = g_string_sized_new (line_end - value);
+
+	for (ptr = value; ptr < line_end; ptr++) {
+		if (*ptr == '\r')
+			continue;
+
+		/* skip the line break and the first white space of the continuation line */
+		if (*ptr == '\n') {
+			ptr++;
+			continue;
+		}
+
+		g_string_append_c (str, *ptr);
+	}
+
+	return g_string_free (str, FALSE);
+}
+
+/* Scans the vCard/iCalendar 'content' line by line and looks for the UID and the 'rev_name'
+   property of the first component named one of the 'comp_names' at the 'comp_depth' nesting
+   level, without parsing the whole content. Returns FALSE when the content is not well-formed
+   or something, which requires the full parser, like property parameters or escaped values,
+   is found in the properties. */
+static gboolean
+e_etesync_utils_scan_uid_revision (const gchar *content,
+				   const gchar *root_name,
+				   const gchar *const *comp_names,
+				   gint comp_depth,
+				   const gchar *rev_name,
+				   gchar **out_uid,
+				   gchar **out_revision)
+{
+	const gchar *line = content;
+	gint depth = 0, target_depth = -1;
+	gboolean seen_root = FALSE, seen_target = FALSE;
+
+	*out_uid = NULL;
+	*out_revision = NULL;
+
+	while (line && *line && !(*out_uid && *out_revision)) {
+		const gchar *eol, *line_end, *phys_end, *name, *name_end, *value;
+		gboolean folded = FALSE;
+		gsize name_len;
+
+		/* unfold the logical line; the continuation lines start with a white space */
+		eol = strchr (line, '\n');
+		line_end = eol ? eol + 1 : line + strlen (line);
+
+		while (*line_end == ' ' || *line_end == '\t') {
+			folded = TRUE;
+			eol = strchr (line_end, '\n');
+			line_end = eol ? eol + 1 : line_end + strlen (line_end);
+		}
+
+		/* the end of the first physical line, without the line break */
+		phys_end = strchr (line, '\n');
+		if (!phys_end)
+			phys_end = line_end;
+		if (phys_end > line && phys_end[-1] == '\r')
+			phys_end--;
+
+		if (phys_end == line) {
+			line = line_end;
+			continue;
+		}
+
+		for (name_end = line; name_end < phys_end && *name_end != ';' && *name_end != ':'; name_end++) {
+			/* skip the group */
+		}
+
+		if (name_end == phys_end) {
+			g_clear_pointer (out_uid, g_free);
+			g_clear_pointer (out_revision, g_free);
+			return FALSE;
+		}
+
+		/* the vCard can have property groups, like 'item1.TEL' */
+		for (name = name_end; name > line && name[-1] != '.'; name--) {
+		}
+
+		name_len = name_end - name;
+		value = name_end + 1;
+
+		if (e_etesync_utils_scan_name_equal (name, name_len, "BEGIN")) {
+			if (*name_end != ':' || folded || (!depth && seen_root))
+				break;
+
+			depth++;
+
+			if (depth == 1) {
+				if (!e_etesync_utils_scan_name_equal (value, phys_end - value, root_name))
+					break;
+
+				seen_root = TRUE;
+			}
+
+			if (depth == comp_depth && target_depth == -1) {
+				gint ii;
+
+				for (ii = 0; comp_names[ii]; ii++) {
+					if (e_etesync_utils_scan_name_equal (value, phys_end - value, comp_names[ii])) {
+						target_depth = depth;
+						break;
+					}
+				}
+			}
+		} else if (e_etesync_utils_scan_name_equal (name, name_len, "END")) {
+			if (!depth)
+				break;
+
+			if (depth == target_depth) {
+				target_depth = -1;
+				seen_target = TRUE;
+			}
+
+			depth--;
+
+			if (!depth) {
+				line = line_end;
+				break;
+			}
+		} else if (depth == target_depth &&
+			   ((!*out_uid && !seen_target && e_etesync_utils_scan_name_equal (name, name_len, "UID")) ||
+			   (!*out_revision && e_etesync_utils_scan_name_equal (name, name_len, rev_name)))) {
+			gchar **out_value;
+
+			if (*name_end != ':' || memchr (value, '\\', line_end - value))
+				break;
+
+			if (e_etesync_utils_scan_name_equal (name, name_len, "UID"))
+				out_value = out_uid;
+			else
+				out_value = out_revision;
+
+			*out_value = e_etesync_utils_scan_dup_value (value, phys_end, line_end, folded);
+		}
+
+		line = line_end;
+	}
+
+	/* Stopped earlier on a malformed line, or the content is not complete */
+	if (!seen_root || !*out_uid || (depth && !(*out_uid && *out_revision))) {
+		g_clear_pointer (out_uid, g_free);
+		g_clear_pointer (out_revision, g_free);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
 gboolean
 e_etesync_utils_get_component_uid_revision (const gchar *content,
 					    gchar **out_component_uid,
 					    gchar **out_revision)
 {
+	const gchar *comp_names[] = { "VEVENT", "VTODO", "VJOURNAL", NULL };
 	ICalComponent *vcalendar, *subcomp;
 	gboolean success = FALSE;
 
+	if (e_etesync_utils_scan_uid_revision (content, "VCALENDAR", comp_names, 2, "LAST-MODIFIED", out_component_uid, out_revision))
+		return TRUE;
+
 	vcalendar = i_cal_component_new_from_string (content);
 
 	*out_component_uid = NULL;
 	*out_revision = NULL;
 
+	if (!vcalendar)
+		return FALSE;
+
 	for (subcomp = i_cal_component_get_first_component (vcalendar, I_CAL_ANY_COMPONENT);
 	     subcomp && (!*out_component_uid || !*out_revision);
 	     g_object_unref (subcomp), subcomp = i_cal_component_get_next_component (vcalendar, I_CAL_ANY_COMPONENT)) {
@@ -59,7 +241,7 @@ e_etesync_utils_get_component_uid_revision (const gchar *content,
 			if (!*out_revision) {
 				ICalProperty *prop;
 
-				prop = i_cal_component_get_first_property (vcalendar, I_CAL_LASTMODIFIED_PROPERTY);
+				prop = i_cal_component_get_first_property (subcomp, I_CAL_LASTMODIFIED_PROPERTY);
 				if (prop) {
 					ICalTime *itt;
 
@@ -86,8 +268,12 @@ e_etesync_utils_get_contact_uid_revision (const gchar *content,
 					  gchar **out_contact_uid,
 					  gchar **out_revision)
 {
+	const gchar *comp_names[] = { "VCARD", NULL };
 	EContact *contact;
 
+	if (e_etesync_utils_scan_uid_revision (content, "VCARD", comp_names, 1, "REV", out_contact_uid, out_revision))
+		return;
+
 	contact = e_contact_new_from_vcard (content);
 
 	if (contact) {
@@ -98,6 +284,30 @@ e_etesync_utils_get_contact_uid_revision (const gchar *content,
 	}
 }
 
+/* Reads the upload limits of the 'source'; the defaults are used, when it has no EteSync extension */
+void
+e_etesync_utils_get_push_limits (ESource *source,
+				 guint *out_max_items,
+				 guint *out_max_bytes)
+{
+	guint max_items = E_ETESYNC_ITEM_PUSH_LIMIT;
+	guint max_bytes = E_ETESYNC_ITEM_PUSH_SIZE_LIMIT;
+
+	if (source && e_source_has_extension (source, E_SOURCE_EXTENSION_ETESYNC)) {
+		ESourceEteSync *etesync_extension;
+
+		etesync_extension = e_source_get_extension (source, E_SOURCE_EXTENSION_ETESYNC);
+		max_items = MAX (e_source_etesync_get_push_limit (etesync_extension), 1);
+		max_bytes = MAX (e_source_etesync_get_push_size_limit (etesync_extension), 1);
+	}
+
+	if (out_max_items)
+		*out_max_items = max_items;
+
+	if (out_max_bytes)
+		*out_max_bytes = max_bytes;
+}
+
 void
 e_etesync_utils_set_io_gerror (EtebaseErrorCode etebase_error,
 			       const gchar* etesync_message,
@@ -148,6 +358,33 @@ e_etesync_utils_etebase_item_from_base64 (const gchar *item_cache_b64,
 	return item;
 }
 
+GBytes *
+e_etesync_utils_etebase_item_to_bytes (const EtebaseItem *item,
+				       EtebaseItemManager *item_mgr)
+{
+	void *item_cache_blob;
+	guintptr item_cache_size = 0;
+
+	item_cache_blob = etebase_item_manager_cache_save (item_mgr, item, &item_cache_size);
+
+	if (!item_cache_blob)
+		return NULL;
+
+	return g_bytes_new_take (item_cache_blob, item_cache_size);
+}
+
+EtebaseItem *
+e_etesync_utils_etebase_item_from_bytes (GBytes *item_cache,
+					 EtebaseItemManager *item_mgr)
+{
+	gconstpointer item_cache_blob;
+	gsize item_cache_size = 0;
+
+	item_cache_blob = g_bytes_get_data (item_cache, &item_cache_size);
+
+	return etebase_item_manager_cache_load (item_mgr, item_cache_blob, item_cache_size);
+}
+
 gchar *
 e_etesync_utils_etebase_collection_to_base64 (const EtebaseCollection *collection,
 					      EtebaseCollectionManager *col_mgr)
@@ -32,6 +32,9 @@ void		e_etesync_utils_get_contact_uid_revision
 						(const gchar *content,
 						 gchar **out_contact_uid,
 						 gchar **out_revision);
+void		e_etesync_utils_get_push_limits	(ESource *source,
+						 guint *out_max_items,
+						 guint *out_max_bytes);
 void		e_etesync_utils_set_io_gerror	(EtebaseErrorCode etesync_error,
 						 const gchar* etesync_message,
 						 GError **error);
@@ -41,6 +44,12 @@ gchar *		e_etesync_utils_etebase_item_to_base64
 EtebaseItem *	e_etesync_utils_etebase_item_from_base64
 						(const gchar *item_cache_b64,
 						 EtebaseItemManager *item_mgr);
+GBytes *	e_etesync_utils_etebase_item_to_bytes
+						(const EtebaseItem *item,
+						 EtebaseItemManager *item_mgr);
+EtebaseItem *	e_etesync_utils_etebase_item_from_bytes
+						(GBytes *item_cache,
+						 EtebaseItemManager *item_mgr);
 gchar *		e_etesync_utils_etebase_collection_to_base64
 						(const EtebaseCollection *collection,
 						 EtebaseCollectionManager *col_mgr);
@@ -0,0 +1,177 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/* e-etesync-workers.c - Shared pool of worker threads for CPU bound tasks.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "evolution-etesync-config.h"
+
+#include "e-etesync-workers.h"
+
+/* The environment variable to override the number of worker threads */
+#define WORKER_THREADS_ENV "ETESYNC_WORKER_THREADS"
+
+static GMutex workers_lock;
+static GThreadPool *workers_pool = NULL;
+static gint workers_max_threads = 0; /* 0 means not initialized yet */
+
+/* Tasks of one e_etesync_workers_start() call */
+struct _EEteSyncWorkersRun {
+	EEteSyncWorkerFunc func;
+	gpointer user_data;
+	gpointer *tasks;
+
+	GMutex lock;
+	GCond cond;
+	guint n_pending;
+};
+
+/* The CPU bound tasks are spread into as many threads as there are online CPUs,
+   unless overridden by the ETESYNC_WORKER_THREADS environment variable, or by
+   the "worker-threads" of the ESourceEteSyncAccount */
+static void
+e_etesync_workers_ensure_max_threads_locked (void)
+{
+	const gchar *env;
+
+	if (workers_max_threads > 0)
+		return;
+
+	env = g_getenv (WORKER_THREADS_ENV);
+	if (env && *env)
+		workers_max_threads = (gint) g_ascii_strtoll (env, NULL, 10);
+
+	if (workers_max_threads <= 0)
+		workers_max_threads = g_get_num_processors ();
+
+	if (workers_max_threads <= 0)
+		workers_max_threads = 1;
+}
+
+static void
+e_etesync_workers_thread_func (gpointer data,
+			       gpointer user_data)
+{
+	/* the pool is shared, thus each task is a pair of (EEteSyncWorkersRun *, index) */
+	gpointer *task = data;
+	EEteSyncWorkersRun *run = task[0];
+	guint index = GPOINTER_TO_UINT (task[1]);
+
+	run->func (index, run->user_data);
+
+	g_mutex_lock (&run->lock);
+	run->n_pending--;
+	if (!run->n_pending)
+		g_cond_signal (&run->cond);
+	g_mutex_unlock (&run->lock);
+}
+
+/* Sets how many worker threads the tasks use; the 0 means the default, the count
+   of the online CPUs. The pool is shared in the process, thus the last set wins. */
+void
+e_etesync_workers_set_max_threads (guint max_threads)
+{
+	g_mutex_lock (&workers_lock);
+
+	workers_max_threads = (gint) MIN (max_threads, G_MAXINT);
+	e_etesync_workers_ensure_max_threads_locked ();
+
+	if (workers_pool)
+		g_thread_pool_set_max_threads (workers_pool, workers_max_threads, NULL);
+
+	g_mutex_unlock (&workers_lock);
+}
+
+/* Calls 'func' for each index in range 0 .. n_tasks - 1 in the shared worker threads
+   and waits until all of them are finished. The order in which the tasks run is
+   not defined, thus the 'func' should store its result at the given index. */
+void
+e_etesync_workers_run (guint n_tasks,
+		       EEteSyncWorkerFunc func,
+		       gpointer user_data)
+{
+	guint ii;
+
+	g_return_if_fail (func != NULL);
+
+	if (!n_tasks)
+		return;
+
+	g_mutex_lock (&workers_lock);
+	e_etesync_workers_ensure_max_threads_locked ();
+
+	/* nothing to run in parallel */
+	if (n_tasks == 1 || workers_max_threads == 1) {
+		g_mutex_unlock (&workers_lock);
+
+		for (ii = 0; ii < n_tasks; ii++)
+			func (ii, user_data);
+
+		return;
+	}
+
+	g_mutex_unlock (&workers_lock);
+
+	e_etesync_workers_wait (e_etesync_workers_start (n_tasks, func, user_data));
+}
+
+/* Like e_etesync_workers_run(), only it does not wait for the tasks; the caller can do
+   something else meanwhile and then it should call e_etesync_workers_wait() on the result */
+EEteSyncWorkersRun *
+e_etesync_workers_start (guint n_tasks,
+			 EEteSyncWorkerFunc func,
+			 gpointer user_data)
+{
+	EEteSyncWorkersRun *run;
+	guint ii;
+
+	g_return_val_if_fail (func != NULL, NULL);
+
+	run = g_slice_new0 (EEteSyncWorkersRun);
+	run->func = func;
+	run->user_data = user_data;
+	run->n_pending = n_tasks;
+	g_mutex_init (&run->lock);
+	g_cond_init (&run->cond);
+
+	if (!n_tasks)
+		return run;
+
+	g_mutex_lock (&workers_lock);
+
+	e_etesync_workers_ensure_max_threads_locked ();
+
+	if (!workers_pool)
+		workers_pool = g_thread_pool_new (e_etesync_workers_thread_func, NULL, workers_max_threads, FALSE, NULL);
+
+	g_mutex_unlock (&workers_lock);
+
+	/* pairs of (run, index) */
+	run->tasks = g_new (gpointer, 2 * n_tasks);
+
+	for (ii = 0; ii < n_tasks; ii++) {
+		run->tasks[2 * ii] = run;
+		run->tasks[2 * ii + 1] = GUINT_TO_POINTER (ii);
+
+		g_thread_pool_push (workers_pool, run->tasks + (2 * ii), NULL);
+	}
+
+	return run;
+}
+
+/* Waits until all the tasks of the 'run' are finished and frees it */
+void
+e_etesync_workers_wait (EEteSyncWorkersRun *run)
+{
+	g_return_if_fail (run != NULL);
+
+	g_mutex_lock (&run->lock);
+	while (run->n_pending)
+		g_cond_wait (&run->cond, &run->lock);
+	g_mutex_unlock (&run->lock);
+
+	g_mutex_clear (&run->lock);
+	g_cond_clear (&run->cond);
+	g_free (run->tasks);
+	g_slice_free (EEteSyncWorkersRun, run);
+}
@@ -0,0 +1,33 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/* e-etesync-workers.h
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#ifndef E_ETESYNC_WORKERS_H
+#define E_ETESYNC_WORKERS_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _EEteSyncWorkersRun EEteSyncWorkersRun;
+
+/* Called for each task index, possibly from several threads at once */
+typedef void	(* EEteSyncWorkerFunc)		(guint index,
+						 gpointer user_data);
+
+void		e_etesync_workers_set_max_threads
+						(guint max_threads);
+void		e_etesync_workers_run		(guint n_tasks,
+						 EEteSyncWorkerFunc func,
+						 gpointer user_data);
+EEteSyncWorkersRun *
+		e_etesync_workers_start		(guint n_tasks,
+						 EEteSyncWorkerFunc func,
+						 gpointer user_data);
+void		e_etesync_workers_wait		(EEteSyncWorkersRun *run);
+
+G_END_DECLS
+
+#endif /* E_ETESYNC_WORKERS_H */
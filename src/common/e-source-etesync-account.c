@@ -7,15 +7,20 @@
 
 #include "evolution-etesync-config.h"
 
+#include "e-etesync-defines.h"
 #include "e-source-etesync-account.h"
 
 struct _ESourceEteSyncAccountPrivate {
 	gchar *collection_stoken;
+	guint max_requests;
+	guint worker_threads;
 };
 
 enum {
 	PROP_0,
-	PROP_COLLECTION_STOKEN
+	PROP_COLLECTION_STOKEN,
+	PROP_MAX_REQUESTS,
+	PROP_WORKER_THREADS
 };
 
 G_DEFINE_TYPE_WITH_PRIVATE (ESourceEteSyncAccount, e_source_etesync_account, E_TYPE_SOURCE_EXTENSION)
@@ -32,6 +37,18 @@ source_etesync_account_set_property (GObject *object,
 				E_SOURCE_ETESYNC_ACCOUNT (object),
 				g_value_get_string (value));
 			return;
+
+		case PROP_MAX_REQUESTS:
+			e_source_etesync_account_set_max_requests (
+				E_SOURCE_ETESYNC_ACCOUNT (object),
+				g_value_get_uint (value));
+			return;
+
+		case PROP_WORKER_THREADS:
+			e_source_etesync_account_set_worker_threads (
+				E_SOURCE_ETESYNC_ACCOUNT (object),
+				g_value_get_uint (value));
+			return;
 	}
 
 	G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -50,6 +67,20 @@ source_etesync_account_get_property (GObject *object,
 				e_source_etesync_account_dup_collection_stoken (
 				E_SOURCE_ETESYNC_ACCOUNT (object)));
 			return;
+
+		case PROP_MAX_REQUESTS:
+			g_value_set_uint (
+				value,
+				e_source_etesync_account_get_max_requests (
+				E_SOURCE_ETESYNC_ACCOUNT (object)));
+			return;
+
+		case PROP_WORKER_THREADS:
+			g_value_set_uint (
+				value,
+				e_source_etesync_account_get_worker_threads (
+				E_SOURCE_ETESYNC_ACCOUNT (object)));
+			return;
 	}
 
 	G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -93,6 +124,34 @@ e_source_etesync_account_class_init (ESourceEteSyncAccountClass *class)
 			G_PARAM_CONSTRUCT |
 			G_PARAM_STATIC_STRINGS |
 			E_SOURCE_PARAM_SETTING));
+
+	g_object_class_install_property (
+		object_class,
+		PROP_MAX_REQUESTS,
+		g_param_spec_uint (
+			"max-requests",
+			"Max Requests",
+			"Maximum count of requests to the server running at the same time",
+			1, G_MAXUINT,
+			E_ETESYNC_MAX_REQUESTS,
+			G_PARAM_READWRITE |
+			G_PARAM_CONSTRUCT |
+			G_PARAM_STATIC_STRINGS |
+			E_SOURCE_PARAM_SETTING));
+
+	g_object_class_install_property (
+		object_class,
+		PROP_WORKER_THREADS,
+		g_param_spec_uint (
+			"worker-threads",
+			"Worker Threads",
+			"Count of threads to decrypt and parse the items with, 0 for the count of online CPUs",
+			0, G_MAXUINT,
+			0,
+			G_PARAM_READWRITE |
+			G_PARAM_CONSTRUCT |
+			G_PARAM_STATIC_STRINGS |
+			E_SOURCE_PARAM_SETTING));
 }
 
 static void
@@ -155,3 +214,47 @@ e_source_etesync_account_set_collection_stoken (ESourceEteSyncAccount *extension
 
 	g_object_notify (G_OBJECT (extension), "collection-stoken");
 }
+
+guint
+e_source_etesync_account_get_max_requests (ESourceEteSyncAccount *extension)
+{
+	g_return_val_if_fail (E_IS_SOURCE_ETESYNC_ACCOUNT (extension), E_ETESYNC_MAX_REQUESTS);
+
+	return extension->priv->max_requests;
+}
+
+void
+e_source_etesync_account_set_max_requests (ESourceEteSyncAccount *extension,
+					   guint max_requests)
+{
+	g_return_if_fail (E_IS_SOURCE_ETESYNC_ACCOUNT (extension));
+
+	if (extension->priv->max_requests == max_requests)
+		return;
+
+	extension->priv->max_requests = max_requests;
+
+	g_object_notify (G_OBJECT (extension), "max-requests");
+}
+
+guint
+e_source_etesync_account_get_worker_threads (ESourceEteSyncAccount *extension)
+{
+	g_return_val_if_fail (E_IS_SOURCE_ETESYNC_ACCOUNT (extension), 0);
+
+	return extension->priv->worker_threads;
+}
+
+void
+e_source_etesync_account_set_worker_threads (ESourceEteSyncAccount *extension,
+					     guint worker_threads)
+{
+	g_return_if_fail (E_IS_SOURCE_ETESYNC_ACCOUNT (extension));
+
+	if (extension->priv->worker_threads == worker_threads)
+		return;
+
+	extension->priv->worker_threads = worker_threads;
+
+	g_object_notify (G_OBJECT (extension), "worker-threads");
+}
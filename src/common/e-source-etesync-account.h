@@ -57,6 +57,16 @@ gchar *		e_source_etesync_account_dup_collection_stoken
 void		e_source_etesync_account_set_collection_stoken
 					(ESourceEteSyncAccount *extension,
 					 const gchar *collection_stoken);
+guint		e_source_etesync_account_get_max_requests
+					(ESourceEteSyncAccount *extension);
+void		e_source_etesync_account_set_max_requests
+					(ESourceEteSyncAccount *extension,
+					 guint max_requests);
+guint		e_source_etesync_account_get_worker_threads
+					(ESourceEteSyncAccount *extension);
+void		e_source_etesync_account_set_worker_threads
+					(ESourceEteSyncAccount *extension,
+					 guint worker_threads);
 
 G_END_DECLS
 
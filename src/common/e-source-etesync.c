@@ -15,6 +15,8 @@ struct _ESourceEteSyncPrivate {
 	gchar *color;
 	gchar *description;
 	gchar *etebase_collection_b64;
+	guint push_limit;
+	guint push_size_limit;
 };
 
 enum {
@@ -22,7 +24,9 @@ enum {
 	PROP_COLOR,
 	PROP_DESCRIPTION,
 	PROP_COLLECTION_ID,
-	PROP_ETEBASE_COLLECTION_B64
+	PROP_ETEBASE_COLLECTION_B64,
+	PROP_PUSH_LIMIT,
+	PROP_PUSH_SIZE_LIMIT
 };
 
 G_DEFINE_TYPE_WITH_PRIVATE (ESourceEteSync, e_source_etesync, E_TYPE_SOURCE_EXTENSION)
@@ -57,6 +61,17 @@ source_etesync_set_property (GObject *object,
 				g_value_get_string (value));
 			return;
 
+		case PROP_PUSH_LIMIT:
+			e_source_etesync_set_push_limit (
+				E_SOURCE_ETESYNC (object),
+				g_value_get_uint (value));
+			return;
+
+		case PROP_PUSH_SIZE_LIMIT:
+			e_source_etesync_set_push_size_limit (
+				E_SOURCE_ETESYNC (object),
+				g_value_get_uint (value));
+			return;
 
 	}
 
@@ -96,6 +111,20 @@ source_etesync_get_property (GObject *object,
 				e_source_etesync_dup_etebase_collection_b64 (
 				E_SOURCE_ETESYNC (object)));
 			return;
+
+		case PROP_PUSH_LIMIT:
+			g_value_set_uint (
+				value,
+				e_source_etesync_get_push_limit (
+				E_SOURCE_ETESYNC (object)));
+			return;
+
+		case PROP_PUSH_SIZE_LIMIT:
+			g_value_set_uint (
+				value,
+				e_source_etesync_get_push_size_limit (
+				E_SOURCE_ETESYNC (object)));
+			return;
 	}
 
 	G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -182,6 +211,34 @@ e_source_etesync_class_init (ESourceEteSyncClass *class)
 			G_PARAM_CONSTRUCT |
 			G_PARAM_STATIC_STRINGS |
 			E_SOURCE_PARAM_SETTING));
+
+	g_object_class_install_property (
+		object_class,
+		PROP_PUSH_LIMIT,
+		g_param_spec_uint (
+			"push-limit",
+			"Push Limit",
+			"Maximum count of items uploaded in one request",
+			1, G_MAXUINT,
+			E_ETESYNC_ITEM_PUSH_LIMIT,
+			G_PARAM_READWRITE |
+			G_PARAM_CONSTRUCT |
+			G_PARAM_STATIC_STRINGS |
+			E_SOURCE_PARAM_SETTING));
+
+	g_object_class_install_property (
+		object_class,
+		PROP_PUSH_SIZE_LIMIT,
+		g_param_spec_uint (
+			"push-size-limit",
+			"Push Size Limit",
+			"Maximum size, in bytes, of the encrypted items uploaded in one request",
+			1, G_MAXUINT,
+			E_ETESYNC_ITEM_PUSH_SIZE_LIMIT,
+			G_PARAM_READWRITE |
+			G_PARAM_CONSTRUCT |
+			G_PARAM_STATIC_STRINGS |
+			E_SOURCE_PARAM_SETTING));
 }
 
 static void
@@ -382,3 +439,47 @@ e_source_etesync_set_etebase_collection_b64 (ESourceEteSync *extension,
 
 	g_object_notify (G_OBJECT (extension), "etebase-collection");
 }
+
+guint
+e_source_etesync_get_push_limit (ESourceEteSync *extension)
+{
+	g_return_val_if_fail (E_IS_SOURCE_ETESYNC (extension), E_ETESYNC_ITEM_PUSH_LIMIT);
+
+	return extension->priv->push_limit;
+}
+
+void
+e_source_etesync_set_push_limit (ESourceEteSync *extension,
+				 guint push_limit)
+{
+	g_return_if_fail (E_IS_SOURCE_ETESYNC (extension));
+
+	if (extension->priv->push_limit == push_limit)
+		return;
+
+	extension->priv->push_limit = push_limit;
+
+	g_object_notify (G_OBJECT (extension), "push-limit");
+}
+
+guint
+e_source_etesync_get_push_size_limit (ESourceEteSync *extension)
+{
+	g_return_val_if_fail (E_IS_SOURCE_ETESYNC (extension), E_ETESYNC_ITEM_PUSH_SIZE_LIMIT);
+
+	return extension->priv->push_size_limit;
+}
+
+void
+e_source_etesync_set_push_size_limit (ESourceEteSync *extension,
+				      guint push_size_limit)
+{
+	g_return_if_fail (E_IS_SOURCE_ETESYNC (extension));
+
+	if (extension->priv->push_size_limit == push_size_limit)
+		return;
+
+	extension->priv->push_size_limit = push_size_limit;
+
+	g_object_notify (G_OBJECT (extension), "push-size-limit");
+}
@@ -76,6 +76,14 @@ gchar *		e_source_etesync_dup_etebase_collection_b64
 void		e_source_etesync_set_etebase_collection_b64
 						(ESourceEteSync *extension,
 						 const gchar *etebase_collection_b64);
+guint		e_source_etesync_get_push_limit	(ESourceEteSync *extension);
+void		e_source_etesync_set_push_limit	(ESourceEteSync *extension,
+						 guint push_limit);
+guint		e_source_etesync_get_push_size_limit
+						(ESourceEteSync *extension);
+void		e_source_etesync_set_push_size_limit
+						(ESourceEteSync *extension,
+						 guint push_size_limit);
 G_END_DECLS
 
 #endif /* E_SOURCE_ETESYNC_H */
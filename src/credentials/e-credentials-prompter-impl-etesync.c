@@ -97,8 +97,12 @@ cpi_etesync_get_token_set_credentials_thread (GTask *task,
 					_("Failed to obtain access token for account “%s”"),
 					data->username);
 		} else {
+			gchar *session_key;
+
+			session_key = e_etesync_connection_dup_session_key (data->connection);
 			e_named_parameters_set (prompter_etesync->priv->credentials,
-				E_ETESYNC_CREDENTIAL_SESSION_KEY, e_etesync_connection_get_session_key (data->connection));
+				E_ETESYNC_CREDENTIAL_SESSION_KEY, session_key);
+			g_free (session_key);
 		}
 	}
 	g_clear_object (&prompter_etesync);
@@ -471,19 +475,8 @@ cpi_etesync_set_dialog_error_thread (GTask *task,
 	   so if E_SOURCE_CREDENTIAL_PASSWORD exist, then this is the first time, so we need to use it to get session key
 	   without showing the dialog and asking for the password again */
 	if (e_named_parameters_exists (prompter_etesync->priv->credentials, E_ETESYNC_CREDENTIAL_SESSION_KEY)) {
-		if (e_etesync_connection_set_connection_from_sources (connection, prompter_etesync->priv->credentials)) {
-			EtebaseAccount* etebase_account;
-
-			etebase_account = e_etesync_connection_get_etebase_account (connection);
-			success = !etebase_account_fetch_token (etebase_account);
-
-			if (success) {
-				gchar* new_session_key = etebase_account_save (etebase_account, NULL, 0);
-
-				e_etesync_connection_set_session_key (connection, new_session_key);
-				g_free (new_session_key);
-			}
-		}
+		if (e_etesync_connection_set_connection_from_sources (connection, prompter_etesync->priv->credentials))
+			success = e_etesync_connection_fetch_token_sync (connection, NULL, NULL);
 	} else if (e_named_parameters_exists (prompter_etesync->priv->credentials, E_SOURCE_CREDENTIAL_PASSWORD)) {
 		ESourceCollection *collection_extension;
 		ESourceAuthentication *auth_extension;
@@ -502,8 +495,7 @@ cpi_etesync_set_dialog_error_thread (GTask *task,
 	} else {
 		/* Since there was a problem error, and we got a session-key then invalidate that session-key
 		   Because will get a new one after the user enters the data, as this one will be lost. */
-		if (e_etesync_connection_get_etebase_account (connection))
-			etebase_account_logout (e_etesync_connection_get_etebase_account (connection));
+		e_etesync_connection_logout_sync (connection);
 		g_task_return_pointer (task, NULL, NULL);
 	}
 
@@ -526,9 +518,13 @@ cpi_etesync_set_dialog_error_cb (GObject *source,
 	/* if there is an error then pop the dialog to the user,
 	   if not then the credentials are ok, but need to add new token only */
 	if (connection){
+		gchar *session_key;
+
+		session_key = e_etesync_connection_dup_session_key (connection);
 		e_named_parameters_clear (prompter_etesync->priv->credentials);
 		e_named_parameters_set (prompter_etesync->priv->credentials,
-				E_ETESYNC_CREDENTIAL_SESSION_KEY, e_etesync_connection_get_session_key (connection));
+				E_ETESYNC_CREDENTIAL_SESSION_KEY, session_key);
+		g_free (session_key);
 
 		cpi_etesync_get_token_set_credentials_cb (NULL, NULL, prompter_etesync);
 	} else {
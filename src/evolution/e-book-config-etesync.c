@@ -61,14 +61,12 @@ book_config_etesync_commit_changes (ESourceConfigBackend *backend,
 			ESourceEteSync *etesync_extension;
 			gchar *display_name = NULL;
 			EtebaseCollection *col_obj;
-			EtebaseCollectionManager *col_mgr;
 
-			col_mgr = e_etesync_connection_get_collection_manager (connection);
 			display_name = e_source_dup_display_name (scratch_source);
 			etesync_extension = e_source_get_extension (scratch_source, E_SOURCE_EXTENSION_ETESYNC);
-			col_obj = e_etesync_utils_etebase_collection_from_base64 (
-						e_source_etesync_get_etebase_collection_b64 (etesync_extension),
-						col_mgr);
+			col_obj = e_etesync_connection_dup_collection (connection,
+						e_source_etesync_get_collection_id (etesync_extension),
+						e_source_etesync_get_etebase_collection_b64 (etesync_extension));
 
 			/* push modification to server */
 			if (e_etesync_connection_collection_modify_upload_sync (connection,
@@ -77,9 +75,15 @@ book_config_etesync_commit_changes (ESourceConfigBackend *backend,
 										NULL,
 										NULL,
 										NULL)) {
-				e_source_etesync_set_etebase_collection_b64 (
-							etesync_extension,
-							e_etesync_utils_etebase_collection_to_base64 (col_obj, col_mgr));
+				gchar *col_obj_b64;
+
+				col_obj_b64 = e_etesync_connection_collection_to_base64 (connection, col_obj);
+
+				if (col_obj_b64) {
+					e_etesync_connection_set_collection (connection, col_obj, col_obj_b64);
+					e_source_etesync_set_etebase_collection_b64 (etesync_extension, col_obj_b64);
+					g_free (col_obj_b64);
+				}
 			}
 
 			etebase_collection_destroy (col_obj);
@@ -103,12 +103,10 @@ cal_config_etesync_commit_changes (ESourceConfigBackend *backend,
 				gchar *color = g_strdup (E_ETESYNC_COLLECTION_DEFAULT_COLOR);
 				const gchar *source_color = NULL;
 				EtebaseCollection *col_obj;
-				EtebaseCollectionManager *col_mgr;
 
 				display_name = e_source_dup_display_name (scratch_source);
 				source_backend = e_source_get_extension (scratch_source, extension_name);
 				source_color = e_source_selectable_get_color (E_SOURCE_SELECTABLE (source_backend));
-				col_mgr = e_etesync_connection_get_collection_manager (connection);
 
 				if (source_color) {
 					g_free (color);
@@ -116,9 +114,9 @@ cal_config_etesync_commit_changes (ESourceConfigBackend *backend,
 				}
 
 				etesync_extension = e_source_get_extension (scratch_source, E_SOURCE_EXTENSION_ETESYNC);
-				col_obj = e_etesync_utils_etebase_collection_from_base64 (
-							e_source_etesync_get_etebase_collection_b64 (etesync_extension),
-							col_mgr);
+				col_obj = e_etesync_connection_dup_collection (connection,
+							e_source_etesync_get_collection_id (etesync_extension),
+							e_source_etesync_get_etebase_collection_b64 (etesync_extension));
 
 				/* push modification to server */
 				if (e_etesync_connection_collection_modify_upload_sync (connection,
@@ -127,9 +125,15 @@ cal_config_etesync_commit_changes (ESourceConfigBackend *backend,
 										       NULL,
 										       color,
 										       NULL)) {
-					e_source_etesync_set_etebase_collection_b64 (
-							etesync_extension,
-							e_etesync_utils_etebase_collection_to_base64 (col_obj, col_mgr));
+					gchar *col_obj_b64;
+
+					col_obj_b64 = e_etesync_connection_collection_to_base64 (connection, col_obj);
+
+					if (col_obj_b64) {
+						e_etesync_connection_set_collection (connection, col_obj, col_obj_b64);
+						e_source_etesync_set_etebase_collection_b64 (etesync_extension, col_obj_b64);
+						g_free (col_obj_b64);
+					}
 				}
 
 				etebase_collection_destroy (col_obj);
@@ -161,7 +161,7 @@ etesync_config_lookup_discover (const ENamedParameters *params,
 				if (e_etesync_connection_check_session_key_validation_sync (connection, &etebase_error, NULL) != E_SOURCE_AUTHENTICATION_ACCEPTED)
 					success = FALSE;
 
-				etebase_account_logout (e_etesync_connection_get_etebase_account (connection));
+				e_etesync_connection_logout_sync (connection);
 			} else
 				success = FALSE;
 
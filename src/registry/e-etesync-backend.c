@@ -7,6 +7,7 @@
 
 #include "evolution-etesync-config.h"
 
+#include <glib/gi18n-lib.h>
 #include <etebase.h>
 
 #include "e-etesync-backend.h"
@@ -21,9 +22,18 @@ static gulong source_removed_handler_id = 0;
 static gint backend_count = 0;
 G_LOCK_DEFINE_STATIC (backend_count);
 
+/* How long to wait before the failed first sync of the journals is tried again */
+#define SYNC_FOLDERS_RETRY_SECONDS 60
+
 struct _EEteSyncBackendPrivate {
 	EEteSyncConnection *connection;
 	GRecMutex etesync_lock;
+	guint refresh_timeout_id;
+
+	GMutex sync_folders_lock;
+	gboolean sync_folders_running;
+	ENamedParameters *sync_folders_credentials; /* to authenticate the children after the sync, or NULL */
+	guint sync_folders_retry_id;
 };
 
 G_DEFINE_TYPE_WITH_PRIVATE (EEteSyncBackend, e_etesync_backend, E_TYPE_COLLECTION_BACKEND)
@@ -162,9 +172,9 @@ etesync_backend_new_child (EEteSyncBackend *backend,
 
 	extension = e_source_get_extension (source, extension_name);
 	source_backend = E_SOURCE_BACKEND (extension);
-	col_obj_b64 = e_etesync_utils_etebase_collection_to_base64 (
-					col_obj,
-					e_etesync_connection_get_collection_manager (backend->priv->connection));
+	col_obj_b64 = e_etesync_connection_collection_to_base64 (backend->priv->connection, col_obj);
+	if (col_obj_b64)
+		e_etesync_connection_set_collection (backend->priv->connection, col_obj, col_obj_b64);
 	e_source_backend_set_backend_name (source_backend, "etesync");
 	etesync_backend_update_enabled (source, e_backend_get_source (E_BACKEND (backend)));
 
@@ -219,7 +229,6 @@ etesync_backend_new_child (EEteSyncBackend *backend,
 static void
 etesync_check_create_modify (EEteSyncBackend *backend,
 			     const EtebaseCollection *col_obj,
-			     EtebaseItemMetadata *item_metadata,
 			     ESource *source,
 			     ECollectionBackend *collection_backend,
 			     ESourceRegistryServer *server)
@@ -232,19 +241,57 @@ etesync_check_create_modify (EEteSyncBackend *backend,
 	if (source != NULL) {
 		ESourceExtension *extension;
 		ESourceBackend *source_backend;
+		EtebaseCollection *known_col_obj;
+		EtebaseItemMetadata *item_metadata;
 		const gchar *display_name, *description;
 		const gchar *extension_name = NULL;
 		const gchar *color;
+		gchar *col_obj_b64;
+		gboolean same_etag = FALSE, same_stoken = FALSE;
+
+		extension_name = E_SOURCE_EXTENSION_ETESYNC;
+		extension = e_source_get_extension (source, extension_name);
+
+		/* Compare with the collection the source stores; the etag changes with the collection
+		   metadata, the stoken with its items. Every change of the source is saved and sent
+		   to its clients, thus only what differs is written. */
+		known_col_obj = e_etesync_connection_dup_collection (backend->priv->connection,
+			etebase_collection_get_uid (col_obj),
+			e_source_etesync_get_etebase_collection_b64 (E_SOURCE_ETESYNC (extension)));
+
+		if (known_col_obj) {
+			same_etag = g_strcmp0 (etebase_collection_get_etag (known_col_obj), etebase_collection_get_etag (col_obj)) == 0;
+			same_stoken = g_strcmp0 (etebase_collection_get_stoken (known_col_obj), etebase_collection_get_stoken (col_obj)) == 0;
+
+			etebase_collection_destroy (known_col_obj);
+		}
+
+		if (same_etag && same_stoken)
+			return;
+
+		/* The collection comes with its new stoken, which lets the backend
+		   of the source know that there are changes to be fetched */
+		col_obj_b64 = e_etesync_connection_collection_to_base64 (backend->priv->connection, col_obj);
+
+		if (!col_obj_b64)
+			return;
+
+		e_etesync_connection_set_collection (backend->priv->connection, col_obj, col_obj_b64);
+		e_source_etesync_set_etebase_collection_b64 (E_SOURCE_ETESYNC (extension), col_obj_b64);
+		g_free (col_obj_b64);
 
+		/* Only the items changed */
+		if (same_etag)
+			return;
+
+		item_metadata = etebase_collection_get_meta (col_obj);
 		display_name = etebase_item_metadata_get_name (item_metadata);
 		description = etebase_item_metadata_get_description (item_metadata);
 		color = etebase_item_metadata_get_color (item_metadata);
 
-		extension_name = E_SOURCE_EXTENSION_ETESYNC;
-		extension = e_source_get_extension (source, extension_name);
-
-		/* Set source data */
-		e_source_set_display_name (source, display_name);
+		/* Set source data; the setters do not notify about the same values */
+		if (g_strcmp0 (e_source_get_display_name (source), display_name) != 0)
+			e_source_set_display_name (source, display_name);
 		e_source_etesync_set_collection_description ( E_SOURCE_ETESYNC (extension), description);
 		e_source_etesync_set_collection_color (E_SOURCE_ETESYNC (extension), color);
 
@@ -267,20 +314,27 @@ etesync_check_create_modify (EEteSyncBackend *backend,
 
 				/* Copying first 7 chars as color is stored in format #RRGGBBAA */
 				safe_color = g_strndup (color, 7);
-				e_source_selectable_set_color (E_SOURCE_SELECTABLE (source_backend), safe_color);
+				if (g_strcmp0 (e_source_selectable_get_color (E_SOURCE_SELECTABLE (source_backend)), safe_color) != 0)
+					e_source_selectable_set_color (E_SOURCE_SELECTABLE (source_backend), safe_color);
 
 				g_free (safe_color);
-			} else
+			} else if (g_strcmp0 (e_source_selectable_get_color (E_SOURCE_SELECTABLE (source_backend)), E_ETESYNC_COLLECTION_DEFAULT_COLOR) != 0)
 				e_source_selectable_set_color (E_SOURCE_SELECTABLE (source_backend), E_ETESYNC_COLLECTION_DEFAULT_COLOR);
 		}
 
+		etebase_item_metadata_destroy (item_metadata);
 	} else {
+		EtebaseItemMetadata *item_metadata;
+
+		item_metadata = etebase_collection_get_meta (col_obj);
 		source = etesync_backend_new_child (backend, col_obj, item_metadata);
 
 		if (source) {
 			e_source_registry_server_add_source (server, source);
 			g_object_unref (source);
 		}
+
+		etebase_item_metadata_destroy (item_metadata);
 	}
 }
 
@@ -395,14 +449,23 @@ etesync_backend_sync_folders_sync (EEteSyncBackend *backend,
 	ECollectionBackend *collection_backend;
 	ESourceEteSyncAccount *etesync_account_extention;
 	ESourceRegistryServer *server;
+	EtebaseCollectionManager *col_mgr;
 	EtebaseFetchOptions *fetch_options;
 	GHashTable *known_sources; /* Collection ID -> ESource */
 	gboolean success = TRUE, done = FALSE, is_first_time = FALSE;
 	gchar *stoken = NULL;
+	gint session_generation = -1;
 
 	if (g_cancellable_set_error_if_cancelled (cancellable, error))
 		return FALSE;
 
+	col_mgr = e_etesync_connection_dup_collection_manager (connection, &session_generation);
+
+	if (!col_mgr) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_CONNECTED, _("Not connected"));
+		return FALSE;
+	}
+
 	g_rec_mutex_lock (&backend->priv->etesync_lock);
 
 	collection_backend = E_COLLECTION_BACKEND (backend);
@@ -434,10 +497,7 @@ etesync_backend_sync_folders_sync (EEteSyncBackend *backend,
 		EtebaseCollectionListResponse *col_list;
 
 		etebase_fetch_options_set_stoken (fetch_options, stoken);
-		col_list =  etebase_collection_manager_list_multi (e_etesync_connection_get_collection_manager (connection),
-								   e_etesync_util_get_collection_supported_types (),
-								   EETESYNC_UTILS_SUPPORTED_TYPES_SIZE,
-								   fetch_options); /* (2) */
+		col_list = e_etesync_connection_collection_list_sync (connection, col_mgr, fetch_options); /* (2) */
 
 		if (col_list) {
 			guintptr col_objs_len = etebase_collection_list_response_get_data_length (col_list);
@@ -459,7 +519,10 @@ etesync_backend_sync_folders_sync (EEteSyncBackend *backend,
 				if (etebase_collection_list_response_get_removed_memberships (col_list, col_list_rmv_membership) == 0) {
 
 					for (col_iter = 0; col_iter < col_list_rmv_membership_len; col_iter++) {
-						ESource *source = g_hash_table_lookup (known_sources, etebase_removed_collection_get_uid (col_list_rmv_membership[col_iter]));
+						const gchar *collection_uid = etebase_removed_collection_get_uid (col_list_rmv_membership[col_iter]);
+						ESource *source = g_hash_table_lookup (known_sources, collection_uid);
+
+						e_etesync_connection_forget_collection (connection, collection_uid);
 
 						if (source)
 							etesync_backend_delete_source (source);
@@ -482,14 +545,11 @@ etesync_backend_sync_folders_sync (EEteSyncBackend *backend,
 				source = g_hash_table_lookup (known_sources, collection_uid);
 
 				if (!etebase_collection_is_deleted (col_obj)) { /* (5) */
-					EtebaseItemMetadata *item_metadata;
-
-					item_metadata = etebase_collection_get_meta (col_obj);
-					etesync_check_create_modify (backend, col_obj, item_metadata, source, collection_backend, server);
-
-					etebase_item_metadata_destroy (item_metadata);
-				} else /* (6) */
+					etesync_check_create_modify (backend, col_obj, source, collection_backend, server);
+				} else { /* (6) */
+					e_etesync_connection_forget_collection (connection, collection_uid);
 					etesync_backend_delete_source (source);
+				}
 			}
 
 			etebase_collection_list_response_destroy (col_list);
@@ -518,7 +578,7 @@ etesync_backend_sync_folders_sync (EEteSyncBackend *backend,
 
 		/* Check default type (contacts, calendar and tasks)
 		   First three types in `collection_supported_types` are contacts, calendar and tasks */
-		col_list =  etebase_collection_manager_list_multi (e_etesync_connection_get_collection_manager (connection),
+		col_list =  etebase_collection_manager_list_multi (col_mgr,
 								   collection_supported_types,
 								   3,
 								   fetch_options);
@@ -538,7 +598,7 @@ etesync_backend_sync_folders_sync (EEteSyncBackend *backend,
 
 		/* Check (Notes) type */
 		etebase_collection_list_response_destroy (col_list);
-		col_list = etebase_collection_manager_list (e_etesync_connection_get_collection_manager (connection),
+		col_list = etebase_collection_manager_list (col_mgr,
 							    E_ETESYNC_COLLECTION_TYPE_NOTES,
 							    fetch_options);
 
@@ -567,11 +627,12 @@ etesync_backend_sync_folders_sync (EEteSyncBackend *backend,
 		if (etebase_error == ETEBASE_ERROR_CODE_UNAUTHORIZED && check_rec) {
 			EBackend *e_backend = E_BACKEND (backend);
 
-			if (e_etesync_connection_maybe_reconnect_sync (connection, e_backend, cancellable, error))
+			if (e_etesync_connection_maybe_reconnect_sync (connection, e_backend, session_generation, cancellable, error))
 				success = etesync_backend_sync_folders_sync (backend, FALSE, cancellable, error);
 		}
 	}
 
+	etebase_collection_manager_destroy (col_mgr);
 	g_object_unref (server);
 	g_hash_table_destroy (known_sources);
 	etebase_fetch_options_destroy (fetch_options);
@@ -702,14 +763,16 @@ etesync_backend_delete_resource_sync (ECollectionBackend *backend,
 
 	connection = etesync_backend->priv->connection;
 	extension = e_source_get_extension (source, E_SOURCE_EXTENSION_ETESYNC);
-	col_obj = e_etesync_utils_etebase_collection_from_base64 (
-					e_source_etesync_get_etebase_collection_b64 (extension),
-					e_etesync_connection_get_collection_manager (connection));
+	col_obj = e_etesync_connection_dup_collection (connection,
+					e_source_etesync_get_collection_id (extension),
+					e_source_etesync_get_etebase_collection_b64 (extension));
 
 	success = e_etesync_connection_collection_delete_upload_sync (connection, e_backend, col_obj, cancellable, error);
 
-	if (success)
+	if (success) {
+		e_etesync_connection_forget_collection (connection, etebase_collection_get_uid (col_obj));
 		etesync_backend_delete_source (source);
+	}
 
 	if (col_obj)
 		etebase_collection_destroy (col_obj);
@@ -719,6 +782,118 @@ etesync_backend_delete_resource_sync (ECollectionBackend *backend,
 	return success;
 }
 
+static void etesync_backend_schedule_sync_folders (EEteSyncBackend *etesync_backend,
+						   const ENamedParameters *credentials);
+
+static gboolean
+etesync_backend_sync_folders_retry_cb (gpointer user_data)
+{
+	EEteSyncBackend *etesync_backend;
+
+	etesync_backend = g_weak_ref_get (user_data);
+
+	if (etesync_backend) {
+		g_mutex_lock (&etesync_backend->priv->sync_folders_lock);
+		etesync_backend->priv->sync_folders_retry_id = 0;
+		g_mutex_unlock (&etesync_backend->priv->sync_folders_lock);
+
+		etesync_backend_schedule_sync_folders (etesync_backend, NULL);
+
+		g_object_unref (etesync_backend);
+	}
+
+	return G_SOURCE_REMOVE;
+}
+
+static gpointer
+etesync_backend_sync_folders_thread (gpointer user_data)
+{
+	EEteSyncBackend *etesync_backend = user_data;
+	ENamedParameters *credentials = NULL;
+	GError *local_error = NULL;
+	gboolean success;
+
+	success = etesync_backend_sync_folders_sync (etesync_backend, TRUE, NULL, &local_error);
+
+	g_mutex_lock (&etesync_backend->priv->sync_folders_lock);
+
+	etesync_backend->priv->sync_folders_running = FALSE;
+
+	if (success) {
+		credentials = etesync_backend->priv->sync_folders_credentials;
+		etesync_backend->priv->sync_folders_credentials = NULL;
+	} else if (etesync_backend->priv->sync_folders_credentials && !etesync_backend->priv->sync_folders_retry_id) {
+		/* the children of the first sync are still to be created and authenticated */
+		etesync_backend->priv->sync_folders_retry_id = g_timeout_add_seconds_full (G_PRIORITY_DEFAULT, SYNC_FOLDERS_RETRY_SECONDS,
+			etesync_backend_sync_folders_retry_cb, e_weak_ref_new (etesync_backend), (GDestroyNotify) e_weak_ref_free);
+	}
+
+	g_mutex_unlock (&etesync_backend->priv->sync_folders_lock);
+
+	if (credentials) {
+		e_collection_backend_authenticate_children (E_COLLECTION_BACKEND (etesync_backend), credentials);
+		e_named_parameters_free (credentials);
+	}
+
+	if (!success) {
+		g_warning ("%s: Failed to refresh collections: %s", G_STRFUNC, local_error ? local_error->message : "Unknown error");
+		g_clear_error (&local_error);
+	}
+
+	g_object_unref (etesync_backend);
+
+	return NULL;
+}
+
+/* Synchronizes the journals in a dedicated thread, when online; the children
+   are updated through their sources, once it finishes. Only one sync runs
+   at a time. The 'credentials' are used to authenticate the children after
+   the next successful sync, they are kept until then. */
+static void
+etesync_backend_schedule_sync_folders (EEteSyncBackend *etesync_backend,
+				       const ENamedParameters *credentials)
+{
+	g_mutex_lock (&etesync_backend->priv->sync_folders_lock);
+
+	if (credentials) {
+		e_named_parameters_free (etesync_backend->priv->sync_folders_credentials);
+		etesync_backend->priv->sync_folders_credentials = e_named_parameters_new_clone (credentials);
+	}
+
+	if (etesync_backend->priv->sync_folders_running ||
+	    !e_backend_get_online (E_BACKEND (etesync_backend)) ||
+	    !e_etesync_connection_is_connected (etesync_backend->priv->connection)) {
+		g_mutex_unlock (&etesync_backend->priv->sync_folders_lock);
+		return;
+	}
+
+	etesync_backend->priv->sync_folders_running = TRUE;
+
+	g_mutex_unlock (&etesync_backend->priv->sync_folders_lock);
+
+	g_thread_unref (g_thread_new ("etesync-refresh", etesync_backend_sync_folders_thread, g_object_ref (etesync_backend)));
+}
+
+static gboolean
+etesync_backend_has_children (EEteSyncBackend *etesync_backend)
+{
+	ECollectionBackend *collection_backend = E_COLLECTION_BACKEND (etesync_backend);
+	GList *sources;
+	gboolean has_children;
+
+	sources = e_collection_backend_list_calendar_sources (collection_backend);
+	has_children = sources != NULL;
+	g_list_free_full (sources, g_object_unref);
+
+	if (!has_children) {
+		sources = e_collection_backend_list_contacts_sources (collection_backend);
+		has_children = sources != NULL;
+		g_list_free_full (sources, g_object_unref);
+	}
+
+	return has_children;
+}
+
 static ESourceAuthenticationResult
 etesync_backend_authenticate_sync (EBackend *backend,
 				   const ENamedParameters *credentials,
@@ -746,15 +921,19 @@ etesync_backend_authenticate_sync (EBackend *backend,
 
 		if (e_etesync_connection_reconnect_sync (etesync_backend->priv->connection, &result, cancellable, error))
 			result = E_SOURCE_AUTHENTICATION_ACCEPTED;
-
 	}
 
+	/* The children open from their cached collection objects immediately, the journals
+	   are synchronized in the background, not to wait for the server or to fail offline */
 	if (result == E_SOURCE_AUTHENTICATION_ACCEPTED) {
-		/* Getting the journals here, and updating the Sources */
-		if (etesync_backend_sync_folders_sync (etesync_backend, TRUE, cancellable, error))
-			e_collection_backend_authenticate_children (E_COLLECTION_BACKEND (backend), credentials);
-		else
-			result = E_SOURCE_AUTHENTICATION_ERROR;
+		gboolean has_children;
+
+		has_children = etesync_backend_has_children (etesync_backend);
+
+		e_collection_backend_authenticate_children (E_COLLECTION_BACKEND (backend), credentials);
+
+		/* the sources created by the first synchronization are authenticated after it */
+		etesync_backend_schedule_sync_folders (etesync_backend, has_children ? NULL : credentials);
 	}
 
 	g_rec_mutex_unlock (&etesync_backend->priv->etesync_lock);
@@ -762,6 +941,25 @@ etesync_backend_authenticate_sync (EBackend *backend,
 	return result;
 }
 
+/* Checks the collections periodically, which updates the changed ones
+   in the child sources; their backends refresh only those */
+static void
+etesync_backend_refresh_cb (ESource *source,
+			    gpointer user_data)
+{
+	etesync_backend_schedule_sync_folders (user_data, NULL);
+}
+
+/* The journals were not synchronized while offline */
+static void
+etesync_backend_notify_online_cb (EBackend *backend,
+				  GParamSpec *param,
+				  gpointer user_data)
+{
+	if (e_backend_get_online (backend))
+		etesync_backend_schedule_sync_folders (E_ETESYNC_BACKEND (backend), NULL);
+}
+
 /* This function is a call back for "source-removed" signal, it makes sure
    that the account logs-out after being removed */
 static void
@@ -784,7 +982,7 @@ etesync_backend_source_removed_cb (ESourceRegistryServer *server,
 		if (e_etesync_service_lookup_credentials_sync (collection_uid, &credentials, NULL, NULL) &&
 		    e_etesync_connection_set_connection_from_sources (connection, credentials)) {
 
-			etebase_account_logout (e_etesync_connection_get_etebase_account (connection));
+			e_etesync_connection_logout_sync (connection);
 		}
 
 		g_object_unref (connection);
@@ -795,8 +993,24 @@ etesync_backend_source_removed_cb (ESourceRegistryServer *server,
 static void
 etesync_backend_dispose (GObject *object)
 {
+	EEteSyncBackend *etesync_backend = E_ETESYNC_BACKEND (object);
 	ESourceRegistryServer *server;
 
+	if (etesync_backend->priv->refresh_timeout_id) {
+		e_source_refresh_remove_timeout (e_backend_get_source (E_BACKEND (object)), etesync_backend->priv->refresh_timeout_id);
+		etesync_backend->priv->refresh_timeout_id = 0;
+	}
+
+	g_mutex_lock (&etesync_backend->priv->sync_folders_lock);
+	if (etesync_backend->priv->sync_folders_retry_id) {
+		g_source_remove (etesync_backend->priv->sync_folders_retry_id);
+		etesync_backend->priv->sync_folders_retry_id = 0;
+	}
+	g_mutex_unlock (&etesync_backend->priv->sync_folders_lock);
+
+	/* The refreshed token can be still waiting to be stored */
+	e_etesync_service_wait_stores ();
+
 	server = e_collection_backend_ref_server (E_COLLECTION_BACKEND (object));
 
 	/* Only disconnect when backend_count is zero */
@@ -826,6 +1040,9 @@ etesync_backend_finalize (GObject *object)
 
 	g_rec_mutex_clear (&priv->etesync_lock);
 
+	e_named_parameters_free (priv->sync_folders_credentials);
+	g_mutex_clear (&priv->sync_folders_lock);
+
 	/* Chain up to parent's finalize() method. */
 	G_OBJECT_CLASS (e_etesync_backend_parent_class)->finalize (object);
 }
@@ -857,6 +1074,12 @@ etesync_backend_constructed (GObject *object)
 		e_source_collection_set_allow_sources_rename (collection_extension, TRUE);
 	}
 
+	etesync_backend->priv->refresh_timeout_id = e_source_refresh_add_timeout (source, NULL,
+		etesync_backend_refresh_cb, etesync_backend, NULL);
+
+	g_signal_connect (backend, "notify::online",
+		G_CALLBACK (etesync_backend_notify_online_cb), NULL);
+
 	G_LOCK (backend_count);
 	if (!backend_count++) {
 		source_removed_handler_id = g_signal_connect (
@@ -895,5 +1118,5 @@ e_etesync_backend_init (EEteSyncBackend *backend)
 {
 	backend->priv = e_etesync_backend_get_instance_private (backend);
 	g_rec_mutex_init (&backend->priv->etesync_lock);
-
+	g_mutex_init (&backend->priv->sync_folders_lock);
 }
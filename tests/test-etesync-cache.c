@@ -0,0 +1,263 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/* test-etesync-cache.c - Tests of the EteSync data stored in the ECache database.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "evolution-etesync-config.h"
+
+#include <string.h>
+#include <glib/gstdio.h>
+#include <libedata-book/libedata-book.h>
+
+#include "common/e-etesync-cache.h"
+
+typedef struct _Fixture {
+	gchar *dirname;
+	ECache *cache;
+} Fixture;
+
+static void
+fixture_setup (Fixture *fixture,
+	       gconstpointer user_data)
+{
+	GError *local_error = NULL;
+	gchar *filename;
+
+	fixture->dirname = g_dir_make_tmp ("test-etesync-cache-XXXXXX", &local_error);
+	g_assert_no_error (local_error);
+
+	filename = g_build_filename (fixture->dirname, "cache.db", NULL);
+	fixture->cache = E_CACHE (e_book_cache_new (filename, NULL, NULL, &local_error));
+	g_assert_no_error (local_error);
+	g_assert_nonnull (fixture->cache);
+
+	g_free (filename);
+}
+
+static void
+fixture_teardown (Fixture *fixture,
+		  gconstpointer user_data)
+{
+	gchar *filename;
+
+	g_clear_object (&fixture->cache);
+
+	filename = g_build_filename (fixture->dirname, "cache.db", NULL);
+	g_unlink (filename);
+	g_free (filename);
+
+	g_rmdir (fixture->dirname);
+	g_free (fixture->dirname);
+}
+
+static void
+queue_item (ECache *cache,
+	    const gchar *item_uid,
+	    const gchar *uid,
+	    const gchar *data,
+	    EConflictResolution conflict_resolution)
+{
+	GError *local_error = NULL;
+	GBytes *bytes;
+
+	bytes = g_bytes_new_static (data, strlen (data));
+
+	g_assert_true (e_etesync_cache_queue_item_sync (cache, item_uid, uid, bytes, conflict_resolution, NULL, &local_error));
+	g_assert_no_error (local_error);
+
+	g_bytes_unref (bytes);
+}
+
+static void
+assert_item_data (ECache *cache,
+		  const gchar *item_uid,
+		  const gchar *expected)
+{
+	GError *local_error = NULL;
+	GBytes *bytes = NULL;
+
+	g_assert_true (e_etesync_cache_dup_item_data_sync (cache, item_uid, &bytes, NULL, &local_error));
+	g_assert_no_error (local_error);
+
+	if (expected) {
+		gsize len = 0;
+		gconstpointer data;
+
+		g_assert_nonnull (bytes);
+
+		data = g_bytes_get_data (bytes, &len);
+		g_assert_cmpmem (data, len, expected, strlen (expected));
+
+		g_bytes_unref (bytes);
+	} else {
+		g_assert_null (bytes);
+	}
+}
+
+static GSList *
+dup_queued (ECache *cache)
+{
+	GError *local_error = NULL;
+	GSList *items = NULL;
+
+	g_assert_true (e_etesync_cache_dup_queued_items_sync (cache, 100, &items, NULL, &local_error));
+	g_assert_no_error (local_error);
+
+	return items;
+}
+
+static void
+test_cache_items (Fixture *fixture,
+		  gconstpointer user_data)
+{
+	GError *local_error = NULL;
+	GHashTable *etags = NULL;
+	GSList *items = NULL;
+	const gchar *item_uids[] = { "item-1", "item-2", "item-3" };
+	gchar *item_uid = NULL;
+
+	items = g_slist_prepend (items, e_etesync_cache_item_new ("item-1", "uid-1", "etag-1"));
+	items = g_slist_prepend (items, e_etesync_cache_item_new ("item-2", "uid-2", "etag-2"));
+
+	g_assert_true (e_etesync_cache_store_items_sync (fixture->cache, items, NULL, &local_error));
+	g_assert_no_error (local_error);
+
+	g_slist_free_full (items, e_etesync_cache_item_free);
+
+	g_assert_true (e_etesync_cache_get_item_etags_sync (fixture->cache, item_uids, G_N_ELEMENTS (item_uids), &etags, NULL, &local_error));
+	g_assert_no_error (local_error);
+	g_assert_cmpuint (g_hash_table_size (etags), ==, 2);
+	g_assert_cmpstr (g_hash_table_lookup (etags, "item-1"), ==, "etag-1");
+	g_assert_cmpstr (g_hash_table_lookup (etags, "item-2"), ==, "etag-2");
+	g_hash_table_destroy (etags);
+
+	g_assert_true (e_etesync_cache_dup_item_uid_sync (fixture->cache, "uid-2", &item_uid, NULL, &local_error));
+	g_assert_no_error (local_error);
+	g_assert_cmpstr (item_uid, ==, "item-2");
+	g_free (item_uid);
+
+	/* an item without etag is removed */
+	items = g_slist_prepend (NULL, e_etesync_cache_item_new ("item-1", "uid-1", NULL));
+
+	g_assert_true (e_etesync_cache_store_items_sync (fixture->cache, items, NULL, &local_error));
+	g_assert_no_error (local_error);
+
+	g_slist_free_full (items, e_etesync_cache_item_free);
+
+	g_assert_true (e_etesync_cache_get_item_etags_sync (fixture->cache, item_uids, G_N_ELEMENTS (item_uids), &etags, NULL, &local_error));
+	g_assert_no_error (local_error);
+	g_assert_cmpuint (g_hash_table_size (etags), ==, 1);
+	g_assert_false (g_hash_table_contains (etags, "item-1"));
+	g_hash_table_destroy (etags);
+}
+
+static void
+test_cache_outbox (Fixture *fixture,
+		   gconstpointer user_data)
+{
+	EEteSyncCacheItem *item;
+	GError *local_error = NULL;
+	GHashTable *queued = NULL;
+	GSList *items;
+	const gchar *item_uids[] = { "item-1", "item-2", "item-3" };
+	const gchar *server_uids[] = { "item-1" };
+	GBytes *server_data[1];
+
+	queue_item (fixture->cache, "item-1", "uid-1", "local-1", E_CONFLICT_RESOLUTION_KEEP_LOCAL);
+	queue_item (fixture->cache, "item-2", "uid-2", "local-2", E_CONFLICT_RESOLUTION_KEEP_SERVER);
+
+	/* in the order of queueing */
+	items = dup_queued (fixture->cache);
+	g_assert_cmpuint (g_slist_length (items), ==, 2);
+
+	item = items->data;
+	g_assert_cmpstr (item->item_uid, ==, "item-1");
+	g_assert_cmpstr (item->uid, ==, "uid-1");
+	g_assert_cmpint (item->conflict_resolution, ==, E_CONFLICT_RESOLUTION_KEEP_LOCAL);
+
+	item = items->next->data;
+	g_assert_cmpstr (item->item_uid, ==, "item-2");
+	g_assert_cmpint (item->conflict_resolution, ==, E_CONFLICT_RESOLUTION_KEEP_SERVER);
+
+	g_slist_free_full (items, e_etesync_cache_item_free);
+
+	/* the server data does not overwrite the queued change */
+	server_data[0] = g_bytes_new_static ("server-1", 8);
+
+	g_assert_true (e_etesync_cache_store_item_data_sync (fixture->cache, server_uids, server_data, 1, NULL, &local_error));
+	g_assert_no_error (local_error);
+
+	g_bytes_unref (server_data[0]);
+
+	assert_item_data (fixture->cache, "item-1", "local-1");
+
+	/* the failed change stays queued, but it is not uploaded again */
+	g_assert_true (e_etesync_cache_set_queued_item_error_sync (fixture->cache, "item-1", "Conflict", NULL, &local_error));
+	g_assert_no_error (local_error);
+
+	items = dup_queued (fixture->cache);
+	g_assert_cmpuint (g_slist_length (items), ==, 1);
+	g_assert_cmpstr (((EEteSyncCacheItem *) items->data)->item_uid, ==, "item-2");
+	g_slist_free_full (items, e_etesync_cache_item_free);
+
+	/* only the pending change hides the server version */
+	g_assert_true (e_etesync_cache_get_queued_item_uids_sync (fixture->cache, item_uids, G_N_ELEMENTS (item_uids), &queued, NULL, &local_error));
+	g_assert_no_error (local_error);
+	g_assert_cmpuint (g_hash_table_size (queued), ==, 1);
+	g_assert_true (g_hash_table_contains (queued, "item-2"));
+	g_hash_table_destroy (queued);
+
+	/* the server version replaces the failed change */
+	g_assert_true (e_etesync_cache_unqueue_failed_items_sync (fixture->cache, item_uids, G_N_ELEMENTS (item_uids), NULL, &local_error));
+	g_assert_no_error (local_error);
+
+	server_data[0] = g_bytes_new_static ("server-1", 8);
+
+	g_assert_true (e_etesync_cache_store_item_data_sync (fixture->cache, server_uids, server_data, 1, NULL, &local_error));
+	g_assert_no_error (local_error);
+
+	g_bytes_unref (server_data[0]);
+
+	assert_item_data (fixture->cache, "item-1", "server-1");
+
+	items = dup_queued (fixture->cache);
+	g_assert_cmpuint (g_slist_length (items), ==, 1);
+	g_assert_cmpstr (((EEteSyncCacheItem *) items->data)->item_uid, ==, "item-2");
+	g_slist_free_full (items, e_etesync_cache_item_free);
+
+	/* changing it again queues it after the other change */
+	queue_item (fixture->cache, "item-1", "uid-1", "local-1b", E_CONFLICT_RESOLUTION_KEEP_LOCAL);
+
+	items = dup_queued (fixture->cache);
+	g_assert_cmpuint (g_slist_length (items), ==, 2);
+	g_assert_cmpstr (((EEteSyncCacheItem *) items->data)->item_uid, ==, "item-2");
+	g_assert_cmpstr (((EEteSyncCacheItem *) items->next->data)->item_uid, ==, "item-1");
+
+	assert_item_data (fixture->cache, "item-1", "local-1b");
+
+	g_assert_true (e_etesync_cache_unqueue_items_sync (fixture->cache, items, NULL, &local_error));
+	g_assert_no_error (local_error);
+
+	g_slist_free_full (items, e_etesync_cache_item_free);
+
+	items = dup_queued (fixture->cache);
+	g_assert_null (items);
+
+	g_assert_true (e_etesync_cache_get_queued_item_uids_sync (fixture->cache, item_uids, G_N_ELEMENTS (item_uids), &queued, NULL, &local_error));
+	g_assert_no_error (local_error);
+	g_assert_cmpuint (g_hash_table_size (queued), ==, 0);
+	g_hash_table_destroy (queued);
+}
+
+gint
+main (gint argc,
+      gchar **argv)
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add ("/EteSync/Cache/Items", Fixture, NULL, fixture_setup, test_cache_items, fixture_teardown);
+	g_test_add ("/EteSync/Cache/Outbox", Fixture, NULL, fixture_setup, test_cache_outbox, fixture_teardown);
+
+	return g_test_run ();
+}
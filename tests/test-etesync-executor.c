@@ -0,0 +1,184 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/* test-etesync-executor.c - Tests of the request slots of an account.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "evolution-etesync-config.h"
+
+#include "common/e-etesync-executor.h"
+
+typedef struct _RequestData {
+	EEteSyncExecutor *executor;
+	EEteSyncRequestKind kind;
+	GMutex *lock;
+	GString *order;
+	gchar mark;
+} RequestData;
+
+static gpointer
+request_thread (gpointer user_data)
+{
+	RequestData *rd = user_data;
+
+	e_etesync_executor_begin_request (rd->executor, rd->kind);
+
+	g_mutex_lock (rd->lock);
+	g_string_append_c (rd->order, rd->mark);
+	g_mutex_unlock (rd->lock);
+
+	e_etesync_executor_end_request (rd->executor, rd->kind);
+
+	return NULL;
+}
+
+/* Waits until 'n_waiting' requests are blocked in the executor */
+static void
+wait_for_waiting (EEteSyncExecutor *executor,
+		  guint n_waiting)
+{
+	while (e_etesync_executor_get_n_waiting (executor) != n_waiting)
+		g_thread_yield ();
+}
+
+static GThread *
+start_request (RequestData *rd,
+	       EEteSyncExecutor *executor,
+	       EEteSyncRequestKind kind,
+	       GMutex *lock,
+	       GString *order,
+	       gchar mark)
+{
+	GThread *thread;
+	guint n_waiting;
+
+	n_waiting = e_etesync_executor_get_n_waiting (executor);
+
+	rd->executor = executor;
+	rd->kind = kind;
+	rd->lock = lock;
+	rd->order = order;
+	rd->mark = mark;
+
+	thread = g_thread_new ("request", request_thread, rd);
+
+	/* the request is expected to block */
+	wait_for_waiting (executor, n_waiting + 1);
+
+	return thread;
+}
+
+static void
+test_executor_limit (void)
+{
+	EEteSyncExecutor *executor;
+	RequestData rd;
+	GThread *thread;
+	GString *order;
+	GMutex lock;
+
+	g_mutex_init (&lock);
+	order = g_string_new ("");
+	executor = e_etesync_executor_new (2);
+
+	e_etesync_executor_begin_request (executor, E_ETESYNC_REQUEST_LIST_PAGE);
+	e_etesync_executor_begin_request (executor, E_ETESYNC_REQUEST_FETCH);
+
+	/* both slots are taken, thus the third request waits */
+	thread = start_request (&rd, executor, E_ETESYNC_REQUEST_FETCH, &lock, order, 'a');
+
+	g_mutex_lock (&lock);
+	g_assert_cmpstr (order->str, ==, "");
+	g_mutex_unlock (&lock);
+
+	e_etesync_executor_end_request (executor, E_ETESYNC_REQUEST_LIST_PAGE);
+	g_thread_join (thread);
+
+	g_assert_cmpstr (order->str, ==, "a");
+
+	e_etesync_executor_end_request (executor, E_ETESYNC_REQUEST_FETCH);
+
+	e_etesync_executor_unref (executor);
+	g_string_free (order, TRUE);
+	g_mutex_clear (&lock);
+}
+
+static void
+test_executor_interactive_first (void)
+{
+	EEteSyncExecutor *executor;
+	RequestData rd_background, rd_interactive;
+	GThread *background, *interactive;
+	GString *order;
+	GMutex lock;
+
+	g_mutex_init (&lock);
+	order = g_string_new ("");
+	executor = e_etesync_executor_new (1);
+
+	e_etesync_executor_begin_request (executor, E_ETESYNC_REQUEST_LIST_PAGE);
+
+	/* the background request waits longer, but the interactive one goes first */
+	background = start_request (&rd_background, executor, E_ETESYNC_REQUEST_BATCH, &lock, order, 'b');
+	interactive = start_request (&rd_interactive, executor, E_ETESYNC_REQUEST_FETCH, &lock, order, 'i');
+
+	e_etesync_executor_end_request (executor, E_ETESYNC_REQUEST_LIST_PAGE);
+
+	g_thread_join (interactive);
+	g_thread_join (background);
+
+	g_assert_cmpstr (order->str, ==, "ib");
+
+	e_etesync_executor_unref (executor);
+	g_string_free (order, TRUE);
+	g_mutex_clear (&lock);
+}
+
+static void
+test_executor_max_requests (void)
+{
+	EEteSyncExecutor *executor;
+	RequestData rd;
+	GThread *thread;
+	GString *order;
+	GMutex lock;
+
+	g_mutex_init (&lock);
+	order = g_string_new ("");
+	executor = e_etesync_executor_new (0);
+
+	g_assert_cmpuint (e_etesync_executor_get_max_requests (executor), ==, 1);
+
+	e_etesync_executor_begin_request (executor, E_ETESYNC_REQUEST_COLLECTION_LIST);
+
+	thread = start_request (&rd, executor, E_ETESYNC_REQUEST_COLLECTION_LIST, &lock, order, 'a');
+
+	g_mutex_lock (&lock);
+	g_assert_cmpstr (order->str, ==, "");
+	g_mutex_unlock (&lock);
+
+	/* raising the limit lets the waiting request in */
+	e_etesync_executor_set_max_requests (executor, 2);
+	g_thread_join (thread);
+
+	g_assert_cmpstr (order->str, ==, "a");
+
+	e_etesync_executor_end_request (executor, E_ETESYNC_REQUEST_COLLECTION_LIST);
+
+	e_etesync_executor_unref (executor);
+	g_string_free (order, TRUE);
+	g_mutex_clear (&lock);
+}
+
+gint
+main (gint argc,
+      gchar **argv)
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/EteSync/Executor/Limit", test_executor_limit);
+	g_test_add_func ("/EteSync/Executor/InteractiveFirst", test_executor_interactive_first);
+	g_test_add_func ("/EteSync/Executor/MaxRequests", test_executor_max_requests);
+
+	return g_test_run ();
+}
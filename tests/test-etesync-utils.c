@@ -0,0 +1,173 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/* test-etesync-utils.c - Tests of the UID and revision scanner.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "evolution-etesync-config.h"
+
+#include <libebook/libebook.h>
+
+#include "common/e-etesync-utils.h"
+
+/* The scanner is used only when it reads the same values as the full parser */
+static void
+check_contact (const gchar *vcard)
+{
+	EContact *contact;
+	gchar *uid = NULL, *revision = NULL;
+
+	e_etesync_utils_get_contact_uid_revision (vcard, &uid, &revision);
+
+	contact = e_contact_new_from_vcard (vcard);
+	g_assert_nonnull (contact);
+
+	g_assert_cmpstr (uid, ==, e_contact_get_const (contact, E_CONTACT_UID));
+	g_assert_cmpstr (revision, ==, e_contact_get_const (contact, E_CONTACT_REV));
+
+	g_object_unref (contact);
+	g_free (uid);
+	g_free (revision);
+}
+
+static void
+check_component (const gchar *ical,
+		 const gchar *expected_uid,
+		 const gchar *expected_revision)
+{
+	gchar *uid = NULL, *revision = NULL;
+
+	g_assert_true (e_etesync_utils_get_component_uid_revision (ical, &uid, &revision));
+
+	g_assert_cmpstr (uid, ==, expected_uid);
+	g_assert_cmpstr (revision, ==, expected_revision);
+
+	g_free (uid);
+	g_free (revision);
+}
+
+static void
+test_contact_simple (void)
+{
+	check_contact (
+		"BEGIN:VCARD\r\n"
+		"VERSION:3.0\r\n"
+		"UID:contact-1\r\n"
+		"FN:Test Contact\r\n"
+		"REV:2021-01-02T03:04:05Z\r\n"
+		"END:VCARD\r\n");
+}
+
+static void
+test_contact_folded (void)
+{
+	check_contact (
+		"BEGIN:VCARD\r\n"
+		"VERSION:3.0\r\n"
+		"UID:contact-with-a-\r\n"
+		" long-uid\r\n"
+		"FN:Test Contact\r\n"
+		"END:VCARD\r\n");
+}
+
+static void
+test_contact_escaped (void)
+{
+	/* requires the full parser */
+	check_contact (
+		"BEGIN:VCARD\r\n"
+		"VERSION:3.0\r\n"
+		"UID:contact\\,escaped\r\n"
+		"REV;VALUE=timestamp:2021-01-02T03:04:05Z\r\n"
+		"END:VCARD\r\n");
+}
+
+static void
+test_contact_group (void)
+{
+	check_contact (
+		"BEGIN:VCARD\n"
+		"VERSION:3.0\n"
+		"item1.TEL:123\n"
+		"UID:contact-2\n"
+		"END:VCARD\n");
+}
+
+static void
+test_component_event (void)
+{
+	check_component (
+		"BEGIN:VCALENDAR\r\n"
+		"VERSION:2.0\r\n"
+		"BEGIN:VTIMEZONE\r\n"
+		"TZID:Europe/Prague\r\n"
+		"BEGIN:STANDARD\r\n"
+		"DTSTART:19701025T030000\r\n"
+		"TZOFFSETFROM:+0200\r\n"
+		"TZOFFSETTO:+0100\r\n"
+		"END:STANDARD\r\n"
+		"END:VTIMEZONE\r\n"
+		"BEGIN:VEVENT\r\n"
+		"UID:event-1\r\n"
+		"DTSTART;TZID=Europe/Prague:20210102T030405\r\n"
+		"LAST-MODIFIED:20210102T030405Z\r\n"
+		"BEGIN:VALARM\r\n"
+		"UID:alarm-1\r\n"
+		"ACTION:DISPLAY\r\n"
+		"TRIGGER:-PT15M\r\n"
+		"END:VALARM\r\n"
+		"END:VEVENT\r\n"
+		"END:VCALENDAR\r\n",
+		"event-1", "20210102T030405Z");
+}
+
+static void
+test_component_no_revision (void)
+{
+	check_component (
+		"BEGIN:VCALENDAR\n"
+		"VERSION:2.0\n"
+		"BEGIN:VTODO\n"
+		"UID:task-1\n"
+		"SUMMARY:Task\n"
+		"END:VTODO\n"
+		"END:VCALENDAR\n",
+		"task-1", NULL);
+}
+
+static void
+test_component_detached (void)
+{
+	/* the UID of the first component is used */
+	check_component (
+		"BEGIN:VCALENDAR\n"
+		"VERSION:2.0\n"
+		"BEGIN:VEVENT\n"
+		"UID:event-2\n"
+		"DTSTART:20210102T030405Z\n"
+		"END:VEVENT\n"
+		"BEGIN:VEVENT\n"
+		"UID:event-2\n"
+		"RECURRENCE-ID:20210109T030405Z\n"
+		"LAST-MODIFIED:20210103T030405Z\n"
+		"END:VEVENT\n"
+		"END:VCALENDAR\n",
+		"event-2", "20210103T030405Z");
+}
+
+gint
+main (gint argc,
+      gchar **argv)
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/EteSync/Utils/ContactSimple", test_contact_simple);
+	g_test_add_func ("/EteSync/Utils/ContactFolded", test_contact_folded);
+	g_test_add_func ("/EteSync/Utils/ContactEscaped", test_contact_escaped);
+	g_test_add_func ("/EteSync/Utils/ContactGroup", test_contact_group);
+	g_test_add_func ("/EteSync/Utils/ComponentEvent", test_component_event);
+	g_test_add_func ("/EteSync/Utils/ComponentNoRevision", test_component_no_revision);
+	g_test_add_func ("/EteSync/Utils/ComponentDetached", test_component_detached);
+
+	return g_test_run ();
+}